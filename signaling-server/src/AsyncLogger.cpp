@@ -0,0 +1,419 @@
+#include "Common.hpp"
+#include "MpmcQueue.hpp"
+
+#include <QDateTime>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+/**
+* @brief One queued event; slots are reused, QStrings are released by the logger thread.
+*/
+struct LogRecord {
+    qint64 timeNs = 0;
+    const char* file = nullptr;
+    const char* event = nullptr;
+    int line = 0;
+    int level = 0;
+    int fieldCount = 0;
+    LogField fields[AsyncLogger::MAX_FIELDS];
+};
+
+/**
+* @class LogRing
+* @brief Single-producer/single-consumer ring owned by one logging thread.
+*/
+class LogRing
+{
+public:
+    explicit LogRing(int id) : _id(id), _slots(new LogRecord[AsyncLogger::RING_CAPACITY]) {}
+
+    int id() const { return _id; }
+
+    // Producer: the slot to fill, or nullptr (counted as dropped) when full
+    LogRecord* beginWrite() {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _cachedHead >= AsyncLogger::RING_CAPACITY) {
+            _cachedHead = _head.load(std::memory_order_acquire);
+            if (tail - _cachedHead >= AsyncLogger::RING_CAPACITY) {
+                _dropped.store(_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        }
+        return &_slots[tail & MASK];
+    }
+
+    // Producer: publishes the slot returned by beginWrite(); true if the ring was empty before,
+    // so the logger thread may be asleep. seq_cst on both sides: either the producer sees the
+    // drained head here, or the logger thread sees the new tail in pending() before sleeping
+    bool commit() {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        _tail.store(tail + 1, std::memory_order_seq_cst);
+        return _head.load(std::memory_order_seq_cst) == tail;
+    }
+
+    // Consumer: hands every published record to f, then frees the slots
+    template<class F>
+    size_t drain(F&& f) {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        const size_t tail = _tail.load(std::memory_order_acquire);
+        for (size_t i = head; i != tail; ++i) {
+            f(_slots[i & MASK]);
+        }
+        _head.store(tail, std::memory_order_seq_cst);
+        return tail - head;
+    }
+
+    // Consumer: re-check before sleeping, pairs with commit()
+    bool pending() const {
+        return _tail.load(std::memory_order_seq_cst) != _head.load(std::memory_order_relaxed);
+    }
+
+    bool empty() const {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+    void orphan() { _orphaned.store(true, std::memory_order_release); }
+    bool isOrphaned() const { return _orphaned.load(std::memory_order_acquire); }
+    quint64 dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+    static const size_t MASK = AsyncLogger::RING_CAPACITY - 1;
+    static_assert((AsyncLogger::RING_CAPACITY & MASK) == 0, "RING_CAPACITY must be a power of two");
+
+    const int _id;
+    std::unique_ptr<LogRecord[]> _slots;
+    alignas(64) std::atomic<size_t> _head{ 0 };  ///< Next slot to read (consumer).
+    alignas(64) std::atomic<size_t> _tail{ 0 };  ///< Next slot to write (producer).
+    size_t _cachedHead = 0;                      ///< Producer's last view of _head.
+    std::atomic<quint64> _dropped{ 0 };          ///< Written by the producer only.
+    std::atomic<bool> _orphaned{ false };        ///< The owning thread has exited.
+};
+
+namespace
+{
+    // Marks the ring of an exiting thread; the logger thread drains and frees it
+    struct RingHolder {
+        std::shared_ptr<LogRing> ring;
+        ~RingHolder() { if (ring) ring->orphan(); }
+    };
+    thread_local RingHolder t_ring;
+
+    const char* LEVEL_NAMES[] = { "TRACE", "DEBUG", "INFO", "WARNING", "CRITICAL" };
+    const int REAP_INTERVAL_MS = 1000;
+    const int FLUSH_POLL_MS = 1;
+    const int WRITE_THRESHOLD = 64 * 1024;
+
+    qint64 systemNowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    const char* baseName(const char* path)
+    {
+        const char* base = path;
+        for (const char* p = path; *p; ++p) {
+            if (*p == '/' || *p == '\\') base = p + 1;
+        }
+        return base;
+    }
+
+    void appendEscaped(QByteArray& out, const QByteArray& utf8)
+    {
+        for (const char c : utf8) {
+            switch (c) {
+            case '"': out.append("\\\""); break;
+            case '\\': out.append("\\\\"); break;
+            case '\n': out.append("\\n"); break;
+            case '\r': out.append("\\r"); break;
+            case '\t': out.append("\\t"); break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out.append(escaped);
+                }
+                else {
+                    out.append(c);
+                }
+            }
+        }
+    }
+
+    void appendString(QByteArray& out, const QString& value)
+    {
+        out.append('"');
+        if (value.size() > AsyncLogger::MAX_STRING_CHARS) {
+            appendEscaped(out, QStringView(value).left(AsyncLogger::MAX_STRING_CHARS).toUtf8());
+            out.append("...");
+        }
+        else {
+            appendEscaped(out, value.toUtf8());
+        }
+        out.append('"');
+    }
+
+    void onQtMessage(QtMsgType type, const QMessageLogContext& context, const QString& message)
+    {
+        int level = LOG_LEVEL_INFO;
+        switch (type) {
+        case QtDebugMsg: level = LOG_LEVEL_DEBUG; break;
+        case QtInfoMsg: level = LOG_LEVEL_INFO; break;
+        case QtWarningMsg: level = LOG_LEVEL_WARNING; break;
+        case QtCriticalMsg: level = LOG_LEVEL_CRITICAL; break;
+        case QtFatalMsg:
+            AsyncLogger::instance().flush();
+            fprintf(stderr, "%s\n", message.toLocal8Bit().constData());
+            std::abort();
+        }
+        AsyncLogger::instance().log(level, context.file ? context.file : "", context.line, "qt", { LogField("msg", message) });
+    }
+}
+
+AsyncLogger& AsyncLogger::instance()
+{
+    static AsyncLogger logger;
+    return logger;
+}
+
+AsyncLogger::AsyncLogger()
+{
+    _sink = stderr;
+    _payloadsPerSec.store(qMax(0, qEnvironmentVariableIsSet("SIGNALING_LOG_PAYLOADS_PER_SEC") ?
+        qEnvironmentVariableIntValue("SIGNALING_LOG_PAYLOADS_PER_SEC") : 10), std::memory_order_relaxed);
+    _wakeup.reset(new EventCount());
+    _thread = std::thread([this]() { run(); });
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    stop();
+    if (_ownsSink) fclose(_sink);
+}
+
+void AsyncLogger::log(int level, const char* file, int line, const char* event, std::initializer_list<LogField> fields)
+{
+    if (!_running.load(std::memory_order_relaxed)) {
+        _droppedRetired.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    LogRing* ring = localRing();
+    LogRecord* record = ring->beginWrite();
+    if (record == nullptr) return;
+
+    record->timeNs = systemNowNs();
+    record->file = file;
+    record->event = event;
+    record->line = line;
+    record->level = level;
+    int n = 0;
+    for (const LogField& field : fields) {
+        if (n == MAX_FIELDS) break;
+        record->fields[n++] = field;
+    }
+    record->fieldCount = n;
+    if (ring->commit()) {
+        _wakeup->notify();
+    }
+}
+
+bool AsyncLogger::samplePayload()
+{
+    const int budget = _payloadsPerSec.load(std::memory_order_relaxed);
+    if (budget <= 0) return false;
+
+    const qint64 second = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    qint64 current = _sampleSecond.load(std::memory_order_relaxed);
+    if (current != second && _sampleSecond.compare_exchange_strong(current, second, std::memory_order_relaxed)) {
+        _sampleCount.store(0, std::memory_order_relaxed);
+    }
+    // Read before the increment so the common "budget used up" case stays a shared load
+    if (_sampleCount.load(std::memory_order_relaxed) >= budget) return false;
+    return _sampleCount.fetch_add(1, std::memory_order_relaxed) < budget;
+}
+
+void AsyncLogger::setPayloadsPerSecond(int perSecond)
+{
+    _payloadsPerSec.store(qMax(0, perSecond), std::memory_order_relaxed);
+}
+
+bool AsyncLogger::setSink(const QString& path)
+{
+    FILE* sink = stderr;
+    if (!path.isEmpty()) {
+        sink = fopen(path.toLocal8Bit().constData(), "ab");
+        if (sink == nullptr) return false;
+    }
+    flush();
+    std::lock_guard<std::mutex> guard(_sinkMutex);
+    if (_ownsSink) fclose(_sink);
+    _sink = sink;
+    _ownsSink = !path.isEmpty();
+    return true;
+}
+
+void AsyncLogger::installQtMessageHandler()
+{
+    if (_qtHandlerInstalled) return;
+    _previousQtHandler = qInstallMessageHandler(onQtMessage);
+    _qtHandlerInstalled = true;
+}
+
+void AsyncLogger::flush()
+{
+    // Called from the logger thread (qFatal while formatting) nothing would ever drain
+    if (!_running.load(std::memory_order_acquire) || std::this_thread::get_id() == _thread.get_id()) return;
+    const quint64 request = _flushRequests.fetch_add(1, std::memory_order_acq_rel) + 1;
+    _wakeup->notify();
+    while (_flushDone.load(std::memory_order_acquire) < request && _running.load(std::memory_order_acquire)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(FLUSH_POLL_MS));
+    }
+}
+
+void AsyncLogger::stop()
+{
+    // Messages after this point go to the previous handler instead of being dropped
+    if (_qtHandlerInstalled) {
+        qInstallMessageHandler(_previousQtHandler);
+        _qtHandlerInstalled = false;
+    }
+    if (!_running.exchange(false, std::memory_order_acq_rel)) return;
+    _wakeup->notify();
+    if (_thread.joinable()) _thread.join();
+}
+
+quint64 AsyncLogger::dropped() const
+{
+    std::lock_guard<std::mutex> guard(_registryMutex);
+    quint64 total = _droppedRetired.load(std::memory_order_relaxed);
+    for (const std::shared_ptr<LogRing>& ring : _rings) {
+        total += ring->dropped();
+    }
+    return total;
+}
+
+LogRing* AsyncLogger::localRing()
+{
+    if (!t_ring.ring) {
+        t_ring.ring = std::make_shared<LogRing>(_nextRingId.fetch_add(1, std::memory_order_relaxed));
+        std::lock_guard<std::mutex> guard(_registryMutex);
+        _rings.push_back(t_ring.ring);
+        _registryVersion.fetch_add(1, std::memory_order_release);
+    }
+    return t_ring.ring.get();
+}
+
+void AsyncLogger::run()
+{
+    std::vector<std::shared_ptr<LogRing>> rings;
+    quint64 version = ~0ULL;
+    auto lastReap = std::chrono::steady_clock::now();
+
+    while (true) {
+        // Read both before draining: whatever was logged before stop()/flush() is written below
+        const bool running = _running.load(std::memory_order_acquire);
+        const quint64 flushRequest = _flushRequests.load(std::memory_order_acquire);
+
+        if (version != _registryVersion.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> guard(_registryMutex);
+            rings = _rings;
+            version = _registryVersion.load(std::memory_order_relaxed);
+        }
+
+        size_t drained = 0;
+        for (const std::shared_ptr<LogRing>& ring : rings) {
+            drained += ring->drain([this, &ring](LogRecord& record) {
+                write(*ring, record);
+                for (int i = 0; i < record.fieldCount; ++i) {
+                    record.fields[i].str = QString();  // release payloads now, not when the slot is reused
+                }
+            });
+        }
+
+        const bool idle = drained == 0;
+        if (idle || _buffer.size() >= WRITE_THRESHOLD || !running || flushRequest != _flushDone.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> guard(_sinkMutex);
+            if (!_buffer.isEmpty()) {
+                fwrite(_buffer.constData(), 1, static_cast<size_t>(_buffer.size()), _sink);
+                _buffer.clear();
+            }
+            if (idle || !running || flushRequest != _flushDone.load(std::memory_order_relaxed)) fflush(_sink);
+        }
+        _flushDone.store(flushRequest, std::memory_order_release);
+        if (!running) break;
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now - lastReap >= std::chrono::milliseconds(REAP_INTERVAL_MS)) {
+            lastReap = now;
+            std::lock_guard<std::mutex> guard(_registryMutex);
+            for (auto it = _rings.begin(); it != _rings.end();) {
+                if ((*it)->isOrphaned() && (*it)->empty()) {
+                    _droppedRetired.fetch_add((*it)->dropped(), std::memory_order_relaxed);
+                    it = _rings.erase(it);
+                    _registryVersion.fetch_add(1, std::memory_order_release);
+                }
+                else {
+                    ++it;
+                }
+            }
+        }
+
+        if (idle) {
+            // Sleep until a ring turns non-empty, a new ring registers, flush() or stop(); the
+            // timeout only keeps the reaping of exited threads' rings going
+            const uint32_t key = _wakeup->prepareWait();
+            bool wake = version != _registryVersion.load(std::memory_order_seq_cst) ||
+                !_running.load(std::memory_order_seq_cst) ||
+                _flushRequests.load(std::memory_order_seq_cst) != _flushDone.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < rings.size() && !wake; ++i) {
+                wake = rings[i]->pending();
+            }
+            if (wake) {
+                _wakeup->cancelWait();
+            }
+            else {
+                _wakeup->wait(key, REAP_INTERVAL_MS);
+            }
+        }
+    }
+}
+
+void AsyncLogger::write(const LogRing& ring, const LogRecord& record)
+{
+    // Seconds part of the timestamp changes rarely: format it once per second
+    static qint64 cachedSecond = -1;
+    static QByteArray cachedPrefix;
+    const qint64 second = record.timeNs / 1000000000;
+    if (second != cachedSecond) {
+        cachedSecond = second;
+        cachedPrefix = QDateTime::fromSecsSinceEpoch(second, Qt::UTC).toString("yyyy-MM-ddThh:mm:ss").toLatin1();
+    }
+    char micros[16];
+    snprintf(micros, sizeof(micros), ".%06dZ", static_cast<int>(record.timeNs % 1000000000 / 1000));
+
+    _buffer.append("{\"ts\":\"").append(cachedPrefix).append(micros);
+    _buffer.append("\",\"level\":\"");
+    _buffer.append(record.level >= 0 && record.level <= LOG_LEVEL_CRITICAL ? LEVEL_NAMES[record.level] : "FATAL");
+    _buffer.append("\",\"thread\":").append(QByteArray::number(ring.id()));
+    _buffer.append(",\"src\":\"").append(baseName(record.file)).append(':').append(QByteArray::number(record.line));
+    _buffer.append("\",\"event\":\"").append(record.event).append('"');
+
+    for (int i = 0; i < record.fieldCount; ++i) {
+        const LogField& field = record.fields[i];
+        _buffer.append(",\"").append(field.key).append("\":");
+        switch (field.kind) {
+        case LogField::Kind::Int: _buffer.append(QByteArray::number(field.i)); break;
+        case LogField::Kind::Double: _buffer.append(QByteArray::number(field.d, 'g', 12)); break;
+        case LogField::Kind::Text:
+            _buffer.append('"');
+            appendEscaped(_buffer, QByteArray(field.text ? field.text : ""));
+            _buffer.append('"');
+            break;
+        case LogField::Kind::String: appendString(_buffer, field.str); break;
+        }
+    }
+    _buffer.append("}\n");
+}
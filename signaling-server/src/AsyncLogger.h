@@ -0,0 +1,186 @@
+#ifndef __ASYNC_LOGGER_H__
+#define __ASYNC_LOGGER_H__
+
+#include <QString>
+
+#include <atomic>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class EventCount;
+class LogRing;
+struct LogRecord;
+
+/**
+* @struct LogField
+* @brief One key/value of a structured log event, stored unformatted.
+*
+* Numbers and static strings are copied as is, QStrings by reference count only (no deep
+* copy, no UTF-8 conversion); the logger thread formats them later.
+*/
+struct LogField {
+ enum class Kind : quint8 { Int, Double, Text, String };
+
+ const char* key = nullptr;   ///< Static string, e.g. "to".
+ Kind kind = Kind::Int;
+ union {
+     qint64 i;
+     double d;
+     const char* text;        ///< Static string.
+ };
+ QString str;                 ///< Kind::String.
+
+ LogField() : i(0) {}
+ LogField(const char* k, int v) : key(k), kind(Kind::Int), i(v) {}
+ LogField(const char* k, qint64 v) : key(k), kind(Kind::Int), i(v) {}
+ LogField(const char* k, quint64 v) : key(k), kind(Kind::Int), i(static_cast<qint64>(v)) {}
+ LogField(const char* k, double v) : key(k), kind(Kind::Double), d(v) {}
+ LogField(const char* k, const char* v) : key(k), kind(Kind::Text), text(v) {}
+ LogField(const char* k, const QString& v) : key(k), kind(Kind::String), i(0), str(v) {}
+};
+
+/**
+* @class AsyncLogger
+* @brief Background structured logger writing JSON lines.
+*
+* Every thread that logs gets its own single-producer/single-consumer ring, registered once
+* on first use; log() only fills a slot and publishes it with a release store, so the hot
+* path takes no lock and does no formatting or I/O (a few tens of ns). One logger thread
+* drains all rings, formats each event as one JSON object per line and writes it to the sink
+* (stderr by default). A full ring drops the event and counts it instead of blocking. With
+* nothing to write the logger thread sleeps on an EventCount; the event that makes a ring
+* non-empty wakes it.
+*
+* Payloads (SDPs, candidates) are logged through LOG_PAYLOAD, which is rate-limited to
+* SIGNALING_LOG_PAYLOADS_PER_SEC samples per second (default 10, 0 = never).
+*/
+class AsyncLogger
+{
+public:
+ /** @brief Slots per thread ring. */
+ static const size_t RING_CAPACITY = 4096;
+ /** @brief Fields per event. */
+ static const int MAX_FIELDS = 4;
+ /** @brief Longer string values are cut when formatted. */
+ static const int MAX_STRING_CHARS = 512;
+
+ /**
+  * @brief Gets the process-wide logger; the logger thread starts on first use.
+  */
+ static AsyncLogger& instance();
+
+ ~AsyncLogger();
+
+ AsyncLogger(const AsyncLogger&) = delete;
+ AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+ /**
+  * @brief Queues one event. Lock-free; never blocks.
+  * @param level One of LOG_LEVEL_*.
+  * @param file Static source file name (__FILE__).
+  * @param line Source line.
+  * @param event Static event name, e.g. "send".
+  * @param fields Up to MAX_FIELDS key/values; extra ones are ignored.
+  */
+ void log(int level, const char* file, int line, const char* event, std::initializer_list<LogField> fields);
+
+ /**
+  * @brief Decides whether a payload may be logged now (per-second budget).
+  */
+ bool samplePayload();
+
+ /**
+  * @brief Changes the payload budget at run time.
+  * @param perSecond Payload samples per second, 0 disables them.
+  */
+ void setPayloadsPerSecond(int perSecond);
+
+ /**
+  * @brief Redirects the output. Pending events are written to the new sink.
+  * @param path JSON-lines file to append to; empty for stderr.
+  * @return false if the file cannot be opened (the sink is left unchanged).
+  */
+ bool setSink(const QString& path);
+
+ /**
+  * @brief Routes qDebug()/qInfo()/... (the INFO()/WARNING() macros) through the rings too,
+  * so lifecycle logs no longer block on the console either. qFatal stays synchronous.
+  * stop() puts the previous handler back.
+  */
+ void installQtMessageHandler();
+
+ /**
+  * @brief Writes everything queued so far and flushes the sink. Blocks the caller.
+  */
+ void flush();
+
+ /**
+  * @brief Drains, flushes and stops the logger thread; later events are dropped, later Qt
+  * messages go to the handler that was installed before installQtMessageHandler().
+  */
+ void stop();
+
+ /**
+  * @brief Gets the number of events dropped because a ring was full.
+  */
+ quint64 dropped() const;
+
+private:
+ AsyncLogger();
+
+ LogRing* localRing();
+ void run();
+ void write(const LogRing& ring, const LogRecord& record);
+
+ mutable std::mutex _registryMutex;           ///< Guards _rings; taken once per thread and by the logger thread.
+ std::vector<std::shared_ptr<LogRing>> _rings;
+ std::atomic<quint64> _registryVersion{ 0 };   ///< Bumped on register so the logger thread re-reads _rings.
+ std::atomic<int> _nextRingId{ 1 };
+
+ std::mutex _sinkMutex;                       ///< Guards _sink against setSink().
+ FILE* _sink = nullptr;
+ bool _ownsSink = false;
+ QByteArray _buffer;                          ///< Formatted lines not yet written; logger thread only.
+
+ std::atomic<int> _payloadsPerSec{ 10 };
+ std::atomic<qint64> _sampleSecond{ -1 };
+ std::atomic<int> _sampleCount{ 0 };
+
+ std::atomic<quint64> _droppedRetired{ 0 };    ///< Drops after stop() and of freed rings.
+ std::atomic<bool> _running{ true };
+ std::atomic<quint64> _flushRequests{ 0 };
+ std::atomic<quint64> _flushDone{ 0 };
+ std::unique_ptr<EventCount> _wakeup;          ///< The idle logger thread sleeps here.
+ std::thread _thread;
+ bool _qtHandlerInstalled = false;
+ QtMessageHandler _previousQtHandler = nullptr;   ///< Restored by stop(); nullptr is Qt's default.
+};
+
+/**
+* @brief Structured, asynchronous event: LOG_EVENT(LOG_LEVEL_INFO, "send", {"to", id}, {"bytes", n}).
+* Compiled out below LOG_LEVEL like the stream macros.
+*/
+#define LOG_EVENT(level, event, ...) \
+ do { \
+     if constexpr (LOG_ENABLED(level)) { \
+         AsyncLogger::instance().log((level), __FILE__, __LINE__, (event), { __VA_ARGS__ }); \
+     } \
+ } while (0)
+
+/**
+* @brief Rate-limited payload sample at INFO: LOG_PAYLOAD("send", clientId, data).
+*/
+#define LOG_PAYLOAD(event, clientId, payload) \
+ do { \
+     if constexpr (LOG_ENABLED(LOG_LEVEL_INFO)) { \
+         if (AsyncLogger::instance().samplePayload()) { \
+             AsyncLogger::instance().log(LOG_LEVEL_INFO, __FILE__, __LINE__, (event), \
+                 { LogField("client", (clientId)), LogField("payload", (payload)) }); \
+         } \
+     } \
+ } while (0)
+
+#endif // __ASYNC_LOGGER_H__
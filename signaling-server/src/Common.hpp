@@ -18,6 +18,7 @@
 #include <QAtomicInt>
 #include <QThread>
 
+#include <atomic>
 #include <memory>
 #include <functional>  
 #include <string>  
@@ -25,11 +26,108 @@
 
 #include <cassert> 
 
-#define CRITICAL() qCritical() << "[CRITICAL]" << "[" << __FILE__ << ":" << __LINE__ <<"] "
-#define DEBUG() qDebug() << "[DEBUG]" << "[" << __FILE__ << ":" << __LINE__ <<"] "
+/**
+* @name Compile-time log level
+* @brief Log statements below LOG_LEVEL are discarded at compile time.
+*
+* Each macro expands to `if constexpr (...) {} else <stream>`, so a disabled statement
+* never evaluates its arguments and the optimizer removes it entirely. Override the
+* threshold with -DLOG_LEVEL=<n> (CMake cache variable LOG_LEVEL); by default Debug
+* builds log from DEBUG and release builds (QT_NO_DEBUG) from INFO. FATAL() is always on.
+* @{
+*/
+#define LOG_LEVEL_TRACE    0
+#define LOG_LEVEL_DEBUG    1
+#define LOG_LEVEL_INFO     2
+#define LOG_LEVEL_WARNING  3
+#define LOG_LEVEL_CRITICAL 4
+
+#ifndef LOG_LEVEL
+#ifdef QT_NO_DEBUG
+#define LOG_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+#define LOG_ENABLED(level) (LOG_LEVEL <= (level))
+#define LOG_AT(level, stream) if constexpr (!LOG_ENABLED(level)) {} else stream
+
+#define TRACE() LOG_AT(LOG_LEVEL_TRACE, qDebug() << "[TRACE]" << "[" << __FILE__ << ":" << __LINE__ <<"] ")
+#define CRITICAL() LOG_AT(LOG_LEVEL_CRITICAL, qCritical() << "[CRITICAL]" << "[" << __FILE__ << ":" << __LINE__ <<"] ")
+#define DEBUG() LOG_AT(LOG_LEVEL_DEBUG, qDebug() << "[DEBUG]" << "[" << __FILE__ << ":" << __LINE__ <<"] ")
 #define FATAL() qFatal() << "[FATAL]" << "[" << __FILE__ << ":" << __LINE__ <<"] "
-#define INFO() qInfo() << "[INFO]" << "[" << __FILE__ << ":" << __LINE__ <<"] "
-#define WARNING() qWarning() << "[WARNING]" << "[" << __FILE__ << ":" << __LINE__ <<"] "
+#define INFO() LOG_AT(LOG_LEVEL_INFO, qInfo() << "[INFO]" << "[" << __FILE__ << ":" << __LINE__ <<"] ")
+#define WARNING() LOG_AT(LOG_LEVEL_WARNING, qWarning() << "[WARNING]" << "[" << __FILE__ << ":" << __LINE__ <<"] ")
+/** @} */
+
+// LOG_EVENT / LOG_PAYLOAD: asynchronous structured logging for per-message hot paths
+#include "AsyncLogger.h"
+
+/**
+* @namespace PacketTrace
+* @brief Runtime-sampled packet dump for the media hot paths.
+*
+* Replaces unconditional per-packet logging. Only compiled in at LOG_LEVEL_TRACE; at run time
+* one packet in N is logged, N taken from the PACKET_TRACE_SAMPLE environment variable
+* (0 or unset = off) or set with setSampleRate().
+*/
+namespace PacketTrace {
+ /**
+  * @brief Returns the shared sampling rate (1 in N packets, 0 = off).
+  */
+ inline std::atomic<quint32>& sampleRate() {
+     static std::atomic<quint32> rate{ static_cast<quint32>(qMax(0, qEnvironmentVariableIntValue("PACKET_TRACE_SAMPLE"))) };
+     return rate;
+ }
+
+ /**
+  * @brief Changes the sampling rate at run time.
+  * @param everyN Log one packet in everyN, 0 disables the trace.
+  */
+ inline void setSampleRate(quint32 everyN) { sampleRate().store(everyN, std::memory_order_relaxed); }
+
+ /**
+  * @brief Decides whether the current packet is traced. One relaxed load when disabled.
+  * @return true for one packet in N.
+  */
+ inline bool shouldSample() {
+     const quint32 everyN = sampleRate().load(std::memory_order_relaxed);
+     if (everyN == 0) return false;
+     static std::atomic<quint64> counter{ 0 };
+     return counter.fetch_add(1, std::memory_order_relaxed) % everyN == 0;
+ }
+
+ /**
+  * @brief Formats the first bytes of a packet (the RTP header and payload start) as hex.
+  * @param data Packet bytes, not copied.
+  * @param size Packet size.
+  * @param maxBytes Number of leading bytes to dump.
+  */
+ inline QByteArray head(const void* data, size_t size, size_t maxBytes = 16) {
+     const size_t n = size < maxBytes ? size : maxBytes;
+     return QByteArray::fromRawData(static_cast<const char*>(data), static_cast<qsizetype>(n)).toHex(' ');
+ }
+}
+
+/**
+* @brief Logs a sampled packet: TRACE_PACKET("send", packet.data(), packet.size()).
+*/
+#define TRACE_PACKET(tag, data, size) \
+ do { \
+     if constexpr (LOG_ENABLED(LOG_LEVEL_TRACE)) { \
+         if (PacketTrace::shouldSample()) { \
+             TRACE() << (tag) << (size) << "bytes:" << PacketTrace::head((data), (size)); \
+         } \
+     } \
+ } while (0)
+
+/**  
+* @brief Internal handle of a session, see SessionTable: (generation << 32) | slot index.  
+* Dense and never reused while the session is open; the external string ID only crosses the wire.  
+*/  
+using SessionHandle = quint64;  
+const SessionHandle NO_SESSION = 0;  ///< No session; valid handles have a non-zero generation.  
 
 /**  
 * @struct SignalingTask  
@@ -39,15 +137,19 @@
 * including the client ID, the raw signaling data, and the timestamp when the task was created.  
 */  
 struct SignalingTask {  
- QString _clientId;       ///< The ID of the client that sent the signaling task.  
+ SessionHandle _handle;   ///< The session that sent the signaling task.  
+ QString _clientId;       ///< Its external ID, interned by the SessionTable (shared, not copied).  
  QString _payload;        ///< The raw signaling data.  
+ QByteArray _frame;       ///< The raw binary frame (see WireFormat); _payload is empty then.  
  qint64 _timestamp;       ///< The timestamp when the task was created.  
+ qint64 _receivedNs;      ///< Metrics::now() when the I/O thread received it, 0 if not stamped.  
+ uint _shardKey;          ///< Picks the task queue shard: the sender, so its tasks run in order.  
 
  /**  
   * @brief Default constructor for SignalingTask.  
   * Initializes the timestamp to 0.  
   */  
- SignalingTask() : _timestamp(0) {}  
+ SignalingTask() : _handle(NO_SESSION), _timestamp(0), _receivedNs(0), _shardKey(0) {}  
 
  /**  
   * @brief Constructs a SignalingTask with the given client ID and payload.  
@@ -55,7 +157,19 @@ struct SignalingTask {
   * @param data The raw signaling data.  
   */  
  SignalingTask(const QString& id, const QString& data)  
-     : _clientId(id), _payload(data), _timestamp(QDateTime::currentMSecsSinceEpoch()) {  
+     : _handle(NO_SESSION), _clientId(id), _payload(data), _timestamp(QDateTime::currentMSecsSinceEpoch()), _receivedNs(0), _shardKey(qHash(id)) {  
+ }  
+
+ /**  
+  * @brief Constructs a SignalingTask for an open session; the shard key is its slot index,  
+  * so consecutive sessions spread over the shards without hashing the ID.  
+  * @param handle The session handle.  
+  * @param id The external ID of the session.  
+  * @param data The raw signaling data.  
+  */  
+ SignalingTask(SessionHandle handle, const QString& id, const QString& data)  
+     : _handle(handle), _clientId(id), _payload(data), _timestamp(QDateTime::currentMSecsSinceEpoch()), _receivedNs(0),  
+     _shardKey(static_cast<uint>(handle)) {  
  }  
 };  
 
@@ -71,10 +185,14 @@ enum class SignalingType {
  OFFER,             ///< Client-to-server: Offer message.  
  ANSWER,            ///< Client-to-server: Answer message.  
  ICE,               ///< Client-to-server: ICE candidate message.  
+ JOIN_ROOM,         ///< Client-to-server: Move into a room.  
+ LEAVE_ROOM,        ///< Client-to-server: Leave the current room.  
 
  REGISTER_SUCCESS,  ///< Server-to-client: Registration success message.  
  PEER_JOINED,       ///< Server-to-client: Notification of a new peer joining.  
  PEER_LEFT,         ///< Server-to-client: Notification of a peer leaving.  
+ ROOM_JOINED,       ///< Server-to-client: JOIN_ROOM succeeded, with the room's peer list.  
+ ROOM_LEFT,         ///< Server-to-client: LEAVE_ROOM succeeded.  
 
  ERROR_MESSAGE,     ///< Server-to-client: Error message.  
  UNKNOWN            ///< Unknown signaling type.  
@@ -90,9 +208,13 @@ inline SignalingType string_to_stype(const QString& str) {
   if (str == "OFFER") return SignalingType::OFFER;  
   if (str == "ANSWER") return SignalingType::ANSWER;  
   if (str == "ICE") return SignalingType::ICE;  
+  if (str == "JOIN_ROOM") return SignalingType::JOIN_ROOM;  
+  if (str == "LEAVE_ROOM") return SignalingType::LEAVE_ROOM;  
   if (str == "REGISTER_SUCCESS") return SignalingType::REGISTER_SUCCESS;  
   if (str == "PEER_JOINED") return SignalingType::PEER_JOINED;  
   if (str == "PEER_LEFT") return SignalingType::PEER_LEFT;  
+  if (str == "ROOM_JOINED") return SignalingType::ROOM_JOINED;  
+  if (str == "ROOM_LEFT") return SignalingType::ROOM_LEFT;  
   if (str == "ERROR_MESSAGE") return SignalingType::ERROR_MESSAGE;  
   return SignalingType::UNKNOWN;  
 }  
@@ -108,9 +230,13 @@ inline QString stype_to_string(SignalingType type) {
      case SignalingType::OFFER: return "OFFER";  
      case SignalingType::ANSWER: return "ANSWER";  
      case SignalingType::ICE: return "ICE";  
+     case SignalingType::JOIN_ROOM: return "JOIN_ROOM";  
+     case SignalingType::LEAVE_ROOM: return "LEAVE_ROOM";  
      case SignalingType::REGISTER_SUCCESS: return "REGISTER_SUCCESS";  
      case SignalingType::PEER_JOINED: return "PEER_JOINED";  
      case SignalingType::PEER_LEFT: return "PEER_LEFT";  
+     case SignalingType::ROOM_JOINED: return "ROOM_JOINED";  
+     case SignalingType::ROOM_LEFT: return "ROOM_LEFT";  
      case SignalingType::ERROR_MESSAGE: return "ERROR_MESSAGE";  
      default: return "UNKNOWN";  
  }  
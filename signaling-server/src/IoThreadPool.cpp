@@ -0,0 +1,247 @@
+#include "IoThreadPool.h"
+#include "SignalingServer.h"
+
+#include <QTcpSocket>
+
+// IoThread >>>>>>>>>>>>>>>>>
+
+IoThread::IoThread(int id, SessionTable* sessions, DataHandler onData, CloseHandler onClose, QObject* parent)
+    : QObject(parent),
+    _id(id),
+    _sessions(sessions),
+    _onData(std::move(onData)),
+    _onClose(std::move(onClose)),
+    _upgrader(new QWebSocketServer(QStringLiteral("Signaling Server"), QWebSocketServer::NonSecureMode, this)),
+    _sessionCount(0),
+    _pending(0)
+{
+    connect(_upgrader, &QWebSocketServer::newConnection, this, &IoThread::onNewConnection);
+}
+
+IoThread::~IoThread() {}
+
+int IoThread::getId() const { return _id; }
+
+int IoThread::load() const
+{
+    return _sessionCount.loadRelaxed() + _pending.loadRelaxed();
+}
+
+void IoThread::addPending()
+{
+    _pending.ref();
+}
+
+void IoThread::post(SessionHandle handle, const WireMessage& message)
+{
+    QMetaObject::invokeMethod(this, [this, handle, message]() {
+        deliver(handle, message);
+        }, Qt::QueuedConnection);
+}
+
+void IoThread::postBatch(const QVector<SessionHandle>& handles, const WireMessage& message)
+{
+    QMetaObject::invokeMethod(this, [this, handles, message]() {
+        deliverBatch(handles, message);
+        }, Qt::QueuedConnection);
+}
+
+void IoThread::setWireFormat(SessionHandle handle, WireFormat::Format format)
+{
+    QMetaObject::invokeMethod(this, [this, handle, format]() {
+        ClientSession* session = _sessions->session(handle, this);
+        if (session != nullptr) {
+            session->setWireFormat(format);
+        }
+        }, Qt::QueuedConnection);
+}
+
+void IoThread::acceptConnection(qintptr descriptor)
+{
+    _pending.deref();
+
+    // Created here so the socket and its notifiers belong to this thread from the start
+    QTcpSocket* socket = new QTcpSocket();
+    if (!socket->setSocketDescriptor(descriptor)) {
+        WARNING() << "IoThread" << _id << ": invalid socket descriptor," << socket->errorString();
+        delete socket;
+        return;
+    }
+    _upgrader->handleConnection(socket);
+}
+
+void IoThread::closeAll()
+{
+    for (SessionHandle handle : _sessions->ownedBy(this)) {
+        ClientSession* session = _sessions->session(handle, this);
+        if (session == nullptr) continue;
+        _sessions->close(handle);
+        _sessionCount.deref();
+        _onClose(handle, session->id());
+        session->close();
+        delete session;
+    }
+}
+
+void IoThread::onNewConnection()
+{
+    while (_upgrader->hasPendingConnections()) {
+        QWebSocket* webSocket = _upgrader->nextPendingConnection();
+        ClientSession* session = new ClientSession(webSocket, this);
+        // Opened before the event loop can deliver its first message, so a response is always routable
+        const SessionHandle handle = _sessions->open(session->id(), this, session);
+        if (handle == NO_SESSION) {
+            CRITICAL() << "IoThread" << _id << ": session table full, refusing" << session->id();
+            session->close();
+            delete session;
+            continue;
+        }
+        _sessionCount.ref();
+        Metrics::instance().add(Metrics::CONNECTIONS_ACCEPTED);
+
+        // The handle travels with every message, so nothing downstream hashes the ID again
+        connect(session, &ClientSession::sigDisconnected, this, [this, handle]() {
+            onSessionClosed(handle);
+            });
+        connect(session, &ClientSession::sigDataReady, this, [this, handle](const QString& srcId, const WireMessage& data) {
+            _onData(handle, srcId, data);
+            });
+    }
+}
+
+void IoThread::deliver(SessionHandle handle, const WireMessage& message)
+{
+    WireMessage converted = message;
+    deliverTo(handle, converted);
+}
+
+void IoThread::deliverBatch(const QVector<SessionHandle>& handles, const WireMessage& message)
+{
+    // Shared by the batch: a JSON broadcast is encoded once for all binary sessions of this thread
+    WireMessage shared = message;
+    for (SessionHandle handle : handles) {
+        deliverTo(handle, shared);
+    }
+}
+
+void IoThread::deliverTo(SessionHandle handle, WireMessage& message)
+{
+    ClientSession* session = _sessions->session(handle, this);
+    if (session == nullptr) {
+        Metrics::instance().add(Metrics::TARGET_OFFLINE);
+        LOG_EVENT(LOG_LEVEL_WARNING, "target_offline", { "to", handle });
+        return;
+    }
+    message.prepare(session->wireFormat());
+    session->sendData(message);
+}
+
+void IoThread::onSessionClosed(SessionHandle handle)
+{
+    ClientSession* session = _sessions->session(handle, this);
+    if (session == nullptr) return;
+
+    _sessions->close(handle);
+    _sessionCount.deref();
+    _onClose(handle, session->id());
+    session->deleteLater();
+}
+
+// IoThreadPool >>>>>>>>>>>>>>>>>
+
+IoThreadPool::IoThreadPool(QObject* parent)
+    : QObject(parent), _next(0), _isRunning(false)
+{}
+
+IoThreadPool::~IoThreadPool()
+{
+    if (_isRunning.loadRelaxed()) {
+        stop();
+    }
+}
+
+bool IoThreadPool::start(size_t threadCount, IoThread::DataHandler onData, IoThread::CloseHandler onClose)
+{
+    if (!_isRunning.testAndSetRelaxed(false, true)) {
+        WARNING() << "IoThreadPool: Already running.";
+        return false;
+    }
+    else if (threadCount == 0) {
+        FATAL() << "Thread count must be greater than 0, you input: " << threadCount;
+        assert(threadCount > 0);
+    }
+
+    for (int i = 0; i < threadCount; ++i) {
+        QThread* thread = new QThread(this);
+        IoThread* ioThread = new IoThread(i + 1, &_sessions, onData, onClose, nullptr);
+
+        ioThread->moveToThread(thread);
+        connect(thread, &QThread::finished, ioThread, &QObject::deleteLater);
+
+        _threads.append(thread);
+        _ioThreads.append(ioThread);
+        thread->start();
+    }
+    INFO() << "IoThreadPool started with" << threadCount << "threads.";
+    return true;
+}
+
+bool IoThreadPool::stop()
+{
+    if (!_isRunning.testAndSetOrdered(true, false)) { return false; }
+
+    for (IoThread* ioThread : _ioThreads) {
+        QMetaObject::invokeMethod(ioThread, &IoThread::closeAll, Qt::BlockingQueuedConnection);
+    }
+    for (QThread* thread : _threads) {
+        if (thread->isRunning()) {
+            thread->quit();
+            thread->wait();
+        }
+    }
+    INFO() << "wait all I/O threads successfully!";
+    _threads.clear();
+    _ioThreads.clear();
+    return true;
+}
+
+void IoThreadPool::dispatch(qintptr descriptor)
+{
+    if (_ioThreads.isEmpty()) {
+        CRITICAL() << "IoThreadPool is not running!";
+        return;
+    }
+
+    // Least loaded, scanning from the round-robin position so equal loads rotate
+    const int count = _ioThreads.size();
+    IoThread* target = _ioThreads[_next % count];
+    for (int n = 1; n < count; ++n) {
+        IoThread* candidate = _ioThreads[(_next + n) % count];
+        if (candidate->load() < target->load()) {
+            target = candidate;
+        }
+    }
+    _next = (_ioThreads.indexOf(target) + 1) % count;
+
+    target->addPending();
+    QMetaObject::invokeMethod(target, [target, descriptor]() {
+        target->acceptConnection(descriptor);
+        }, Qt::QueuedConnection);
+}
+
+SessionTable& IoThreadPool::sessions() { return _sessions; }
+
+int IoThreadPool::threadCount() const { return _ioThreads.size(); }
+
+// IoAcceptor >>>>>>>>>>>>>>>>>
+
+IoAcceptor::IoAcceptor(IoThreadPool* pool, QObject* parent)
+    : QTcpServer(parent), _pool(pool)
+{
+    assert(pool != nullptr);
+}
+
+void IoAcceptor::incomingConnection(qintptr descriptor)
+{
+    _pool->dispatch(descriptor);
+}
@@ -0,0 +1,230 @@
+#ifndef __IO_THREAD_POOL_H__
+#define __IO_THREAD_POOL_H__
+
+#include "Common.hpp"
+#include "SessionTable.hpp"
+#include "WireFormat.hpp"
+
+#include <QTcpServer>
+#include <QVector>
+
+class ClientSession;
+class IoThread;
+
+/**
+* @brief Number of I/O threads; 0 = half the cores (at least 1), the other half runs Workers.
+*/
+const int DEFAULT_IO_THREAD_NUMBER = 0;
+
+/**
+* @class IoThread
+* @brief Event loop that owns a subset of the client sockets.
+*
+* Lives on its own QThread. Accepted socket descriptors are upgraded to WebSockets here, so the
+* handshake, frame decoding, sends and disconnects of its sessions never touch the
+* main thread. Received messages go straight to the WorkerPool through the data handler.
+*/
+class IoThread : public QObject
+{
+   Q_OBJECT
+
+public:
+   /**
+    * @brief Called on the I/O thread for every text or binary message received.
+    */
+   using DataHandler = std::function<void(SessionHandle handle, const QString& clientId, const WireMessage& data)>;
+
+   /**
+    * @brief Called on the I/O thread after a session closed; its handle is already stale.
+    */
+   using CloseHandler = std::function<void(SessionHandle handle, const QString& clientId)>;
+
+   /**
+    * @brief Constructs an IoThread; move it to its QThread before use.
+    * @param id Unique identifier for the IoThread, 1-based.
+    * @param sessions Shared session table.
+    * @param onData Handler for received messages.
+    * @param onClose Handler for closed sessions.
+    * @param parent Pointer to the parent QObject (default is nullptr).
+    */
+   IoThread(int id, SessionTable* sessions, DataHandler onData, CloseHandler onClose, QObject* parent = nullptr);
+
+   /**
+    * @brief Destructor for the IoThread class.
+    */
+   ~IoThread();
+
+   /**
+    * @brief Retrieves the unique identifier of the IoThread.
+    */
+   int getId() const;
+
+   /**
+    * @brief Gets the open sessions plus the descriptors queued to acceptConnection(). Safe from any thread.
+    */
+   int load() const;
+
+   /**
+    * @brief Counts a descriptor about to be queued to acceptConnection(); called by the pool.
+    */
+   void addPending();
+
+   /**
+    * @brief Queues a message for one of this thread's sessions. Safe from any thread.
+    * @param handle The target session.
+    * @param message The message to send, converted to the session's wire format on delivery.
+    */
+   void post(SessionHandle handle, const WireMessage& message);
+
+   /**
+    * @brief Queues one message for several of this thread's sessions. Safe from any thread.
+    * One queued call for the whole batch; every session sends the same shared message, converted
+    * at most once for the sessions of the other wire format.
+    * @param handles The target sessions.
+    * @param message The message to send.
+    */
+   void postBatch(const QVector<SessionHandle>& handles, const WireMessage& message);
+
+   /**
+    * @brief Switches the encoding of one of this thread's sessions. Safe from any thread; queued
+    * behind the messages already posted to the session, so those still go out in the old format.
+    * @param handle The session.
+    * @param format The format negotiated at REGISTER.
+    */
+   void setWireFormat(SessionHandle handle, WireFormat::Format format);
+
+   /**
+    * @brief Upgrades an accepted TCP connection to a WebSocket session. Runs on this thread.
+    * @param descriptor Native socket descriptor from QTcpServer::incomingConnection().
+    */
+   void acceptConnection(qintptr descriptor);
+
+   /**
+    * @brief Flushes and closes every session of this thread. Runs on this thread.
+    */
+   void closeAll();
+
+private:
+   /**
+    * @brief Creates ClientSessions for completed WebSocket handshakes.
+    */
+   void onNewConnection();
+
+   /**
+    * @brief Sends a posted message if the session is still open.
+    */
+   void deliver(SessionHandle handle, const WireMessage& message);
+
+   /**
+    * @brief Sends a posted broadcast to every session of the batch that is still open.
+    */
+   void deliverBatch(const QVector<SessionHandle>& handles, const WireMessage& message);
+
+   /**
+    * @brief Sends to one session in its wire format; the conversion is cached in the message.
+    */
+   void deliverTo(SessionHandle handle, WireMessage& message);
+
+   /**
+    * @brief Removes a disconnected session.
+    */
+   void onSessionClosed(SessionHandle handle);
+
+private:
+   int _id;                                  ///< Unique identifier for the IoThread.
+   SessionTable* _sessions;                  ///< Shared session table; holds this thread's sessions too.
+   DataHandler _onData;                      ///< Handler for received messages.
+   CloseHandler _onClose;                    ///< Handler for closed sessions.
+   QWebSocketServer* _upgrader;              ///< Handshakes only, never listens.
+   QAtomicInt _sessionCount;                 ///< Open sessions.
+   QAtomicInt _pending;                      ///< Descriptors queued but not yet accepted.
+};
+
+/**
+* @class IoThreadPool
+* @brief Spreads client sockets over several IoThreads.
+*
+* New connections go to the thread with the fewest sessions; ties are broken round-robin, so a
+* burst of connects is spread evenly even before any of them is accepted.
+*/
+class IoThreadPool : public QObject
+{
+   Q_OBJECT
+
+public:
+   /**
+    * @brief Constructs an IoThreadPool instance.
+    * @param parent Pointer to the parent QObject (default is nullptr).
+    */
+   explicit IoThreadPool(QObject* parent = nullptr);
+
+   /**
+    * @brief Destructor for the IoThreadPool class. Closes all sessions and joins the threads.
+    */
+   ~IoThreadPool();
+
+   Q_DISABLE_COPY(IoThreadPool)
+
+   /**
+    * @brief Starts the I/O threads.
+    * @param threadCount The number of threads to create.
+    * @param onData Handler for received messages, called on the I/O threads.
+    * @param onClose Handler for closed sessions, called on the I/O threads.
+    * @return True if the pool starts successfully, false if it is already running.
+    */
+   bool start(size_t threadCount, IoThread::DataHandler onData, IoThread::CloseHandler onClose);
+
+   /**
+    * @brief Closes all sessions and waits for the I/O threads to exit.
+    * @return True if the pool stops successfully, false if it was not running.
+    */
+   bool stop();
+
+   /**
+    * @brief Hands an accepted connection to the least-loaded I/O thread.
+    * @param descriptor Native socket descriptor from QTcpServer::incomingConnection().
+    */
+   void dispatch(qintptr descriptor);
+
+   /**
+    * @brief Gets the table of open sessions.
+    */
+   SessionTable& sessions();
+
+   /**
+    * @brief Gets the number of running I/O threads.
+    */
+   int threadCount() const;
+
+private:
+   SessionTable _sessions;        ///< Shared by the IoThreads and the Workers.
+   QVector<QThread*> _threads;    ///< Container for QThread instances.
+   QVector<IoThread*> _ioThreads; ///< Container for IoThread objects.
+   int _next;                     ///< Round-robin start for the least-loaded scan.
+   QAtomicInt _isRunning;         ///< Atomic flag indicating whether the pool is running.
+};
+
+/**
+* @class IoAcceptor
+* @brief Listening socket on the main thread; only accepts and hands descriptors to the pool.
+*/
+class IoAcceptor : public QTcpServer
+{
+   Q_OBJECT
+
+public:
+   /**
+    * @brief Constructs an IoAcceptor.
+    * @param pool The pool receiving accepted connections.
+    * @param parent Pointer to the parent QObject (default is nullptr).
+    */
+   explicit IoAcceptor(IoThreadPool* pool, QObject* parent = nullptr);
+
+protected:
+   void incomingConnection(qintptr descriptor) override;
+
+private:
+   IoThreadPool* _pool;  ///< The pool receiving accepted connections.
+};
+
+#endif // __IO_THREAD_POOL_H__
@@ -0,0 +1,236 @@
+#include "Metrics.h"
+
+#include <QTimer>
+
+#include <cmath>
+
+/**
+* @brief Counters of one thread. Written by that thread only, read by scrape().
+*/
+struct alignas(64) MetricsShard {
+    std::atomic<quint64> counters[Metrics::COUNTER_COUNT];
+    std::atomic<quint64> messages[Metrics::TYPE_COUNT];
+    std::atomic<quint64> latencySumNs[Metrics::TYPE_COUNT];
+    std::atomic<quint64> buckets[Metrics::TYPE_COUNT][Metrics::BUCKET_COUNT + 1];  ///< Last one: above the range.
+};
+
+namespace
+{
+    thread_local MetricsShard* t_shard = nullptr;
+
+    struct CounterInfo { const char* name; const char* help; };
+    const CounterInfo COUNTERS[Metrics::COUNTER_COUNT] = {
+        { "signaling_connections_accepted_total", "WebSocket handshakes completed." },
+        { "signaling_messages_sent_total", "Messages written to clients." },
+        { "signaling_bytes_sent_total", "Bytes written to clients." },
+        { "signaling_send_failures_total", "Sends on a closed socket or cut short." },
+        { "signaling_tasks_dropped_total", "Received messages dropped because the task queue was full." },
+        { "signaling_target_offline_total", "Responses whose target disconnected before delivery." },
+        { "signaling_errors_sent_total", "ERROR_MESSAGE replies sent." },
+    };
+
+    // Types a client can send; anything else is counted as UNKNOWN
+    const SignalingType RECEIVED_TYPES[] = {
+        SignalingType::REGISTER_REQUEST, SignalingType::OFFER, SignalingType::ANSWER,
+        SignalingType::ICE, SignalingType::JOIN_ROOM, SignalingType::LEAVE_ROOM, SignalingType::UNKNOWN
+    };
+
+    const int REQUEST_HEAD_LIMIT = 8192;
+    const int REQUEST_TIMEOUT_MS = 5000;
+
+    // Single writer: a plain load and store, no locked read-modify-write
+    inline void bump(std::atomic<quint64>& value, quint64 n)
+    {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    QByteArray typeLabel(SignalingType type)
+    {
+        return "type=\"" + stype_to_string(type).toLatin1() + '"';
+    }
+}
+
+// Metrics >>>>>>>>>>>>>>>>>
+
+Metrics& Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+void Metrics::add(Counter counter, quint64 n)
+{
+    bump(localShard()->counters[counter], n);
+}
+
+void Metrics::observeMessage(SignalingType type, qint64 latencyNs)
+{
+    const int index = qBound(0, static_cast<int>(type), TYPE_COUNT - 1);
+    MetricsShard* shard = localShard();
+    bump(shard->messages[index], 1);
+    bump(shard->latencySumNs[index], static_cast<quint64>(qMax<qint64>(0, latencyNs)));
+    bump(shard->buckets[index][bucketOf(latencyNs)], 1);
+}
+
+QByteArray Metrics::scrape() const
+{
+    quint64 counters[COUNTER_COUNT] = {};
+    quint64 messages[TYPE_COUNT] = {};
+    quint64 latencySumNs[TYPE_COUNT] = {};
+    std::vector<quint64> buckets(TYPE_COUNT * (BUCKET_COUNT + 1), 0);
+    {
+        std::lock_guard<std::mutex> guard(_registryMutex);
+        for (const std::unique_ptr<MetricsShard>& shard : _shards) {
+            for (int c = 0; c < COUNTER_COUNT; ++c) {
+                counters[c] += shard->counters[c].load(std::memory_order_relaxed);
+            }
+            for (int t = 0; t < TYPE_COUNT; ++t) {
+                messages[t] += shard->messages[t].load(std::memory_order_relaxed);
+                latencySumNs[t] += shard->latencySumNs[t].load(std::memory_order_relaxed);
+                for (int b = 0; b <= BUCKET_COUNT; ++b) {
+                    buckets[t * (BUCKET_COUNT + 1) + b] += shard->buckets[t][b].load(std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+    QByteArray out;
+    out.reserve(64 * 1024);
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        appendFamily(out, COUNTERS[c].name, "counter", COUNTERS[c].help);
+        appendSample(out, COUNTERS[c].name, QByteArray(), static_cast<double>(counters[c]));
+    }
+
+    appendFamily(out, "signaling_messages_received_total", "counter", "Messages processed by the Workers, by type.");
+    for (SignalingType type : RECEIVED_TYPES) {
+        appendSample(out, "signaling_messages_received_total", typeLabel(type), static_cast<double>(messages[static_cast<int>(type)]));
+    }
+
+    appendFamily(out, "signaling_forward_latency_seconds", "histogram",
+        "Time from receipt on the I/O thread until the responses are handed to the target's I/O thread.");
+    for (SignalingType type : RECEIVED_TYPES) {
+        const int t = static_cast<int>(type);
+        const QByteArray label = typeLabel(type);
+        quint64 cumulative = 0;
+        for (int b = 0; b < BUCKET_COUNT; ++b) {
+            cumulative += buckets[t * (BUCKET_COUNT + 1) + b];
+            appendSample(out, "signaling_forward_latency_seconds_bucket",
+                label + ",le=\"" + QByteArray::number(bucketUpperSeconds(b), 'g', 6) + '"', static_cast<double>(cumulative));
+        }
+        // Samples are counted once per shard, so +Inf and _count agree even while writers run
+        const double count = static_cast<double>(cumulative + buckets[t * (BUCKET_COUNT + 1) + BUCKET_COUNT]);
+        appendSample(out, "signaling_forward_latency_seconds_bucket", label + ",le=\"+Inf\"", count);
+        appendSample(out, "signaling_forward_latency_seconds_sum", label, latencySumNs[t] / 1e9);
+        appendSample(out, "signaling_forward_latency_seconds_count", label, count);
+    }
+    return out;
+}
+
+double Metrics::bucketUpperSeconds(int bucket)
+{
+    const int octave = bucket / SUB_BUCKETS;
+    const int sub = bucket % SUB_BUCKETS;
+    return std::ldexp(1.0 + static_cast<double>(sub + 1) / SUB_BUCKETS, octave) / 1e6;
+}
+
+int Metrics::bucketOf(qint64 latencyNs)
+{
+    const double micros = latencyNs / 1e3;
+    if (micros <= 1.0) return 0;
+
+    // micros = mantissa * 2^exponent, mantissa in [0.5, 1): octave exponent - 1, position in it 2 * mantissa - 1
+    int exponent = 0;
+    const double mantissa = std::frexp(micros, &exponent);
+    const int octave = exponent - 1;
+    // Bounds are inclusive ("le"): an exact power of two closes the previous octave
+    const int bucket = octave * SUB_BUCKETS + static_cast<int>(std::ceil((2.0 * mantissa - 1.0) * SUB_BUCKETS)) - 1;
+    return qMin(bucket, BUCKET_COUNT);
+}
+
+void Metrics::appendFamily(QByteArray& out, const char* name, const char* type, const char* help)
+{
+    out.append("# HELP ").append(name).append(' ').append(help).append('\n');
+    out.append("# TYPE ").append(name).append(' ').append(type).append('\n');
+}
+
+void Metrics::appendSample(QByteArray& out, const char* name, const QByteArray& labels, double value)
+{
+    out.append(name);
+    if (!labels.isEmpty()) {
+        out.append('{').append(labels).append('}');
+    }
+    out.append(' ').append(QByteArray::number(value, 'g', 15)).append('\n');
+}
+
+MetricsShard* Metrics::localShard()
+{
+    if (t_shard == nullptr) {
+        std::unique_ptr<MetricsShard> shard(new MetricsShard());  // value-initialized: all zero
+        t_shard = shard.get();
+        std::lock_guard<std::mutex> guard(_registryMutex);
+        _shards.push_back(std::move(shard));
+    }
+    return t_shard;
+}
+
+// MetricsServer >>>>>>>>>>>>>>>>>
+
+MetricsServer::MetricsServer(Renderer render, QObject* parent)
+    : QTcpServer(parent), _render(std::move(render))
+{}
+
+void MetricsServer::incomingConnection(qintptr descriptor)
+{
+    QTcpSocket* socket = new QTcpSocket(this);
+    if (!socket->setSocketDescriptor(descriptor)) {
+        WARNING() << "MetricsServer: invalid socket descriptor," << socket->errorString();
+        delete socket;
+        return;
+    }
+
+    connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+        if (socket->property("answered").toBool()) {
+            socket->readAll();
+            return;
+        }
+        QByteArray head = socket->property("head").toByteArray() + socket->readAll();
+        const qsizetype end = head.indexOf("\r\n\r\n");
+        if (end < 0 && head.size() <= REQUEST_HEAD_LIMIT) {
+            socket->setProperty("head", head);
+            return;
+        }
+        socket->setProperty("answered", true);
+        respond(socket, end < 0 ? QByteArray() : head.left(end));
+        });
+    // A scraper that never finishes its request does not keep the socket forever
+    QTimer::singleShot(REQUEST_TIMEOUT_MS, socket, [socket]() { socket->abort(); });
+}
+
+void MetricsServer::respond(QTcpSocket* socket, const QByteArray& head)
+{
+    // Request line: METHOD SP TARGET SP VERSION
+    const QList<QByteArray> requestLine = head.left(head.indexOf("\r\n")).split(' ');
+    QByteArray status = "200 OK";
+    QByteArray body;
+    if (requestLine.size() != 3) {
+        status = "400 Bad Request";
+    }
+    else if (requestLine[0] != "GET") {
+        status = "405 Method Not Allowed";
+    }
+    else if (requestLine[1].split('?').first() != "/metrics") {
+        status = "404 Not Found";
+    }
+    else {
+        body = _render();
+    }
+
+    QByteArray response = "HTTP/1.1 " + status + "\r\n";
+    response += "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n";
+    response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    response += body;
+    socket->write(response);
+    socket->disconnectFromHost();  // after the pending bytes are written
+}
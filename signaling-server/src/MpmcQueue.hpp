@@ -0,0 +1,363 @@
+#ifndef __MPMC_QUEUE_HPP__
+#define __MPMC_QUEUE_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>   // WaitOnAddress / WakeByAddress*, link Synchronization.lib
+#elif defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <ctime>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+/**
+* @class EventCount
+* @brief Lets threads sleep until "something changed" without a mutex on the fast path.
+*
+* A waiter takes a key with prepareWait(), re-checks its condition and only then calls wait(key).
+* A notifier that changed the condition calls notify(); it is a single atomic load when nobody
+* sleeps. The 32-bit epoch doubles as the futex word (Linux futex, Windows WaitOnAddress), so a
+* notify() between prepareWait() and wait() is never lost: the kernel compares the epoch before
+* putting the thread to sleep.
+*/
+class EventCount
+{
+public:
+ EventCount() = default;
+ EventCount(const EventCount&) = delete;
+ EventCount& operator=(const EventCount&) = delete;
+
+ /**
+  * @brief Announces a waiter and returns the key to pass to wait() or cancelWait().
+  */
+ uint32_t prepareWait() {
+     _waiters.fetch_add(1, std::memory_order_seq_cst);
+     return _epoch.load(std::memory_order_seq_cst);
+ }
+
+ /**
+  * @brief Withdraws a prepareWait() whose condition turned out to be satisfied.
+  */
+ void cancelWait() {
+     _waiters.fetch_sub(1, std::memory_order_relaxed);
+ }
+
+ /**
+  * @brief Sleeps until notify() moves the epoch past key or the timeout expires.
+  * @param key Value returned by prepareWait().
+  * @param timeoutMs Maximum time to sleep, negative waits forever.
+  * @return false on timeout. Spurious wake-ups return true; callers re-check their condition.
+  */
+ bool wait(uint32_t key, int timeoutMs) {
+     const bool woken = waitOnEpoch(key, timeoutMs);
+     _waiters.fetch_sub(1, std::memory_order_relaxed);
+     return woken;
+ }
+
+ /**
+  * @brief Wakes one (or all) sleeping waiters. Cheap when there are none.
+  */
+ void notify(bool all = false) {
+     // Pairs with the seq_cst increment in prepareWait(): either the waiter sees the new
+     // state on its re-check, or we see the waiter here
+     std::atomic_thread_fence(std::memory_order_seq_cst);
+     if (_waiters.load(std::memory_order_relaxed) == 0) return;
+     _epoch.fetch_add(1, std::memory_order_seq_cst);
+     wakeEpoch(all);
+ }
+
+private:
+#if defined(_WIN32)
+ bool waitOnEpoch(uint32_t key, int timeoutMs) {
+     uint32_t expected = key;
+     if (WaitOnAddress(&_epoch, &expected, sizeof(expected), timeoutMs < 0 ? INFINITE : static_cast<DWORD>(timeoutMs))) {
+         return true;
+     }
+     return GetLastError() != ERROR_TIMEOUT;
+ }
+
+ void wakeEpoch(bool all) {
+     if (all) WakeByAddressAll(&_epoch);
+     else WakeByAddressSingle(&_epoch);
+ }
+#elif defined(__linux__)
+ bool waitOnEpoch(uint32_t key, int timeoutMs) {
+     timespec ts{};
+     if (timeoutMs >= 0) {
+         ts.tv_sec = timeoutMs / 1000;
+         ts.tv_nsec = static_cast<long>(timeoutMs % 1000) * 1000000L;
+     }
+     const long rc = syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_epoch), FUTEX_WAIT_PRIVATE, key,
+         timeoutMs >= 0 ? &ts : nullptr, nullptr, 0);
+     return rc == 0 || errno != ETIMEDOUT;
+ }
+
+ void wakeEpoch(bool all) {
+     syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_epoch), FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1,
+         nullptr, nullptr, 0);
+ }
+#else
+ bool waitOnEpoch(uint32_t key, int timeoutMs) {
+     std::unique_lock<std::mutex> guard(_mutex);
+     auto changed = [&] { return _epoch.load(std::memory_order_relaxed) != key; };
+     if (timeoutMs < 0) {
+         _cond.wait(guard, changed);
+         return true;
+     }
+     return _cond.wait_for(guard, std::chrono::milliseconds(timeoutMs), changed);
+ }
+
+ void wakeEpoch(bool all) {
+     std::lock_guard<std::mutex> guard(_mutex);
+     if (all) _cond.notify_all();
+     else _cond.notify_one();
+ }
+
+ std::mutex _mutex;
+ std::condition_variable _cond;
+#endif
+
+ static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be a plain 32-bit integer");
+
+ std::atomic<uint32_t> _epoch{ 0 };  ///< Futex word, bumped by every notify() that has waiters.
+ std::atomic<int> _waiters{ 0 };     ///< Threads between prepareWait() and the end of wait().
+};
+
+/**
+* @class MpmcQueue
+* @brief A bounded lock-free multi-producer multi-consumer queue.
+*
+* Dmitry Vyukov's sequence ring: every cell carries a sequence number that tells producers and
+* consumers whether it is free for the current lap, so push and pop are one CAS on their own
+* index plus one store on the cell, and producers never touch the consumers' cache line.
+* Blocking pop() spins briefly and then sleeps on an EventCount instead of polling.
+*
+* Drop-in for BlockingQueue (same bqPtr, push/pop/tryPop/size/empty/notify API), except that
+* the capacity is fixed: push() returns false when the ring is full.
+*
+* @tparam T The type of elements stored in the queue.
+*/
+template<class T>
+class MpmcQueue
+{
+public:
+ using bqPtr = std::shared_ptr<MpmcQueue<T>>;
+
+ static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+ /**
+  * @brief Constructs the queue.
+  * @param capacity Number of slots, rounded up to a power of two (at least 2).
+  */
+ explicit MpmcQueue(size_t capacity = DEFAULT_CAPACITY) {
+     size_t size = 2;
+     while (size < capacity) size <<= 1;
+     _mask = size - 1;
+     _cells.reset(new Cell[size]);
+     for (size_t i = 0; i < size; ++i) {
+         _cells[i].sequence.store(i, std::memory_order_relaxed);
+     }
+ }
+
+ /**
+  * @brief Destroys the elements still in the queue.
+  */
+ ~MpmcQueue() {
+     T value;
+     while (tryPop(value)) {}
+ }
+
+ MpmcQueue(const MpmcQueue&) = delete;
+ MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+ /**
+  * @brief Pushes an element into the queue. Never blocks.
+  * @param ele The element to be added to the queue.
+  * @return true if added, false if the queue is full or closed.
+  */
+ bool push(const T& ele) { return emplace(ele); }
+
+ /**
+  * @brief Pushes an element into the queue by move. Never blocks.
+  */
+ bool push(T&& ele) { return emplace(std::move(ele)); }
+
+ /**
+  * @brief Pops an element, sleeping until one arrives, the timeout expires or close() is called.
+  * @param value Reference to store the dequeued element.
+  * @param timeoutMs The maximum time to wait in milliseconds, negative waits forever.
+  * @return true if an element is dequeued, false on timeout or when closed and empty.
+  */
+ bool pop(T& value, int timeoutMs) {
+     for (int spin = 0; spin < SPIN_COUNT; ++spin) {
+         if (tryPop(value)) return true;
+         if (_closed.load(std::memory_order_acquire)) return tryPop(value);
+     }
+
+     const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs < 0 ? 0 : timeoutMs);
+     while (true) {
+         const uint32_t key = _notEmpty.prepareWait();
+         if (tryPop(value)) {
+             _notEmpty.cancelWait();
+             return true;
+         }
+         if (_closed.load(std::memory_order_acquire)) {
+             _notEmpty.cancelWait();
+             return false;
+         }
+
+         int waitMs = -1;
+         if (timeoutMs >= 0) {
+             const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+             if (left <= 0) {
+                 _notEmpty.cancelWait();
+                 return false;
+             }
+             waitMs = static_cast<int>(left);
+         }
+         _notEmpty.wait(key, waitMs);
+     }
+ }
+
+ /**
+  * @brief Attempts to pop an element from the queue without blocking.
+  * @param value Reference to store the dequeued element.
+  * @return true if an element is successfully dequeued, false otherwise.
+  */
+ bool tryPop(T& value) {
+     size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+     Cell* cell;
+     while (true) {
+         cell = &_cells[pos & _mask];
+         const size_t seq = cell->sequence.load(std::memory_order_acquire);
+         const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+         if (diff == 0) {
+             if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+         }
+         else if (diff < 0) {
+             return false; // empty
+         }
+         else {
+             pos = _dequeuePos.load(std::memory_order_relaxed);
+         }
+     }
+
+     T* slot = cell->item();
+     value = std::move(*slot);
+     slot->~T();
+     cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+     return true;
+ }
+
+ /**
+  * @brief Gets the approximate number of elements (exact when the queue is quiescent).
+  */
+ size_t size() const {
+     const size_t enq = _enqueuePos.load(std::memory_order_relaxed);
+     const size_t deq = _dequeuePos.load(std::memory_order_relaxed);
+     return enq > deq ? enq - deq : 0;
+ }
+
+ /**
+  * @brief Checks if the queue is (approximately) empty.
+  */
+ bool empty() const { return size() == 0; }
+
+ /**
+  * @brief Returns the fixed number of slots.
+  */
+ size_t capacity() const { return _mask + 1; }
+
+ /**
+  * @brief Notifies one waiting thread.
+  */
+ void notifyOne() { _notEmpty.notify(false); }
+
+ /**
+  * @brief Notifies all waiting threads.
+  */
+ void notifyAll() { _notEmpty.notify(true); }
+
+ /**
+  * @brief Rejects further pushes and releases every blocked pop() once the queue is drained.
+  */
+ void close() {
+     _closed.store(true, std::memory_order_release);
+     notifyAll();
+ }
+
+ /**
+  * @brief Accepts pushes again after close().
+  */
+ void open() { _closed.store(false, std::memory_order_release); }
+
+ /**
+  * @brief Checks whether close() has been called.
+  */
+ bool isClosed() const { return _closed.load(std::memory_order_acquire); }
+
+private:
+ static constexpr int SPIN_COUNT = 64;
+ static constexpr size_t CACHE_LINE = 64;
+
+ struct Cell {
+     std::atomic<size_t> sequence{ 0 };
+     typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+     T* item() { return std::launder(reinterpret_cast<T*>(&storage)); }
+ };
+
+ template<class U>
+ bool emplace(U&& ele) {
+     if (_closed.load(std::memory_order_relaxed)) return false;
+
+     size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+     Cell* cell;
+     while (true) {
+         cell = &_cells[pos & _mask];
+         const size_t seq = cell->sequence.load(std::memory_order_acquire);
+         const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+         if (diff == 0) {
+             if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+         }
+         else if (diff < 0) {
+             return false; // full
+         }
+         else {
+             pos = _enqueuePos.load(std::memory_order_relaxed);
+         }
+     }
+
+     new (&cell->storage) T(std::forward<U>(ele));
+     cell->sequence.store(pos + 1, std::memory_order_release);
+     _notEmpty.notify(false);
+     return true;
+ }
+
+ std::unique_ptr<Cell[]> _cells;                      ///< Ring storage, capacity is a power of two.
+ size_t _mask = 0;                                    ///< capacity - 1.
+ alignas(CACHE_LINE) std::atomic<size_t> _enqueuePos{ 0 };  ///< Next slot for producers.
+ alignas(CACHE_LINE) std::atomic<size_t> _dequeuePos{ 0 };  ///< Next slot for consumers.
+ alignas(CACHE_LINE) std::atomic<bool> _closed{ false };    ///< Set by close().
+ EventCount _notEmpty;                                ///< Sleeping consumers.
+};
+
+#endif // __MPMC_QUEUE_HPP__
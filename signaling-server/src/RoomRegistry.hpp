@@ -0,0 +1,182 @@
+#ifndef __ROOM_REGISTRY_HPP__
+#define __ROOM_REGISTRY_HPP__
+
+#include "Common.hpp"
+
+#include <QHash>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QString>
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+/**
+* @class RoomRegistry
+* @brief Room membership: which room each client is in and who is in each room.
+*
+* A client is in at most one room. Clients are SessionHandles, see SessionTable; member sets
+* are immutable snapshots behind a shared_ptr, replaced copy-on-write, so a fan-out iterates its
+* snapshot without holding any lock. Both maps are striped (clients by slot index, rooms by
+* hash) so joins in different rooms do not contend.
+*
+* Locking: the client's stripe (exclusive) is held for a whole join/leave, so the operations
+* of one client are serialized; room stripes are taken inside it, one at a time. Changes to a
+* room are applied one by one under its stripe and each Change carries the snapshot taken in the
+* same step, so callers need no queue ordering of their own (tasks are sharded by sender).
+*/
+class RoomRegistry
+{
+public:
+ using Members = std::shared_ptr<const QSet<SessionHandle>>;
+
+ /**
+  * @brief Outcome of a join or leave, what the caller has to announce.
+  */
+ struct Change {
+     QString left;                 ///< Room the client left, empty if none.
+     Members stayed;               ///< Members remaining in the left room (PEER_LEFT targets).
+     QString joined;               ///< Room the client is in now, empty after a leave.
+     Members before;               ///< Members of the joined room without the client (peer list, PEER_JOINED targets).
+     bool alreadyMember = false;   ///< The client was already in the joined room: nothing to announce.
+ };
+
+ static const size_t STRIPES = 64;
+
+ RoomRegistry() : _roomCount(0) {}
+ ~RoomRegistry() {}
+
+ Q_DISABLE_COPY(RoomRegistry)
+
+ /**
+  * @brief Moves a client into a room, leaving its current room first.
+  * @param client The session of the client.
+  * @param room The room to join, not empty.
+  */
+ Change join(SessionHandle client, const QString& room) {
+     Change change;
+     change.joined = room;
+     ClientStripe& clients = clientStripe(client);
+     QWriteLocker guard(&clients.lock);
+
+     const QString current = clients.roomOf.value(client);
+     if (current == room) {
+         change.alreadyMember = true;
+         change.before = members(room);
+         return change;
+     }
+     if (!current.isEmpty()) {
+         change.left = current;
+         change.stayed = removeMember(current, client);
+     }
+     change.before = addMember(room, client);
+     clients.roomOf.insert(client, room);
+     return change;
+ }
+
+ /**
+  * @brief Takes a client out of its room.
+  * @param client The session of the client.
+  * @return change.left is empty if the client was in no room.
+  */
+ Change leave(SessionHandle client) {
+     Change change;
+     ClientStripe& clients = clientStripe(client);
+     QWriteLocker guard(&clients.lock);
+
+     change.left = clients.roomOf.take(client);
+     if (!change.left.isEmpty()) {
+         change.stayed = removeMember(change.left, client);
+     }
+     return change;
+ }
+
+ /**
+  * @brief Gets the room of a client; empty if it is in none.
+  */
+ QString roomOf(SessionHandle client) const {
+     const ClientStripe& clients = clientStripe(client);
+     QReadLocker guard(&clients.lock);
+     return clients.roomOf.value(client);
+ }
+
+ /**
+  * @brief Gets the current members of a room; an empty set for an unknown room.
+  */
+ Members members(const QString& room) const {
+     const RoomStripe& stripe = roomStripe(room);
+     QMutexLocker guard(&stripe.mutex);
+     return stripe.rooms.value(room, empty());
+ }
+
+ /**
+  * @brief Gets the number of non-empty rooms.
+  */
+ int roomCount() const {
+     return _roomCount.load(std::memory_order_relaxed);
+ }
+
+private:
+ struct ClientStripe {
+     mutable QReadWriteLock lock;
+     QHash<SessionHandle, QString> roomOf;   ///< Client -> room.
+ };
+
+ struct RoomStripe {
+     mutable QMutex mutex;
+     QHash<QString, Members> rooms;    ///< Room -> members, rooms are dropped when they empty.
+ };
+
+ static const Members& empty() {
+     static const Members none = std::make_shared<const QSet<SessionHandle>>();
+     return none;
+ }
+
+ // The low bits are the slot index: dense, so consecutive sessions land on consecutive stripes
+ ClientStripe& clientStripe(SessionHandle client) { return _clients[client % STRIPES]; }
+ const ClientStripe& clientStripe(SessionHandle client) const { return _clients[client % STRIPES]; }
+ RoomStripe& roomStripe(const QString& room) { return _rooms[qHash(room) % STRIPES]; }
+ const RoomStripe& roomStripe(const QString& room) const { return _rooms[qHash(room) % STRIPES]; }
+
+ // Returns the members before the client was added
+ Members addMember(const QString& room, SessionHandle client) {
+     RoomStripe& stripe = roomStripe(room);
+     QMutexLocker guard(&stripe.mutex);
+     auto it = stripe.rooms.find(room);
+     if (it == stripe.rooms.end()) {
+         stripe.rooms.insert(room, std::make_shared<const QSet<SessionHandle>>(QSet<SessionHandle>{ client }));
+         _roomCount.fetch_add(1, std::memory_order_relaxed);
+         return empty();
+     }
+     const Members before = it.value();
+     auto next = std::make_shared<QSet<SessionHandle>>(*before);
+     next->insert(client);
+     it.value() = Members(std::move(next));
+     return before;
+ }
+
+ // Returns the members left in the room
+ Members removeMember(const QString& room, SessionHandle client) {
+     RoomStripe& stripe = roomStripe(room);
+     QMutexLocker guard(&stripe.mutex);
+     auto it = stripe.rooms.find(room);
+     if (it == stripe.rooms.end()) return empty();
+     auto next = std::make_shared<QSet<SessionHandle>>(*it.value());
+     next->remove(client);
+     if (next->isEmpty()) {
+         stripe.rooms.erase(it);
+         _roomCount.fetch_sub(1, std::memory_order_relaxed);
+         return empty();
+     }
+     it.value() = Members(std::move(next));
+     return it.value();
+ }
+
+ std::array<ClientStripe, STRIPES> _clients;
+ std::array<RoomStripe, STRIPES> _rooms;
+ std::atomic<int> _roomCount;
+};
+
+#endif // __ROOM_REGISTRY_HPP__
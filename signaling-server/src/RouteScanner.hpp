@@ -0,0 +1,201 @@
+#ifndef __ROUTE_SCANNER_HPP__
+#define __ROUTE_SCANNER_HPP__
+
+#include <QString>
+#include <QStringView>
+
+#include <cstddef>
+
+/**
+* @namespace RouteScanner
+* @brief Route-only view of a signaling message, without building a QJsonDocument.
+*
+* OFFER/ANSWER/ICE only need "type" and "to" to be routed and "from" to be restamped; the
+* SDP or candidate in "data" is forwarded untouched. scan() walks the top-level object once,
+* records where those three string values are and skips everything else (nested objects and
+* long strings are skipped without being decoded). spliceFrom() then writes the sender ID
+* into the original text. Anything unusual (escapes in the routing fields, a non-object root,
+* broken structure) makes scan() return false and the caller falls back to the full parser.
+*/
+namespace RouteScanner {
+
+ /**
+  * @brief Position of a top-level string value, quotes included. begin < 0 if absent.
+  */
+ struct Span {
+     qsizetype begin = -1;
+     qsizetype end = -1;   ///< One past the closing quote.
+     bool found() const { return begin >= 0; }
+ };
+
+ /**
+  * @brief Routing fields of one message.
+  */
+ struct Route {
+     Span type;
+     Span to;
+     Span from;
+     qsizetype objectBegin = -1;  ///< Offset of the opening '{'.
+ };
+
+ namespace detail {
+     template<class CharT>
+     inline bool isSpace(CharT c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+     template<class CharT>
+     inline qsizetype skipSpace(const CharT* p, qsizetype i, qsizetype n) {
+         while (i < n && isSpace(p[i])) ++i;
+         return i;
+     }
+
+     // p[i] == '"'. Returns one past the closing quote, or -1. escaped tells if '\' was seen.
+     template<class CharT>
+     inline qsizetype skipString(const CharT* p, qsizetype i, qsizetype n, bool& escaped) {
+         escaped = false;
+         for (++i; i < n; ++i) {
+             if (p[i] == '"') return i + 1;
+             if (p[i] == '\\') {
+                 escaped = true;
+                 ++i;
+             }
+         }
+         return -1;
+     }
+
+     // Skips any JSON value starting at p[i]. Returns one past it, or -1.
+     template<class CharT>
+     inline qsizetype skipValue(const CharT* p, qsizetype i, qsizetype n) {
+         if (i >= n) return -1;
+         bool escaped = false;
+         if (p[i] == '"') return skipString(p, i, n, escaped);
+
+         if (p[i] == '{' || p[i] == '[') {
+             int depth = 0;
+             while (i < n) {
+                 const CharT c = p[i];
+                 if (c == '"') {
+                     i = skipString(p, i, n, escaped);
+                     if (i < 0) return -1;
+                     continue;
+                 }
+                 if (c == '{' || c == '[') ++depth;
+                 else if (c == '}' || c == ']') {
+                     if (--depth == 0) return i + 1;
+                 }
+                 ++i;
+             }
+             return -1;
+         }
+
+         // number, true, false, null
+         const qsizetype begin = i;
+         while (i < n && p[i] != ',' && p[i] != '}' && p[i] != ']' && !isSpace(p[i])) ++i;
+         return i > begin ? i : -1;
+     }
+
+     template<class CharT>
+     inline bool keyIs(const CharT* p, qsizetype begin, qsizetype end, const char* key) {
+         // begin/end include the quotes
+         qsizetype i = begin + 1;
+         for (; *key; ++key, ++i) {
+             if (i >= end - 1 || p[i] != static_cast<CharT>(*key)) return false;
+         }
+         return i == end - 1;
+     }
+ }
+
+ /**
+  * @brief Scans the top level of a JSON object for "type", "to" and "from".
+  * @return false if the text is not a well-formed top-level object, a routing field is not a
+  * plain string (non-string values or escape sequences) or occurs twice, or a top-level key has
+  * an escape sequence: a JSON parser downstream would read "fr\u006fm" as "from", so it could
+  * not be told apart from the routing fields checked here.
+  */
+ template<class CharT>
+ bool scan(const CharT* p, qsizetype n, Route& route) {
+     route = Route();
+     qsizetype i = detail::skipSpace(p, 0, n);
+     if (i >= n || p[i] != '{') return false;
+     route.objectBegin = i;
+     i = detail::skipSpace(p, i + 1, n);
+     if (i < n && p[i] == '}') return true;
+
+     while (i < n) {
+         if (p[i] != '"') return false;
+         bool escaped = false;
+         const qsizetype keyBegin = i;
+         const qsizetype keyEnd = detail::skipString(p, i, n, escaped);
+         if (keyEnd < 0 || escaped) return false;
+
+         i = detail::skipSpace(p, keyEnd, n);
+         if (i >= n || p[i] != ':') return false;
+         i = detail::skipSpace(p, i + 1, n);
+
+         Span* field = nullptr;
+         if (detail::keyIs(p, keyBegin, keyEnd, "type")) field = &route.type;
+         else if (detail::keyIs(p, keyBegin, keyEnd, "to")) field = &route.to;
+         else if (detail::keyIs(p, keyBegin, keyEnd, "from")) field = &route.from;
+         // Parsers disagree on which duplicate wins; the one spliced and the one read must be the same
+         if (field && field->found()) return false;
+
+         const qsizetype valueBegin = i;
+         const qsizetype valueEnd = detail::skipValue(p, i, n);
+         if (valueEnd < 0) return false;
+         if (field) {
+             bool valueEscaped = false;
+             if (p[valueBegin] != '"' || detail::skipString(p, valueBegin, n, valueEscaped) != valueEnd || valueEscaped) {
+                 return false;
+             }
+             field->begin = valueBegin;
+             field->end = valueEnd;
+         }
+
+         i = detail::skipSpace(p, valueEnd, n);
+         if (i >= n) return false;
+         if (p[i] == '}') {
+             return detail::skipSpace(p, i + 1, n) == n;
+         }
+         if (p[i] != ',') return false;
+         i = detail::skipSpace(p, i + 1, n);
+     }
+     return false;
+ }
+
+ /**
+  * @brief Scans a message received as text.
+  */
+ inline bool scan(const QString& payload, Route& route) {
+     return scan(reinterpret_cast<const char16_t*>(payload.utf16()), payload.size(), route);
+ }
+
+ /**
+  * @brief The content of a string field, quotes stripped.
+  */
+ inline QStringView value(const QString& payload, const Span& span) {
+     return QStringView(payload).mid(span.begin + 1, span.end - span.begin - 2);
+ }
+
+ /**
+  * @brief Copies the message with "from" set to the given sender; replaces the client's own
+  * "from" or inserts one right after the opening brace. Everything else is left byte for byte.
+  * @param from The sender ID; server-generated, so it needs no JSON escaping.
+  */
+ inline QString spliceFrom(const QString& payload, const Route& route, const QString& from) {
+     QString out;
+     if (route.from.found()) {
+         out.reserve(payload.size() - (route.from.end - route.from.begin) + from.size() + 2);
+         out.append(QStringView(payload).left(route.from.begin));
+         out.append(QLatin1Char('"')).append(from).append(QLatin1Char('"'));
+         out.append(QStringView(payload).mid(route.from.end));
+     }
+     else {
+         out.reserve(payload.size() + from.size() + 10);
+         out.append(QStringView(payload).left(route.objectBegin + 1));
+         out.append(QLatin1String("\"from\":\"")).append(from).append(QLatin1String("\","));
+         out.append(QStringView(payload).mid(route.objectBegin + 1));
+     }
+     return out;
+ }
+}
+
+#endif // __ROUTE_SCANNER_HPP__
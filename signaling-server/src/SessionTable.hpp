@@ -0,0 +1,285 @@
+#ifndef __SESSION_TABLE_HPP__
+#define __SESSION_TABLE_HPP__
+
+#include "Common.hpp"
+
+#include <QHash>
+#include <QReadWriteLock>
+#include <QStringList>
+#include <QVector>
+
+#include <atomic>
+
+class ClientSession;
+class IoThread;
+
+/**
+* @class SessionTable
+* @brief Slot map of the open sessions, addressed by dense 64-bit SessionHandles.
+*
+* A handle is (generation << 32) | slot index. Slots live in fixed-size chunks that never move,
+* so the hot lookups - owner(), session(), isOnline() - index straight into the slot and compare
+* the generation, lock-free and without hashing. A closed slot bumps its generation on reuse,
+* so a stale handle never reaches the next session in that slot.
+*
+* The 32-character external ID is interned once when the session opens: find() maps it to the
+* handle (the only string hash left, for the "to" of client messages) and id()/ids() map back
+* for the protocol. Those and open()/close() take the lock; the slot state is a single atomic
+* word, so a reader that saw it unchanged before and after reading a field read a consistent slot.
+*
+* Threads: open() and close() run on the owning I/O thread; everything else is safe from any
+* thread. The ClientSession pointer may only be dereferenced on its owning I/O thread.
+*/
+class SessionTable
+{
+public:
+ static const int CHUNK_BITS = 12;
+ static const quint32 CHUNK_SIZE = 1u << CHUNK_BITS;   ///< Slots per chunk.
+ static const int MAX_CHUNKS = 1024;                    ///< Up to 4M concurrent sessions.
+
+ SessionTable() : _next(0), _size(0), _online(0) {
+     for (std::atomic<Slot*>& chunk : _chunks) chunk.store(nullptr, std::memory_order_relaxed);
+ }
+ ~SessionTable() {
+     for (std::atomic<Slot*>& chunk : _chunks) delete[] chunk.load(std::memory_order_relaxed);
+ }
+
+ Q_DISABLE_COPY(SessionTable)
+
+ /**
+  * @brief Opens a slot for a new session and interns its ID.
+  * @param clientId The external ID of the session, unique.
+  * @param owner The I/O thread owning the socket.
+  * @param session The session object.
+  * @return The handle, NO_SESSION if the table is full.
+  */
+ SessionHandle open(const QString& clientId, IoThread* owner, ClientSession* session) {
+     QWriteLocker guard(&_lock);
+     quint32 index = 0;
+     if (!_free.isEmpty()) {
+         index = _free.takeLast();   // most recently freed: its cache lines are likely still warm
+     }
+     else {
+         if (_next == static_cast<quint32>(MAX_CHUNKS) * CHUNK_SIZE) return NO_SESSION;
+         index = _next++;
+         if (_chunks[index >> CHUNK_BITS].load(std::memory_order_relaxed) == nullptr) {
+             _chunks[index >> CHUNK_BITS].store(new Slot[CHUNK_SIZE], std::memory_order_release);
+         }
+     }
+
+     Slot& slot = slotAt(index);
+     quint32 generation = static_cast<quint32>(slot.state.load() >> FLAG_BITS) + 1;
+     if (generation == 0) generation = 1;   // 0 would make handle 0 (NO_SESSION) possible
+     slot.id = clientId;
+     slot.owner.store(owner);
+     slot.session.store(session);
+     slot.state.store(static_cast<quint64>(generation) << FLAG_BITS | OPEN);
+
+     const SessionHandle handle = static_cast<SessionHandle>(generation) << 32 | index;
+     _ids.insert(clientId, handle);
+     _size.fetch_add(1, std::memory_order_relaxed);
+     return handle;
+ }
+
+ /**
+  * @brief Closes a session; its handle is stale from now on.
+  */
+ void close(SessionHandle handle) {
+     QWriteLocker guard(&_lock);
+     Slot* slot = openSlot(handle);
+     if (slot == nullptr) return;
+     // Keeps the generation, drops OPEN and ONLINE in one step against a concurrent setOnline()
+     const quint64 previous = slot->state.exchange(static_cast<quint64>(generationOf(handle)) << FLAG_BITS);
+     if (previous & ONLINE) _online.fetch_sub(1, std::memory_order_relaxed);
+     slot->owner.store(nullptr);
+     slot->session.store(nullptr);
+     _ids.remove(slot->id);
+     slot->id.clear();
+     _free.append(indexOf(handle));
+     _size.fetch_sub(1, std::memory_order_relaxed);
+ }
+
+ /**
+  * @brief Looks up an external ID.
+  * @return NO_SESSION if no open session has it.
+  */
+ SessionHandle find(const QString& clientId) const {
+     QReadLocker guard(&_lock);
+     return _ids.value(clientId, NO_SESSION);
+ }
+
+ /**
+  * @brief Gets the external ID of a session; empty if the handle is stale.
+  */
+ QString id(SessionHandle handle) const {
+     QReadLocker guard(&_lock);
+     const Slot* slot = openSlot(handle);
+     return slot != nullptr ? slot->id : QString();
+ }
+
+ /**
+  * @brief Gets the external IDs of several sessions under one lock; stale handles are skipped.
+  */
+ template<class Handles>
+ QStringList ids(const Handles& handles) const {
+     QStringList out;
+     out.reserve(static_cast<qsizetype>(handles.size()));
+     QReadLocker guard(&_lock);
+     for (SessionHandle handle : handles) {
+         const Slot* slot = openSlot(handle);
+         if (slot != nullptr) out.append(slot->id);
+     }
+     return out;
+ }
+
+ /**
+  * @brief Gets the I/O thread owning a session. Lock-free.
+  * @return nullptr if the handle is stale.
+  */
+ IoThread* owner(SessionHandle handle) const {
+     const Slot* slot = slotOf(handle);
+     if (slot == nullptr) return nullptr;
+     const quint64 state = slot->state.load();
+     if (!matches(state, handle)) return nullptr;
+     IoThread* owner = slot->owner.load();
+     // Closed (and maybe reopened) in between: the owner read may belong to the next session
+     return (slot->state.load() & ~ONLINE) == (state & ~ONLINE) ? owner : nullptr;
+ }
+
+ /**
+  * @brief Gets the session object if the caller is its owning I/O thread. Lock-free.
+  * @return nullptr if the handle is stale or owned by another thread.
+  */
+ ClientSession* session(SessionHandle handle, const IoThread* owner) const {
+     const Slot* slot = slotOf(handle);
+     if (slot == nullptr || !matches(slot->state.load(), handle) || slot->owner.load() != owner) return nullptr;
+     // Only the owner closes its slots, so the slot cannot change under the calling thread
+     return slot->session.load();
+ }
+
+ /**
+  * @brief Checks if a session is still open. Lock-free.
+  */
+ bool isOpen(SessionHandle handle) const {
+     const Slot* slot = slotOf(handle);
+     return slot != nullptr && matches(slot->state.load(), handle);
+ }
+
+ /**
+  * @brief Marks an open session as registered. Lock-free; fails once the session closed.
+  * @return true if it was open and not yet registered.
+  */
+ bool setOnline(SessionHandle handle) {
+     Slot* slot = slotOf(handle);
+     if (slot == nullptr) return false;
+     quint64 state = slot->state.load();
+     do {
+         if (!matches(state, handle) || (state & ONLINE)) return false;
+     } while (!slot->state.compare_exchange_weak(state, state | ONLINE));
+     _online.fetch_add(1, std::memory_order_relaxed);
+     return true;
+ }
+
+ /**
+  * @brief Checks if a session is open and registered. Lock-free.
+  */
+ bool isOnline(SessionHandle handle) const {
+     const Slot* slot = slotOf(handle);
+     if (slot == nullptr) return false;
+     const quint64 state = slot->state.load();
+     return matches(state, handle) && (state & ONLINE);
+ }
+
+ /**
+  * @brief Groups recipients by owning thread, for broadcasts. Lock-free.
+  * @param handles The recipients.
+  * @param offline Incremented for every recipient whose session closed.
+  * @return Owning IoThread -> its recipients.
+  */
+ QHash<IoThread*, QVector<SessionHandle>> groupByOwner(const QVector<SessionHandle>& handles, int& offline) const {
+     QHash<IoThread*, QVector<SessionHandle>> groups;
+     for (SessionHandle handle : handles) {
+         IoThread* owner = this->owner(handle);
+         if (owner == nullptr) {
+             ++offline;
+             continue;
+         }
+         groups[owner].append(handle);
+     }
+     return groups;
+ }
+
+ /**
+  * @brief Gets the open sessions of one I/O thread, for closing them all.
+  */
+ QVector<SessionHandle> ownedBy(const IoThread* owner) const {
+     QVector<SessionHandle> handles;
+     QReadLocker guard(&_lock);
+     for (quint32 index = 0; index < _next; ++index) {
+         const Slot& slot = slotAt(index);
+         const quint64 state = slot.state.load();
+         if ((state & OPEN) && slot.owner.load() == owner) {
+             handles.append(static_cast<SessionHandle>(state >> FLAG_BITS) << 32 | index);
+         }
+     }
+     return handles;
+ }
+
+ /**
+  * @brief Gets the number of open sessions.
+  */
+ int size() const { return _size.load(std::memory_order_relaxed); }
+
+ /**
+  * @brief Gets the number of registered sessions.
+  */
+ int onlineCount() const { return _online.load(std::memory_order_relaxed); }
+
+private:
+ static const int FLAG_BITS = 2;
+ static const quint64 OPEN = 1;
+ static const quint64 ONLINE = 2;
+
+ struct Slot {
+     std::atomic<quint64> state{ 0 };              ///< generation << FLAG_BITS | ONLINE | OPEN.
+     std::atomic<IoThread*> owner{ nullptr };
+     std::atomic<ClientSession*> session{ nullptr };
+     QString id;                                  ///< Interned external ID; guarded by _lock.
+ };
+
+ static quint32 indexOf(SessionHandle handle) { return static_cast<quint32>(handle); }
+ static quint32 generationOf(SessionHandle handle) { return static_cast<quint32>(handle >> 32); }
+
+ // Open with the handle's generation; ONLINE is ignored
+ static bool matches(quint64 state, SessionHandle handle) {
+     return (state & ~ONLINE) == (static_cast<quint64>(generationOf(handle)) << FLAG_BITS | OPEN);
+ }
+
+ Slot& slotAt(quint32 index) const {
+     return _chunks[index >> CHUNK_BITS].load(std::memory_order_relaxed)[index & (CHUNK_SIZE - 1)];
+ }
+
+ // The slot a handle points to, nullptr if its chunk was never allocated
+ Slot* slotOf(SessionHandle handle) const {
+     const quint32 index = indexOf(handle);
+     if ((index >> CHUNK_BITS) >= static_cast<quint32>(MAX_CHUNKS)) return nullptr;
+     Slot* chunk = _chunks[index >> CHUNK_BITS].load(std::memory_order_acquire);
+     return chunk != nullptr ? &chunk[index & (CHUNK_SIZE - 1)] : nullptr;
+ }
+
+ // The open slot of a handle; call with _lock held
+ Slot* openSlot(SessionHandle handle) const {
+     Slot* slot = slotOf(handle);
+     return slot != nullptr && matches(slot->state.load(), handle) ? slot : nullptr;
+ }
+
+ mutable QReadWriteLock _lock;                  ///< Guards the IDs, the free list and open/close.
+ std::atomic<Slot*> _chunks[MAX_CHUNKS];         ///< Allocated on demand, never moved or freed before destruction.
+ QHash<QString, SessionHandle> _ids;            ///< Interned external ID -> handle.
+ QVector<quint32> _free;                        ///< Closed slots, reused LIFO.
+ quint32 _next;                                 ///< Slots ever used.
+ std::atomic<int> _size;
+ std::atomic<int> _online;
+};
+
+#endif // __SESSION_TABLE_HPP__
@@ -0,0 +1,226 @@
+#ifndef __SHARDED_QUEUE_HPP__
+#define __SHARDED_QUEUE_HPP__
+
+#include "MpmcQueue.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/**
+* @class ShardedQueue
+* @brief Per-key ordered task queue with work stealing.
+*
+* Tasks are hashed by key (the sending client) onto a fixed set of shards, each a lock-free
+* MpmcQueue. A consumer must acquire() a shard before popping from it and release() it when
+* done, and a shard is held by at most one consumer at a time, so tasks with the same key are
+* processed strictly in submission order while different keys run in parallel.
+*
+* Every consumer has home shards (shard % consumers == index) that it scans first; when they
+* are all empty or held by someone else it steals any other non-empty shard, so a few hot
+* clients do not pin one Worker while the rest idle. Idle consumers sleep on an EventCount.
+*
+* @tparam T The type of elements stored in the queue.
+*/
+template<class T>
+class ShardedQueue
+{
+public:
+ using bqPtr = std::shared_ptr<ShardedQueue<T>>;
+
+ /**
+  * @brief Constructs the queue.
+  * @param shardCount Number of shards; more shards = less chance two busy clients collide.
+  * @param shardCapacity Capacity of every shard ring.
+  */
+ ShardedQueue(size_t shardCount, size_t shardCapacity)
+     : _shards(shardCount > 0 ? shardCount : 1) {
+     for (Shard& shard : _shards) {
+         shard.queue.reset(new MpmcQueue<T>(shardCapacity));
+     }
+ }
+
+ ShardedQueue(const ShardedQueue&) = delete;
+ ShardedQueue& operator=(const ShardedQueue&) = delete;
+
+ /**
+  * @brief Sets how many consumers share the shards; decides the home shards of each.
+  */
+ void setConsumerCount(size_t consumers) {
+     _consumers.store(consumers > 0 ? consumers : 1, std::memory_order_relaxed);
+ }
+
+ /**
+  * @brief Pushes a task onto the shard of its key. Never blocks.
+  * @param key Hash of the ordering key, e.g. qHash(clientId).
+  * @param ele The task.
+  * @return false if that shard is full or the queue is closed.
+  */
+ bool push(size_t key, const T& ele) {
+     if (_closed.load(std::memory_order_relaxed)) return false;
+     Shard& shard = _shards[key % _shards.size()];
+     // Counted before publishing: a consumer holding the shard may pop the task right away,
+     // and must not take the counters below zero
+     shard.pending.fetch_add(1, std::memory_order_seq_cst);
+     _size.fetch_add(1, std::memory_order_relaxed);
+     if (!shard.queue->push(ele)) {
+         shard.pending.fetch_sub(1, std::memory_order_relaxed);
+         _size.fetch_sub(1, std::memory_order_relaxed);
+         return false;
+     }
+     _available.notify(false);
+     return true;
+ }
+
+ /**
+  * @brief Claims a non-empty shard, own shards first, then stealing.
+  * @param consumer Index of the calling consumer, 0 .. consumers - 1.
+  * @param timeoutMs The maximum time to wait in milliseconds, negative waits forever.
+  * @return The shard index, or -1 on timeout or when closed and drained.
+  */
+ int acquire(size_t consumer, int timeoutMs) {
+     int shard = tryAcquire(consumer);
+     if (shard >= 0) return shard;
+
+     const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs < 0 ? 0 : timeoutMs);
+     while (true) {
+         const uint32_t key = _available.prepareWait();
+         shard = tryAcquire(consumer);
+         if (shard >= 0) {
+             _available.cancelWait();
+             return shard;
+         }
+         if (_closed.load(std::memory_order_acquire) && _size.load(std::memory_order_acquire) == 0) {
+             _available.cancelWait();
+             return -1;
+         }
+
+         int waitMs = -1;
+         if (timeoutMs >= 0) {
+             const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+             if (left <= 0) {
+                 _available.cancelWait();
+                 return -1;
+             }
+             waitMs = static_cast<int>(left);
+         }
+         _available.wait(key, waitMs);
+     }
+ }
+
+ /**
+  * @brief Pops the next task of a shard held through acquire().
+  * @return false if the shard is empty.
+  */
+ bool tryPop(int shard, T& value) {
+     Shard& s = _shards[static_cast<size_t>(shard)];
+     if (!s.queue->tryPop(value)) return false;
+     s.pending.fetch_sub(1, std::memory_order_relaxed);
+     _size.fetch_sub(1, std::memory_order_release);
+     return true;
+ }
+
+ /**
+  * @brief Gives a shard back; wakes another consumer if tasks arrived meanwhile.
+  */
+ void release(int shard) {
+     Shard& s = _shards[static_cast<size_t>(shard)];
+     s.busy.store(false, std::memory_order_seq_cst);
+     // Pairs with push(): either the producer's notify finds the shard free, or we see its task
+     if (s.pending.load(std::memory_order_seq_cst) > 0) {
+         _available.notify(false);
+     }
+     else if (_closed.load(std::memory_order_acquire)) {
+         _available.notify(true); // consumers waiting for the drain to finish
+     }
+ }
+
+ /**
+  * @brief Gets the number of queued tasks over all shards.
+  */
+ size_t size() const { return _size.load(std::memory_order_relaxed); }
+
+ /**
+  * @brief Checks if every shard is empty.
+  */
+ bool empty() const { return size() == 0; }
+
+ /**
+  * @brief Gets the number of shards.
+  */
+ size_t shardCount() const { return _shards.size(); }
+
+ /**
+  * @brief Gets how many shards were taken from another consumer's home set.
+  */
+ uint64_t steals() const { return _steals.load(std::memory_order_relaxed); }
+
+ /**
+  * @brief Notifies all waiting consumers.
+  */
+ void notifyAll() { _available.notify(true); }
+
+ /**
+  * @brief Rejects further pushes; acquire() returns -1 once everything is drained.
+  */
+ void close() {
+     _closed.store(true, std::memory_order_release);
+     notifyAll();
+ }
+
+ /**
+  * @brief Accepts pushes again after close().
+  */
+ void open() { _closed.store(false, std::memory_order_release); }
+
+ /**
+  * @brief Checks whether close() has been called.
+  */
+ bool isClosed() const { return _closed.load(std::memory_order_acquire); }
+
+private:
+ struct Shard {
+     std::unique_ptr<MpmcQueue<T>> queue;
+     std::atomic<size_t> pending{ 0 };  ///< Tasks pushed (or being pushed) and not yet popped.
+     std::atomic<bool> busy{ false };   ///< Held by a consumer.
+ };
+
+ bool tryClaim(Shard& shard) {
+     if (shard.pending.load(std::memory_order_seq_cst) == 0) return false;
+     bool expected = false;
+     return !shard.busy.load(std::memory_order_relaxed) &&
+         shard.busy.compare_exchange_strong(expected, true, std::memory_order_seq_cst);
+ }
+
+ int tryAcquire(size_t consumer) {
+     const size_t count = _shards.size();
+     const size_t consumers = _consumers.load(std::memory_order_relaxed);
+     const size_t home = consumer % consumers;
+
+     // Home shards first, so a client normally stays on the same Worker (warm caches)
+     for (size_t i = home; i < count; i += consumers) {
+         if (tryClaim(_shards[i])) return static_cast<int>(i);
+     }
+     // Steal: start right after our home block so thieves spread over different victims
+     for (size_t n = 1; n <= count; ++n) {
+         const size_t i = (home + n) % count;
+         if (i % consumers == home) continue;
+         if (tryClaim(_shards[i])) {
+             _steals.fetch_add(1, std::memory_order_relaxed);
+             return static_cast<int>(i);
+         }
+     }
+     return -1;
+ }
+
+ std::vector<Shard> _shards;             ///< Fixed set of shards.
+ std::atomic<size_t> _consumers{ 1 };    ///< Consumers sharing the shards.
+ std::atomic<size_t> _size{ 0 };         ///< Queued tasks over all shards, counted like pending.
+ std::atomic<bool> _closed{ false };     ///< Set by close().
+ std::atomic<uint64_t> _steals{ 0 };     ///< Shards taken from another consumer's home set.
+ EventCount _available;                  ///< Sleeping consumers.
+};
+
+#endif // __SHARDED_QUEUE_HPP__
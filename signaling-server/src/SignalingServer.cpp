@@ -1,42 +1,60 @@
 #include "SignalingServer.h"
 
-SignalingServer::SignalingServer(const QHostAddress& address, quint16 port, int workerNum)
+SignalingServer::SignalingServer(const QHostAddress& address, quint16 port, int workerNum, int ioThreadNum)
 : QObject(nullptr),
-_server(new QWebSocketServer(QStringLiteral("Signaling Server"),
-    QWebSocketServer::NonSecureMode, this)),
+_ioPool(new IoThreadPool(this)),
+_server(new IoAcceptor(_ioPool, this)),
+_metricsServer(nullptr),
 _workerPool(new WorkerPool(this)),
+_shuttingDown(0),
 _hostAddress(address),
 _port(port),
 _isRunning(false)
 {
     registerHandlers();
-    QObject::connect(_server, &QWebSocketServer::newConnection, this, &SignalingServer::onNewConnection);
-    QObject::connect(_workerPool, &WorkerPool::sigWorkerResult, this, &SignalingServer::onWorkerResult);
-    QObject::connect(this, &SignalingServer::sigAddSession, this, &SignalingServer::onAddSession);
-    QObject::connect(this, &SignalingServer::sigRemoveSession, this, &SignalingServer::onRemoveSession);
+    // Emitted on the Worker threads; onWorkerResult is thread-safe and posts to the owning I/O thread
+    QObject::connect(_workerPool, &WorkerPool::sigWorkerResult, this, &SignalingServer::onWorkerResult, Qt::DirectConnection);
+    QObject::connect(_workerPool, &WorkerPool::sigWorkerBroadcast, this, &SignalingServer::onWorkerBroadcast, Qt::DirectConnection);
 
     auto processor = [this](const SignalingTask& task, Worker* source) {
-        this->dispatchMessage(task, source);
+        const SignalingType type = this->dispatchMessage(task, source);
+        Metrics::instance().observeMessage(type, task._receivedNs > 0 ? Metrics::now() - task._receivedNs : 0);
     };
-    _workerPool->start(workerNum, processor);
+    // Workers share little on the hot path: each relay does one shared-lock SessionTable::find() for
+    // its "to", owner and state checks by handle are lock-free, room member sets are shared_ptr
+    // snapshots copied under a short stripe lock; REGISTER/JOIN_ROOM add a shared-lock ids()
+    _workerPool->start(workerNum > 0 ? workerNum : qMax(DEFAULT_WORKER_NUMBER_MIN, QThread::idealThreadCount()), processor);
+
+    auto onData = [this](SessionHandle src, const QString& srcId, const WireMessage& data) {
+        this->onClientDataReady(src, srcId, data);
+    };
+    auto onClose = [this](SessionHandle client, const QString& clientId) {
+        this->onSessionClosed(client, clientId);
+    };
+    _ioPool->start(ioThreadNum > 0 ? ioThreadNum : qMax(1, QThread::idealThreadCount() / 2), onData, onClose);
 }
 
-SignalingServer* SignalingServer::getInstance(const QHostAddress& address, quint16 port, int workerNum)  
+SignalingServer* SignalingServer::getInstance(const QHostAddress& address, quint16 port, int workerNum, int ioThreadNum)  
 {  
-   static SignalingServer* instance = new SignalingServer(address, port, workerNum);  
+   static SignalingServer* instance = new SignalingServer(address, port, workerNum, ioThreadNum);  
    return instance;  
 }
 
 SignalingServer::~SignalingServer()
-{}
+{
+    shutdown();
+}
 
 bool SignalingServer::start(const QHostAddress& address, quint16 port)
 {
     if (_isRunning == false) {
-        INFO() << "Signaling Server is running! Listen on: " << address.toString() << ":" << port;
         _hostAddress = address;
         _port = port;
-        _server->listen(_hostAddress, _port);
+        if (!_server->listen(_hostAddress, _port)) {
+            CRITICAL() << "Failed to listen on " << address.toString() << ":" << port << ": " << _server->errorString();
+            return false;
+        }
+        INFO() << "Signaling Server is running! Listen on: " << address.toString() << ":" << port;
         _isRunning = true;
         return true;
     }
@@ -56,62 +74,224 @@ bool SignalingServer::stop()
     return false;
 }
 
+void SignalingServer::shutdown()
+{
+    if (_isRunning) {
+        stop();
+    }
+    if (_metricsServer != nullptr) {
+        _metricsServer->close();
+    }
+    // Workers first: they drain the queue and may still hold an IoThread pointer from the session table.
+    // Their last responses are already queued on the I/O threads, ahead of closeAll().
+    _workerPool->stop();
+    // Every session closes now: announcing each departure to the rest of its room would be O(n^2)
+    _shuttingDown.storeRelaxed(1);
+    _ioPool->stop();
+}
+
+int SignalingServer::workerCount() const
+{
+    return _workerPool->threadCount();
+}
+
+int SignalingServer::ioThreadCount() const
+{
+    return _ioPool->threadCount();
+}
+
+bool SignalingServer::startMetrics(const QHostAddress& address, quint16 port)
+{
+    if (_metricsServer != nullptr && _metricsServer->isListening()) {
+        WARNING() << "The metrics listener has already started!";
+        return false;
+    }
+    if (_metricsServer == nullptr) {
+        _metricsServer = new MetricsServer([this]() { return metricsText(); }, this);
+    }
+    if (!_metricsServer->listen(address, port)) {
+        CRITICAL() << "Failed to serve metrics on " << address.toString() << ":" << port << ": " << _metricsServer->errorString();
+        return false;
+    }
+    INFO() << "Metrics on http://" << address.toString() << ":" << port << "/metrics";
+    return true;
+}
+
+QByteArray SignalingServer::metricsText() const
+{
+    QByteArray text = Metrics::instance().scrape();
+
+    Metrics::appendFamily(text, "signaling_sessions", "gauge", "Open WebSocket sessions.");
+    Metrics::appendSample(text, "signaling_sessions", QByteArray(), _ioPool->sessions().size());
+    Metrics::appendFamily(text, "signaling_online_clients", "gauge", "Registered clients.");
+    Metrics::appendSample(text, "signaling_online_clients", QByteArray(), _ioPool->sessions().onlineCount());
+    Metrics::appendFamily(text, "signaling_rooms", "gauge", "Rooms with at least one member.");
+    Metrics::appendSample(text, "signaling_rooms", QByteArray(), _rooms.roomCount());
+    Metrics::appendFamily(text, "signaling_task_queue_depth", "gauge", "Tasks waiting for a Worker.");
+    Metrics::appendSample(text, "signaling_task_queue_depth", QByteArray(), _workerPool->getQueueSize());
+    Metrics::appendFamily(text, "signaling_io_threads", "gauge", "I/O threads.");
+    Metrics::appendSample(text, "signaling_io_threads", QByteArray(), _ioPool->threadCount());
+
+    const QVector<qint64> busy = _workerPool->busyNanos();
+    Metrics::appendFamily(text, "signaling_worker_busy_seconds_total", "counter", "Time each Worker spent processing tasks.");
+    for (int i = 0; i < busy.size(); ++i) {
+        Metrics::appendSample(text, "signaling_worker_busy_seconds_total",
+            "worker=\"" + QByteArray::number(i + 1) + '"', busy[i] / 1e9);
+    }
+    return text;
+}
+
 
 
 void SignalingServer::registerHandlers()
 {
-    _handlerMap["REGISTER_REQUEST"] = [this](const QJsonObject& j, const QString& id, Worker* w) {
-        handleRegister(this->_session_list, j, id, w);
+    _handlerMap["REGISTER_REQUEST"] = [this](const QJsonObject& j, const SignalingTask& t, Worker* w) {
+        handleRegister(j, t, w);
         };
 
-    _handlerMap["OFFER"] = [this](const QJsonObject& j, const QString& id, Worker* w) {
-        handleOffer(this->_session_list, j, id, w);
+    _handlerMap["OFFER"] = [this](const QJsonObject& j, const SignalingTask& t, Worker* w) {
+        handleOffer(j, t, w);
         };
 
-    _handlerMap["ANSWER"] = [this](const QJsonObject& j, const QString& id, Worker* w) {
-        handleAnswer(this->_session_list, j, id, w);
+    _handlerMap["ANSWER"] = [this](const QJsonObject& j, const SignalingTask& t, Worker* w) {
+        handleAnswer(j, t, w);
         };
 
-    _handlerMap["ICE"] = [this](const QJsonObject& j, const QString& id, Worker* w) {
-        handleIce(this->_session_list, j, id, w);
+    _handlerMap["ICE"] = [this](const QJsonObject& j, const SignalingTask& t, Worker* w) {
+        handleIce(j, t, w);
+        };
+
+    _handlerMap["JOIN_ROOM"] = [this](const QJsonObject& j, const SignalingTask& t, Worker* w) {
+        handleJoinRoom(j, t, w);
+        };
+
+    _handlerMap["LEAVE_ROOM"] = [this](const QJsonObject& j, const SignalingTask& t, Worker* w) {
+        handleLeaveRoom(j, t, w);
         };
 }
 
-void SignalingServer::dispatchMessage(const SignalingTask& task, Worker* worker)
+SignalingType SignalingServer::dispatchMessage(const SignalingTask& task, Worker* worker)
 {
-    QJsonParseError jsonError;
-    QJsonDocument doc = QJsonDocument::fromJson(task._payload.toUtf8(), &jsonError);
+    // Relay messages are most of the traffic and carry the big SDPs: route them without parsing
+    SignalingType relayed = SignalingType::UNKNOWN;
+    if (relayMessage(task, worker, relayed)) {
+        return relayed;
+    }
 
-    if (jsonError.error != QJsonParseError::NoError || doc.isNull()) {
-        handleError("Invalid JSON", task._clientId, worker);
-        return;
+    QJsonObject rootJson;
+    if (!task._frame.isEmpty()) {
+        if (!WireFormat::decode(task._frame, rootJson)) {
+            handleError("Invalid frame", task, worker);
+            return SignalingType::UNKNOWN;
+        }
     }
+    else {
+        QJsonParseError jsonError;
+        QJsonDocument doc = QJsonDocument::fromJson(task._payload.toUtf8(), &jsonError);
 
-    QJsonObject rootJson = doc.object();
+        if (jsonError.error != QJsonParseError::NoError || doc.isNull()) {
+            handleError("Invalid JSON", task, worker);
+            return SignalingType::UNKNOWN;
+        }
+        rootJson = doc.object();
+    }
     
     // B. Get message type
     if (!rootJson.contains("type") || !rootJson["type"].isString()) {
-        handleError("Invalid type", task._clientId, worker);
-        return;
+        handleError("Invalid type", task, worker);
+        return SignalingType::UNKNOWN;
     }
 
     QString type = rootJson["type"].toString();
 
     if (_handlerMap.contains(type)) {
-        _handlerMap[type](rootJson, task._clientId, worker);
+        _handlerMap[type](rootJson, task, worker);
+        return string_to_stype(type);
     }
-    else {
-        handleError("Invalid type", task._clientId, worker);
+    handleError("Invalid type", task, worker);
+    return SignalingType::UNKNOWN;
+}
+
+bool SignalingServer::relayMessage(const SignalingTask& task, Worker* worker, SignalingType& type)
+{
+    if (!task._frame.isEmpty()) {
+        return relayFrame(task, worker, type);
+    }
+
+    RouteScanner::Route route;
+    if (!RouteScanner::scan(task._payload, route) || !route.type.found() || !route.to.found()) {
+        return false;
+    }
+
+    const QStringView typeName = RouteScanner::value(task._payload, route.type);
+    if (typeName == QLatin1String("OFFER")) type = SignalingType::OFFER;
+    else if (typeName == QLatin1String("ANSWER")) type = SignalingType::ANSWER;
+    else if (typeName == QLatin1String("ICE")) type = SignalingType::ICE;
+    else return false;
+
+    const QString targetId = RouteScanner::value(task._payload, route.to).toString();
+    // The only ID lookup of a relay; from here on the target is its handle
+    const SessionHandle target = _ioPool->sessions().find(targetId);
+    if (!isOnline(target)) {
+        handleError(QString("%1 is not online").arg(targetId), task, worker);
+        return true;
+    }
+
+    emit worker->sigSendResponse(target, RouteScanner::spliceFrom(task._payload, route, task._clientId));
+    return true;
+}
+
+bool SignalingServer::relayFrame(const SignalingTask& task, Worker* worker, SignalingType& type)
+{
+    WireFormat::Header header;
+    if (!WireFormat::parseHeader(task._frame, header)) {
+        return false;
     }
-    return;
+    if (header.type != SignalingType::OFFER && header.type != SignalingType::ANSWER && header.type != SignalingType::ICE) {
+        return false;
+    }
+    type = header.type;
+
+    const QString targetId = WireFormat::to(task._frame, header);
+    const SessionHandle target = _ioPool->sessions().find(targetId);
+    if (!isOnline(target)) {
+        handleError(QString("%1 is not online").arg(targetId), task, worker);
+        return true;
+    }
+
+    // The target converts it to JSON on delivery if it did not negotiate the binary format
+    emit worker->sigSendResponse(target, WireMessage::binary(WireFormat::spliceFrom(task._frame, header, task._clientId)));
+    return true;
 }
 
-void SignalingServer::handleRegister(const QJsonArray& sessionList, const QJsonObject& jsonObj, const QString& srcId, Worker* worker)
+void SignalingServer::handleRegister(const QJsonObject& jsonObj, const SignalingTask& task, Worker* worker)
 {
+    const SessionHandle src = task._handle;
+    const QString& srcId = task._clientId;
+    QString room = DEFAULT_ROOM;
+    const QJsonObject request = jsonObj["data"].toObject();
+    const QJsonValue requested = request["room"];
+    if (!requested.isUndefined() && !parseRoom(requested, room)) {
+        handleError("Invalid room", task, worker);
+        return;
+    }
+
+    // The member snapshot taken by the join serves both the peer list and the PEER_JOINED
+    // fan-out, even if peers come and go while this Worker is still sending
+    const RoomRegistry::Change change = _rooms.join(src, room);
+
+    // Peers that closed since the snapshot are skipped; the rest are named under one shared lock
+    QStringList peerIds = _ioPool->sessions().ids(*change.before);
+    peerIds.removeOne(srcId);
+    const QJsonArray peers = QJsonArray::fromStringList(peerIds);
     QJsonObject data;
     data.insert("peerId", srcId);
     data.insert("message", "Welcome!");
-    data.insert("peers", sessionList);
+    data.insert("room", room);
+    data.insert("peers", peers);
+    // Echoed so the client knows the server understood the request; absent on older servers
+    const WireFormat::Format format = WireFormat::parse(request["wire"]);
+    data.insert("wire", WireFormat::name(format));
 
     QJsonObject jsonRet = jsonObj;
     jsonRet.insert("type", stype_to_string(SignalingType::REGISTER_SUCCESS));
@@ -120,46 +300,145 @@ void SignalingServer::handleRegister(const QJsonArray& sessionList, const QJsonO
     jsonRet.insert("data", data);
 
     QString ret = QJsonDocument(jsonRet).toJson(QJsonDocument::Compact);
-    emit sigAddSession(srcId);
-    emit worker->sigSendResponse(srcId, QString(ret));
-
-    if (!sessionList.isEmpty()) {
-        QJsonObject joinData;
-        joinData.insert("id", srcId);
-        
-        QJsonObject jsonNotify;
-        jsonNotify.insert("type", stype_to_string(SignalingType::PEER_JOINED));
-        jsonNotify.insert("from", "Server");
-        jsonNotify.insert("to", QJsonValue::Null);
-        jsonNotify.insert("data", joinData);
-
-        for (const QJsonValue& val : sessionList) {
-            QString targetId = val.toString();
-            if (targetId == srcId) continue;
-
-            jsonNotify["to"] = targetId;
-            QString notifyPayload = QJsonDocument(jsonNotify).toJson(QJsonDocument::Compact);
-
-            emit worker->sigSendResponse(targetId, notifyPayload);
-        }
+    // Online before the peers hear of it, so an OFFER sent on PEER_JOINED is routable; a no-op
+    // if the socket already closed
+    _ioPool->sessions().setOnline(src);
+    emit worker->sigSendResponse(src, QString(ret));
+    // Queued behind REGISTER_SUCCESS on the same I/O thread, so the reply itself still goes out
+    // in the format the client used until now
+    if (IoThread* owner = _ioPool->sessions().owner(src)) {
+        owner->setWireFormat(src, format);
+    }
+    announceRoomChange(src, srcId, change, worker);
+
+    // Closed while the REGISTER was queued: onSessionClosed() found no room to leave
+    if (!_ioPool->sessions().isOpen(src)) {
+        announceRoomChange(src, srcId, _rooms.leave(src), worker);
+    }
+}
+
+void SignalingServer::handleJoinRoom(const QJsonObject& jsonObj, const SignalingTask& task, Worker* worker)
+{
+    const SessionHandle src = task._handle;
+    const QString& srcId = task._clientId;
+    QString room;
+    if (!parseRoom(jsonObj["data"].toObject()["room"], room)) {
+        handleError("Invalid room", task, worker);
+        return;
+    }
+    const RoomRegistry::Change change = _rooms.join(src, room);
+
+    QStringList peerIds = _ioPool->sessions().ids(*change.before);
+    peerIds.removeOne(srcId);
+    const QJsonArray peers = QJsonArray::fromStringList(peerIds);
+    QJsonObject data;
+    data.insert("room", room);
+    data.insert("peers", peers);
+
+    QJsonObject jsonRet;
+    jsonRet.insert("type", stype_to_string(SignalingType::ROOM_JOINED));
+    jsonRet.insert("from", "Server");
+    jsonRet.insert("to", srcId);
+    jsonRet.insert("data", data);
+
+    emit worker->sigSendResponse(src, QString(QJsonDocument(jsonRet).toJson(QJsonDocument::Compact)));
+    announceRoomChange(src, srcId, change, worker);
+
+    if (!_ioPool->sessions().isOpen(src)) {
+        announceRoomChange(src, srcId, _rooms.leave(src), worker);
+    }
+}
+
+void SignalingServer::handleLeaveRoom(const QJsonObject& jsonObj, const SignalingTask& task, Worker* worker)
+{
+    Q_UNUSED(jsonObj);
+    const SessionHandle src = task._handle;
+    const QString& srcId = task._clientId;
+    const RoomRegistry::Change change = _rooms.leave(src);
+    if (change.left.isEmpty()) {
+        handleError("Not in a room", task, worker);
+        return;
+    }
+
+    QJsonObject data;
+    data.insert("room", change.left);
+
+    QJsonObject jsonRet;
+    jsonRet.insert("type", stype_to_string(SignalingType::ROOM_LEFT));
+    jsonRet.insert("from", "Server");
+    jsonRet.insert("to", srcId);
+    jsonRet.insert("data", data);
+
+    emit worker->sigSendResponse(src, QString(QJsonDocument(jsonRet).toJson(QJsonDocument::Compact)));
+    announceRoomChange(src, srcId, change, worker);
+}
+
+void SignalingServer::announceRoomChange(SessionHandle client, const QString& clientId, const RoomRegistry::Change& change, Worker* worker)
+{
+    if (!change.left.isEmpty()) {
+        broadcastPresence(SignalingType::PEER_LEFT, client, clientId, change.left, change.stayed, worker);
+    }
+    if (!change.joined.isEmpty() && !change.alreadyMember) {
+        broadcastPresence(SignalingType::PEER_JOINED, client, clientId, change.joined, change.before, worker);
+    }
+}
+
+void SignalingServer::broadcastPresence(SignalingType type, SessionHandle client, const QString& clientId, const QString& room,
+    const RoomRegistry::Members& members, Worker* worker)
+{
+    QVector<SessionHandle> targets;
+    targets.reserve(members->size());
+    for (SessionHandle target : *members) {
+        if (target != client) targets.append(target);
+    }
+    if (targets.isEmpty()) return;
+
+    QJsonObject data;
+    data.insert("id", clientId);
+    data.insert("room", room);
+
+    // Addressed to "All" as documented, so one serialization serves every member
+    QJsonObject jsonNotify;
+    jsonNotify.insert("type", stype_to_string(type));
+    jsonNotify.insert("from", "Server");
+    jsonNotify.insert("to", "All");
+    jsonNotify.insert("data", data);
+
+    const QString payload = QJsonDocument(jsonNotify).toJson(QJsonDocument::Compact);
+    if (worker != nullptr) {
+        emit worker->sigBroadcast(targets, payload);
     }
+    else {
+        onWorkerBroadcast(targets, payload);
+    }
+}
+
+bool SignalingServer::parseRoom(const QJsonValue& value, QString& room)
+{
+    if (!value.isString()) return false;
+    const QString text = value.toString();
+    if (text.isEmpty() || text.size() > MAX_ROOM_ID_LENGTH) return false;
+    room = text;
+    return true;
 }
 
-void SignalingServer::handleOffer(const QJsonArray& sessionList, const QJsonObject& jsonObj, 
-    const QString& srcId, Worker* worker)
+void SignalingServer::handleOffer(const QJsonObject& jsonObj, 
+    const SignalingTask& task, Worker* worker)
 {
+    const QString& srcId = task._clientId;
     if (!jsonObj.contains("to") || !jsonObj["to"].isString()) {
-        handleError("Missing 'to' field in OFFER", srcId, worker);
+        handleError("Missing 'to' field in OFFER", task, worker);
         return;
     }
     QString targetId = jsonObj["to"].toString();
+    const SessionHandle target = _ioPool->sessions().find(targetId);
 
     QJsonObject forwardJson;
     forwardJson.insert("type", stype_to_string(SignalingType::OFFER));
     forwardJson.insert("from", srcId);
     forwardJson.insert("to", targetId);
-    if (!isOnline(sessionList, targetId)) {
-        handleError(QString("%1 is not online").arg(targetId), srcId, worker);
+    if (!isOnline(target)) {
+        handleError(QString("%1 is not online").arg(targetId), task, worker);
     }
 
     if (jsonObj.contains("data")) {
@@ -171,22 +450,24 @@ void SignalingServer::handleOffer(const QJsonArray& sessionList, const QJsonObje
 
 
     QString payload = QJsonDocument(forwardJson).toJson(QJsonDocument::Compact);
-    emit worker->sigSendResponse(targetId, payload);
+    emit worker->sigSendResponse(target, payload);
 }
 
-void SignalingServer::handleAnswer(const QJsonArray& sessionList, const QJsonObject& jsonObj, 
-    const QString& srcId, Worker* worker)
+void SignalingServer::handleAnswer(const QJsonObject& jsonObj, 
+    const SignalingTask& task, Worker* worker)
 {
+    const QString& srcId = task._clientId;
     if (!jsonObj.contains("to") || !jsonObj["to"].isString()) {
-        handleError("Missing 'to' field in ANSWER", srcId, worker);
+        handleError("Missing 'to' field in ANSWER", task, worker);
         return;
     }
     QString targetId = jsonObj["to"].toString();
-    if (!isOnline(sessionList, targetId)) {
+    const SessionHandle target = _ioPool->sessions().find(targetId);
+    if (!isOnline(target)) {
         char buffer[DEFAULT_BUFFER_SIZE];
         memset(buffer, 0, DEFAULT_BUFFER_SIZE);
         snprintf(buffer, DEFAULT_BUFFER_SIZE, "%s is not online", targetId.toStdString().c_str());
-        handleError(QString(buffer), srcId, worker);
+        handleError(QString(buffer), task, worker);
     }
 
     QJsonObject forwardJson;
@@ -202,22 +483,24 @@ void SignalingServer::handleAnswer(const QJsonArray& sessionList, const QJsonObj
     }
 
     QString payload = QJsonDocument(forwardJson).toJson(QJsonDocument::Compact);
-    emit worker->sigSendResponse(targetId, payload);
+    emit worker->sigSendResponse(target, payload);
 }
 
-void SignalingServer::handleIce(const QJsonArray& sessionList, const QJsonObject& jsonObj, 
-    const QString& srcId, Worker* worker)
+void SignalingServer::handleIce(const QJsonObject& jsonObj, 
+    const SignalingTask& task, Worker* worker)
 {
+    const QString& srcId = task._clientId;
     if (!jsonObj.contains("to") || !jsonObj["to"].isString()) {
-        handleError("Missing 'to' field in ICE", srcId, worker);
+        handleError("Missing 'to' field in ICE", task, worker);
         return;
     }
     QString targetId = jsonObj["to"].toString();
-    if (!isOnline(sessionList, targetId)) {
+    const SessionHandle target = _ioPool->sessions().find(targetId);
+    if (!isOnline(target)) {
         char buffer[DEFAULT_BUFFER_SIZE];
         memset(buffer, 0, DEFAULT_BUFFER_SIZE);
         snprintf(buffer, DEFAULT_BUFFER_SIZE, "%s is not online", targetId.toStdString().c_str());
-        handleError(QString(buffer), srcId, worker);
+        handleError(QString(buffer), task, worker);
         return;
     }
 
@@ -234,11 +517,12 @@ void SignalingServer::handleIce(const QJsonArray& sessionList, const QJsonObject
     }
 
     QString payload = QJsonDocument(forwardJson).toJson(QJsonDocument::Compact);
-    emit worker->sigSendResponse(targetId, payload);
+    emit worker->sigSendResponse(target, payload);
 }
 
-void SignalingServer::handleError(const QString& message, const QString& clientId, Worker* worker)
+void SignalingServer::handleError(const QString& message, const SignalingTask& task, Worker* worker)
 {
+    const QString& clientId = task._clientId;
     QJsonObject data;
     data.insert("message", message);
 
@@ -248,91 +532,73 @@ void SignalingServer::handleError(const QString& message, const QString& clientI
     errorJson.insert("to", clientId);
     errorJson.insert("data", data);
     auto payload = QJsonDocument(errorJson).toJson(QJsonDocument::Compact); 
-    INFO() << "[" << stype_to_string(SignalingType::ERROR_MESSAGE) << "] " <<
-        "Client: " << clientId << " : " << message;
-    emit worker->sigSendResponse(clientId, QString(payload));
-}
-
-QJsonArray SignalingServer::getPeerList()  
-{  
-   QJsonArray jsonArray;  
-   for (auto it = _sessions.begin(); it != _sessions.end(); ++it) {  
-       jsonArray.append(it.key());  
-   }  
-   return jsonArray;  
-}
-
-bool SignalingServer::isOnline(const QJsonArray& sessionList, const QString& clientId)
-{
-    for (auto it = sessionList.begin(); it != sessionList.end(); it++) {
-        if ((*it).toString() == clientId) return true;
-    }
-    return false;
+    Metrics::instance().add(Metrics::ERRORS_SENT);
+    LOG_EVENT(LOG_LEVEL_INFO, "error_sent", { "to", clientId }, { "message", message });
+    emit worker->sigSendResponse(task._handle, QString(payload));
 }
 
-void SignalingServer::onNewConnection()
+bool SignalingServer::isOnline(SessionHandle client) const
 {
-    auto webSocket = _server->nextPendingConnection();
-    ClientSession* session = new ClientSession(webSocket, this);
-    QString client_id = session->id();
-
-    _sessions[client_id] = session;
-
-    QObject::connect(session, &ClientSession::sigDisconnected, this, &SignalingServer::onDisconnected);
-    QObject::connect(session, &ClientSession::sigDataReady, this,
-        &SignalingServer::onClientDataReady);
-}
-
-void SignalingServer::onDisconnected()
-{
-     auto clientSession = qobject_cast<ClientSession*>(sender());
-    _sessions.remove(clientSession->id());
-    emit sigRemoveSession(clientSession->id());
+    return _ioPool->sessions().isOnline(client);
 }
 
-void SignalingServer::onClientDataReady(const QString& srcId, const QString& data)
+void SignalingServer::onClientDataReady(SessionHandle src, const QString& srcId, const WireMessage& data)
 {
-    SignalingTask task(srcId, data);
+    SignalingTask task(src, srcId, data.text);
+    task._frame = data.frame;
+    task._receivedNs = Metrics::now();
+    // Sharded by sender, room or not: its messages run in arrival order across JOIN_ROOM, and
+    // a crowded room spreads over all shards; RoomRegistry serializes the membership changes
     _workerPool->submitTask(task);
 }
 
-void SignalingServer::onWorkerResult(const QString& targetClient, const QString& message)
+void SignalingServer::onWorkerResult(SessionHandle target, const WireMessage& message)
 {
-    if (!_sessions.contains(targetClient) || _sessions[targetClient] == nullptr) {
-        WARNING() << targetClient << " has already offlined";
+    IoThread* owner = _ioPool->sessions().owner(target);
+    if (owner == nullptr) {
+        Metrics::instance().add(Metrics::TARGET_OFFLINE);
+        LOG_EVENT(LOG_LEVEL_WARNING, "target_offline", { "to", target });
         return;
     }
-    auto session = _sessions[targetClient];
-    session->sendData(message);
+    owner->post(target, message);
 }
 
-void SignalingServer::onAddSession(const QString& clientId)
+void SignalingServer::onWorkerBroadcast(const QVector<SessionHandle>& targets, const WireMessage& message)
 {
-    _session_list.append(clientId);
+    int offline = 0;
+    const QHash<IoThread*, QVector<SessionHandle>> groups = _ioPool->sessions().groupByOwner(targets, offline);
+    if (offline > 0) {
+        Metrics::instance().add(Metrics::TARGET_OFFLINE, static_cast<quint64>(offline));
+    }
+    for (auto it = groups.cbegin(); it != groups.cend(); ++it) {
+        it.key()->postBatch(it.value(), message);
+    }
 }
 
-void SignalingServer::onRemoveSession(const QString& clientId)
+void SignalingServer::onSessionClosed(SessionHandle client, const QString& clientId)
 {
-    if (_sessions.contains(clientId)) {
-        _sessions.remove(clientId);
+    // The handle is already stale (and offline), so a REGISTER or JOIN_ROOM still in flight
+    // sees that and leaves again; see handleRegister()
+    const RoomRegistry::Change change = _rooms.leave(client);
+    if (!_shuttingDown.loadRelaxed()) {
+        announceRoomChange(client, clientId, change, nullptr);
     }
-    _session_list = getPeerList();
 }
 
 // ClientSession >>>>>>>>>>>>>>>>>
 
 ClientSession::ClientSession(QWebSocket* sock, QObject* parent) :
-	QObject(parent), _socket(sock)
+	QObject(parent), _socket(sock), _format(WireFormat::Format::JSON)
 {
 	assert(sock != nullptr);
 	_socket->setParent(this);
 
 	_id = QUuid::createUuid().toString(QUuid::Id128);
-    DEBUG() << "ClientSession created. ID:" << _id << "Description: " <<
-        "listen on port " << _socket->localPort() <<
-        "; Peer address and port " << _socket->peerAddress() << ":" << _socket->peerPort(); 
+    LOG_EVENT(LOG_LEVEL_DEBUG, "session_open", { "id", _id }, { "peer", _socket->peerAddress().toString() },
+        { "peer_port", static_cast<int>(_socket->peerPort()) }, { "local_port", static_cast<int>(_socket->localPort()) });
 
 	connect(_socket, &QWebSocket::textMessageReceived, this, &ClientSession::onTextMessageReceived);
+	connect(_socket, &QWebSocket::binaryMessageReceived, this, &ClientSession::onBinaryMessageReceived);
 	connect(_socket, &QWebSocket::disconnected, this, &ClientSession::onDisconnected);
 }
 
@@ -343,7 +609,7 @@ QString ClientSession::id() const
 	return _id;
 }
 
-void ClientSession::sendData(const QString& data)
+void ClientSession::sendData(const WireMessage& data)
 {
     if (_socket == nullptr) {
         CRITICAL() << "ClientSession::sendData called with null socket. ID:" << _id;
@@ -351,23 +617,67 @@ void ClientSession::sendData(const QString& data)
     }
 
     if (_socket->state() != QAbstractSocket::ConnectedState) {
+        Metrics::instance().add(Metrics::SEND_FAILURES);
         WARNING() << "ClientSession::sendData failed. Socket not connected. ID:" << _id;
         return;
     }
 
-    INFO() << "Send: " << data << " to " << id();
-    qint64 bytesSent = _socket->sendTextMessage(data);
+    // A binary session still gets the text of a message that has no frame form (unknown type)
+    const bool binary = _format == WireFormat::Format::BINARY && !data.frame.isEmpty();
+    if (!binary && data.text.isEmpty()) {
+        Metrics::instance().add(Metrics::SEND_FAILURES);
+        WARNING() << "ClientSession::sendData dropped a malformed frame. ID:" << _id;
+        return;
+    }
+
+    qint64 expected = 0;
+    qint64 bytesSent = 0;
+    if (binary) {
+        LOG_EVENT(LOG_LEVEL_INFO, "send", { "to", _id }, { "bytes", data.frame.size() });
+        expected = data.frame.size();
+        bytesSent = _socket->sendBinaryMessage(data.frame);
+    }
+    else {
+        LOG_EVENT(LOG_LEVEL_INFO, "send", { "to", _id }, { "chars", data.text.size() });
+        LOG_PAYLOAD("send_payload", _id, data.text);
+        expected = data.text.toUtf8().size();
+        bytesSent = _socket->sendTextMessage(data.text);
+    }
     if (bytesSent == -1) {
+        Metrics::instance().add(Metrics::SEND_FAILURES);
         WARNING() << "ClientSession::sendData failed to send message. ID:" << _id
             << "Error:" << _socket->errorString();
         if (_socket->error() != QAbstractSocket::SocketTimeoutError) {
             _socket->close();
         }
     }
-    else if (bytesSent != data.toUtf8().size()) {
+    else if (bytesSent != expected) {
+        Metrics::instance().add(Metrics::SEND_FAILURES);
         WARNING() << "ClientSession::sendData partial send. ID:" << _id
-            << "Sent:" << bytesSent << "Expected:" << data.size();
+            << "Sent:" << bytesSent << "Expected:" << expected;
     }
+    else {
+        Metrics::instance().add(Metrics::MESSAGES_SENT);
+        Metrics::instance().add(Metrics::BYTES_SENT, static_cast<quint64>(bytesSent));
+    }
+}
+
+WireFormat::Format ClientSession::wireFormat() const
+{
+    return _format;
+}
+
+void ClientSession::setWireFormat(WireFormat::Format format)
+{
+    _format = format;
+}
+
+void ClientSession::close()
+{
+    if (_socket == nullptr || _socket->state() != QAbstractSocket::ConnectedState) return;
+    _socket->flush();
+    _socket->close(QWebSocketProtocol::CloseCodeGoingAway, QStringLiteral("Server shutting down"));
+    _socket->flush();
 }
 
 void ClientSession::onTextMessageReceived(const QString& message)
@@ -375,6 +685,11 @@ void ClientSession::onTextMessageReceived(const QString& message)
 	emit sigDataReady(_id, message);
 }
 
+void ClientSession::onBinaryMessageReceived(const QByteArray& message)
+{
+    emit sigDataReady(_id, WireMessage::binary(message));
+}
+
 void ClientSession::onDisconnected()
 {
     _socket->close();
@@ -2,9 +2,17 @@
 
 #include "Common.hpp"
 #include "Worker.h"  
+#include "IoThreadPool.h"
+#include "Metrics.h"
+#include "RoomRegistry.hpp"
+#include "RouteScanner.hpp"
+#include "WireFormat.hpp"
 
 const int DEFAULT_BUFFER_SIZE = 64;  
-const int DEFAULT_WORKER_NUMBER = 2;  
+const int DEFAULT_WORKER_NUMBER = 0;  ///< 0 = one Worker per core (QThread::idealThreadCount()).
+const int DEFAULT_WORKER_NUMBER_MIN = 2;  
+const QString DEFAULT_ROOM = "lobby";  ///< Room of clients that register without naming one.
+const int MAX_ROOM_ID_LENGTH = 64;  
 
 class ClientSession;  
 
@@ -14,6 +22,10 @@ class ClientSession;
 *  
 * The SignalingServer class is responsible for handling WebSocket connections,  
 * managing client sessions, and dispatching signaling tasks to a worker pool.  
+*  
+* The main thread only accepts connections. Sockets are spread over an IoThreadPool,  
+* received messages go from the I/O threads straight into the WorkerPool, and Workers  
+* post responses straight to the I/O thread owning the target socket.  
 */  
 class SignalingServer : public QObject  
 {  
@@ -23,19 +35,19 @@ public:
    /**  
     * @brief Type alias for handler functions.  
     * @param json The JSON object containing the signaling message.  
-    * @param clientId The ID of the client sending the message.  
+    * @param task The task of the message: the source session, its ID and the raw message.  
     * @param worker Pointer to the Worker instance processing the task.  
     */  
-   using handlerFunc = std::function<void(const QJsonObject& json, const QString& clientId, Worker* worker)>;  
+   using handlerFunc = std::function<void(const QJsonObject& json, const SignalingTask& task, Worker* worker)>;  
 private:
    /**  
     * @brief Constructs a SignalingServer instance.  
     * @param address The address to bind the WebSocket server to.  
     * @param port The port to bind the WebSocket server to.  
-    * @param workerNum The number of worker threads to create.  
-    * @param parent Pointer to the parent QObject (default is nullptr).  
+    * @param workerNum The number of worker threads to create, 0 for one per core.  
+    * @param ioThreadNum The number of I/O threads to create, 0 for half the cores.  
     */  
-   SignalingServer(const QHostAddress& address, quint16 port, int workerNum);
+   SignalingServer(const QHostAddress& address, quint16 port, int workerNum, int ioThreadNum);
 
    Q_DISABLE_COPY(SignalingServer)
 
@@ -50,10 +62,12 @@ public:
     *  
     * @param address The address to bind the WebSocket server to. Defaults to QHostAddress::Any.  
     * @param port The port to bind the WebSocket server to. Defaults to 11290.  
-    * @param workerNum The number of worker threads to create. Defaults to DEFAULT_WORKER_NUMBER.  
+    * @param workerNum The number of worker threads to create. Defaults to DEFAULT_WORKER_NUMBER (one per core).  
+    * @param ioThreadNum The number of I/O threads to create. Defaults to DEFAULT_IO_THREAD_NUMBER (half the cores).  
     * @return A pointer to the singleton instance of the SignalingServer.  
     */  
-    static SignalingServer* getInstance(const QHostAddress& address = QHostAddress::Any, quint16 port = 11290, int workerNum = DEFAULT_WORKER_NUMBER);
+    static SignalingServer* getInstance(const QHostAddress& address = QHostAddress::Any, quint16 port = 11290,
+        int workerNum = DEFAULT_WORKER_NUMBER, int ioThreadNum = DEFAULT_IO_THREAD_NUMBER);
    
     
     /**  
@@ -75,6 +89,37 @@ public:
     */  
    bool stop();  
 
+   /**  
+    * @brief Graceful shutdown: stops listening, lets the Workers drain every queued task,  
+    * flushes their responses and closes all sessions. Blocks until all threads exited.  
+    */  
+   void shutdown();  
+
+   /**  
+    * @brief Gets the number of Worker threads.  
+    */  
+   int workerCount() const;  
+
+   /**  
+    * @brief Gets the number of I/O threads.  
+    */  
+   int ioThreadCount() const;  
+
+   /**  
+    * @brief Serves the Prometheus metrics over HTTP at GET /metrics, on the main thread.  
+    * @param address The address to bind the listener to.  
+    * @param port The metrics port, separate from the signaling port.  
+    * @return True if the listener is up, false if the port cannot be bound or it already runs.  
+    */  
+   bool startMetrics(const QHostAddress& address, quint16 port);  
+
+   /**  
+    * @brief Renders the counters and histograms of Metrics plus the current server gauges  
+    * (sessions, online clients, task queue depth, Worker busy time).  
+    * @return Prometheus text exposition.  
+    */  
+   QByteArray metricsText() const;  
+
 private:  
    /**  
     * @brief Registers handler functions for solving signaling messages.  
@@ -85,123 +130,163 @@ private:
     * @brief Dispatches a signaling task to a worker.  
     * @param task The signaling task to be processed.  
     * @param worker Pointer to the Worker instance processing the task.  
+    * @return The type of the message, UNKNOWN if it was rejected; used for the metrics.  
     */  
-   void dispatchMessage(const SignalingTask& task, Worker* worker);  
+   SignalingType dispatchMessage(const SignalingTask& task, Worker* worker);  
 
    /**  
-    * @brief Handles a "register" signaling message.  
-    * @param sessionList The list of active sessions.  
+    * @brief Forwards an OFFER/ANSWER/ICE by splicing "from" into the received text, without  
+    * building a QJsonDocument. See RouteScanner.  
+    * @param task The signaling task to be processed.  
+    * @param worker Pointer to the Worker instance processing the task.  
+    * @param type Set to the relayed message type.  
+    * @return false if the message is not a plain relay message; the full parser handles it then.  
+    */  
+   bool relayMessage(const SignalingTask& task, Worker* worker, SignalingType& type);  
+
+   /**  
+    * @brief Forwards a binary OFFER/ANSWER/ICE frame: reads the fixed header, rewrites "from"  
+    * and copies the body unchanged. See WireFormat.  
+    * @param task The signaling task to be processed, task._frame set.  
+    * @param worker Pointer to the Worker instance processing the task.  
+    * @param type Set to the relayed message type.  
+    * @return false if the frame is not a relay message; it is decoded and handled as JSON then.  
+    */  
+   bool relayFrame(const SignalingTask& task, Worker* worker, SignalingType& type);  
+
+   /**  
+    * @brief Handles a "register" signaling message; data.wire selects the session's wire format.  
     * @param jsonObj The JSON object containing the message.  
-    * @param srcId The ID of the source client.  
+    * @param task The task of the message, for the source session.  
     * @param worker Pointer to the Worker instance processing the task.  
     */  
-   void handleRegister(const QJsonArray& sessionList, const QJsonObject& jsonObj, const QString& srcId, Worker* worker);  
+   void handleRegister(const QJsonObject& jsonObj, const SignalingTask& task, Worker* worker);  
 
    /**  
     * @brief Handles an "offer" signaling message.  
-    * @param sessionList The list of active sessions.  
     * @param jsonObj The JSON object containing the message.  
-    * @param srcId The ID of the source client.  
+    * @param task The task of the message, for the source session.  
     * @param worker Pointer to the Worker instance processing the task.  
     */  
-   void handleOffer(const QJsonArray& sessionList, const QJsonObject& jsonObj, const QString& srcId, Worker* worker);  
+   void handleOffer(const QJsonObject& jsonObj, const SignalingTask& task, Worker* worker);  
 
    /**  
     * @brief Handles an "answer" signaling message.  
-    * @param sessionList The list of active sessions.  
     * @param jsonObj The JSON object containing the message.  
-    * @param srcId The ID of the source client.  
+    * @param task The task of the message, for the source session.  
     * @param worker Pointer to the Worker instance processing the task.  
     */  
-   void handleAnswer(const QJsonArray& sessionList, const QJsonObject& jsonObj, const QString& srcId, Worker* worker);  
+   void handleAnswer(const QJsonObject& jsonObj, const SignalingTask& task, Worker* worker);  
 
    /**  
     * @brief Handles an "ice" signaling message.  
-    * @param sessionList The list of active sessions.  
     * @param jsonObj The JSON object containing the message.  
-    * @param srcId The ID of the source client.  
+    * @param task The task of the message, for the source session.  
     * @param worker Pointer to the Worker instance processing the task.  
     */  
-   void handleIce(const QJsonArray& sessionList, const QJsonObject& jsonObj, const QString& srcId, Worker* worker);  
+   void handleIce(const QJsonObject& jsonObj, const SignalingTask& task, Worker* worker);  
 
    /**  
-    * @brief Handles an error message.  
-    * @param message The error message.  
-    * @param srcId The ID of the source client.  
+    * @brief Handles a "join room" signaling message: moves the client and announces it to both rooms.  
+    * @param jsonObj The JSON object containing the message.  
+    * @param task The task of the message, for the source session.  
     * @param worker Pointer to the Worker instance processing the task.  
     */  
-   void handleError(const QString& message, const QString& srcId, Worker* worker);  
+   void handleJoinRoom(const QJsonObject& jsonObj, const SignalingTask& task, Worker* worker);  
 
    /**  
-    * @brief Retrieves the list of peers.  
-    * @return A JSON array containing the list of peers.  
+    * @brief Handles a "leave room" signaling message.  
+    * @param jsonObj The JSON object containing the message.  
+    * @param task The task of the message, for the source session.  
+    * @param worker Pointer to the Worker instance processing the task.  
     */  
-   QJsonArray getPeerList();  
+   void handleLeaveRoom(const QJsonObject& jsonObj, const SignalingTask& task, Worker* worker);  
 
    /**  
-    * @brief Checks if a client is online.  
-    * @param sessionList The list of active sessions.  
-    * @param clientId The ID of the client to check.  
-    * @return True if the client is online, false otherwise.  
+    * @brief Sends PEER_LEFT / PEER_JOINED for a room change to the members of the rooms involved.  
+    * @param client The session that moved.  
+    * @param clientId Its external ID, the one announced.  
+    * @param change What RoomRegistry::join/leave did.  
+    * @param worker The Worker to emit from; nullptr when called on an I/O thread.  
     */  
-   bool isOnline(const QJsonArray& sessionList, const QString& clientId);  
+   void announceRoomChange(SessionHandle client, const QString& clientId, const RoomRegistry::Change& change, Worker* worker);  
 
-signals:  
    /**  
-    * @brief Signal emitted when a new session is added.  
-    * @param clientId The ID of the new client session.  
+    * @brief Serializes one PEER_JOINED or PEER_LEFT and broadcasts it to the members except the client.  
+    * @param type PEER_JOINED or PEER_LEFT.  
+    * @param client The session that joined or left.  
+    * @param clientId Its external ID, the one announced.  
+    * @param room The room concerned.  
+    * @param members The recipients.  
+    * @param worker The Worker to emit from; nullptr when called on an I/O thread.  
     */  
-   void sigAddSession(const QString& clientId);  
+   void broadcastPresence(SignalingType type, SessionHandle client, const QString& clientId, const QString& room,  
+      const RoomRegistry::Members& members, Worker* worker);  
 
    /**  
-    * @brief Signal emitted when a session is removed.  
-    * @param clientId The ID of the removed client session.  
+    * @brief Reads the "room" field of a message.  
+    * @param value The field value.  
+    * @param room Set to the room ID.  
+    * @return false unless it is a non-empty string of at most MAX_ROOM_ID_LENGTH characters.  
     */  
-   void sigRemoveSession(const QString& clientId);  
+   static bool parseRoom(const QJsonValue& value, QString& room);  
 
-private:  
    /**  
-    * @brief Handles a new WebSocket connection.  
+    * @brief Handles an error message.  
+    * @param message The error message.  
+    * @param task The task of the message, for the source session.  
+    * @param worker Pointer to the Worker instance processing the task.  
     */  
-   void onNewConnection();  
+   void handleError(const QString& message, const SignalingTask& task, Worker* worker);  
 
    /**  
-    * @brief Handles a WebSocket disconnection.  
+    * @brief Checks if a client is registered. O(1) and lock-free, safe to call from any Worker.  
+    * @param client The session to check; NO_SESSION is never online.  
+    * @return True if the client is online, false otherwise.  
     */  
-   void onDisconnected();  
+   bool isOnline(SessionHandle client) const;  
 
+private:  
    /**  
-    * @brief Processes data received from a client.  
-    * @param srcId The ID of the source client.  
-    * @param data The data received from the client.  
+    * @brief Processes data received from a client. Runs on the session's I/O thread.  
+    * @param src The source session.  
+    * @param srcId Its external ID.  
+    * @param data The data received from the client, a text or a binary message.  
     */  
-   void onClientDataReady(const QString& srcId, const QString& data);  
+   void onClientDataReady(SessionHandle src, const QString& srcId, const WireMessage& data);  
 
    /**  
-    * @brief Handles the result of a worker's task.  
-    * @param targetClient The ID of the target client.  
+    * @brief Handles the result of a worker's task. Runs on the Worker thread and posts  
+    * the message to the I/O thread owning the target session.  
+    * @param target The target session.  
     * @param message The result message.  
     */  
-   void onWorkerResult(const QString& targetClient, const QString& message);  
+   void onWorkerResult(SessionHandle target, const WireMessage& message);  
 
    /**  
-    * @brief Adds a new session to the session list.  
-    * @param clientId The ID of the new client session.  
+    * @brief Handles a broadcast of a worker. Thread-safe: runs on the Worker threads, and on the  
+    * I/O threads for PEER_LEFT on disconnect. Groups the targets by owning I/O thread and posts  
+    * one batch to each.  
+    * @param targets The target sessions.  
+    * @param message The message, serialized once and shared by every target.  
     */  
-   void onAddSession(const QString& clientId);  
+   void onWorkerBroadcast(const QVector<SessionHandle>& targets, const WireMessage& message);  
 
    /**  
-    * @brief Removes a session from the session list.  
-    * @param clientId The ID of the removed client session.  
+    * @brief Leaves the room of a closed session and announces it. Runs on the session's I/O thread.  
+    * @param client The closed session, already stale in the SessionTable.  
+    * @param clientId Its external ID.  
     */  
-   void onRemoveSession(const QString& clientId);  
+   void onSessionClosed(SessionHandle client, const QString& clientId);  
 
 private:  
-   QWebSocketServer* _server;  ///< Pointer to the WebSocket server instance.  
-   QHash<QString, ClientSession*> _sessions;  ///< Hash map of client sessions.  
+   IoThreadPool* _ioPool;  ///< I/O threads owning the client sockets; _ioPool->sessions() maps handles to them.  
+   IoAcceptor* _server;  ///< Listening socket, hands accepted connections to _ioPool.  
+   MetricsServer* _metricsServer;  ///< GET /metrics listener, nullptr until startMetrics().  
    WorkerPool* _workerPool;  ///< Pointer to the worker pool instance.  
    QHash<QString, handlerFunc> _handlerMap;  ///< Map of handler functions for signaling messages.  
-   QJsonArray _session_list;  ///< List of active client sessions.  
+   RoomRegistry _rooms;  ///< Room of every session and members of every room.  
+   QAtomicInt _shuttingDown;  ///< Set by shutdown(): closing sessions no longer announce PEER_LEFT.  
    QHostAddress _hostAddress;  ///< Address the server is bound to.  
    quint16 _port;  ///< Port the server is bound to.  
    bool _isRunning;  ///< Flag indicating whether the server is running.  
@@ -238,10 +323,26 @@ public:
    QString id() const;  
 
    /**  
-    * @brief Sends data to the client.  
+    * @brief Sends data to the client: the frame if the session is binary and the message has one,  
+    * the text otherwise. Call WireMessage::prepare() with wireFormat() first.  
     * @param data The data to send.  
     */  
-   void sendData(const QString& data);  
+   void sendData(const WireMessage& data);  
+
+   /**  
+    * @brief Gets the wire format negotiated at REGISTER; JSON until then.  
+    */  
+   WireFormat::Format wireFormat() const;  
+
+   /**  
+    * @brief Sets the wire format of the messages sent from now on.  
+    */  
+   void setWireFormat(WireFormat::Format format);  
+
+   /**  
+    * @brief Flushes pending frames and starts the closing handshake (server shutdown).  
+    */  
+   void close();  
 
 signals:  
    /**  
@@ -249,7 +350,7 @@ signals:
     * @param sessionId The ID of the client session.  
     * @param data The data received from the client.  
     */  
-   void sigDataReady(const QString& sessionId, const QString& data);  
+   void sigDataReady(const QString& sessionId, const WireMessage& data);  
 
    /**  
     * @brief Signal emitted when the client disconnects.  
@@ -264,6 +365,12 @@ private:
     */  
    void onTextMessageReceived(const QString& message);  
 
+   /**  
+    * @brief Handles binary frames received from the client, accepted in either wire format.  
+    * @param message The frame received from the client.  
+    */  
+   void onBinaryMessageReceived(const QByteArray& message);  
+
    /**  
     * @brief Handles the disconnection of the client.  
     */  
@@ -272,4 +379,5 @@ private:
 private:  
    QWebSocket* _socket;  ///< Pointer to the QWebSocket instance.  
    QString _id;  ///< Unique identifier for the client session.  
+   WireFormat::Format _format;  ///< Encoding of the messages sent to the client.  
 };
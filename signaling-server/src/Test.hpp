@@ -1,13 +1,25 @@
 #ifndef __TEST_HPP__
 #define __TEST_HPP__
 #include "BlockingQueue.hpp"
+#include "MpmcQueue.hpp"
+#include "RouteScanner.hpp"
+#include "ShardedQueue.hpp"
+#include "RoomRegistry.hpp"
+#include "SessionTable.hpp"
+#include "WireFormat.hpp"
+#include "IoThreadPool.h"
+#include "Metrics.h"
 #include "SignalingServer.h"
 #include "Worker.h"
 #include <thread>  
 #include <vector>  
+#include <atomic>
+#include <chrono>
 #include <Windows.h>  
 #include <iostream>  
 #include <QDebug>
+#include <QDir>
+#include <QThread>
 
 class Test {
 public:
@@ -56,6 +68,586 @@ public:
         for (auto& thread : threads) {
             thread.join();
         }
+
+        // Contention benchmark: N producers x M consumers, mutex queue vs lock-free ring
+        const int configs[][2] = { {1, 1}, {1, 4}, {4, 1}, {4, 4}, {8, 8} };
+        for (const auto& config : configs) {
+            const double mutexRate = benchQueue<BlockingQueue<int>>(config[0], config[1], 200000);
+            const double ringRate = benchQueue<MpmcQueue<int>>(config[0], config[1], 200000);
+            std::cout << config[0] << "P x " << config[1] << "C: BlockingQueue " << mutexRate
+                      << " Mops/s, MpmcQueue " << ringRate << " Mops/s" << std::endl;
+        }
+    }
+
+    // @brief Pushes itemsPerProducer ints from each producer, consumers pop until all are taken.
+    // @return Throughput in million items per second.
+    template<class Queue>
+    double benchQueue(int producers, int consumers, int itemsPerProducer) {
+        auto queue = std::make_shared<Queue>();
+        const long long total = static_cast<long long>(producers) * itemsPerProducer;
+        std::atomic<long long> consumed{ 0 };
+        std::atomic<long long> checksum{ 0 };
+        std::vector<std::thread> threads;
+
+        const auto begin = std::chrono::steady_clock::now();
+        for (int c = 0; c < consumers; ++c) {
+            threads.emplace_back([&]() {
+                int ele = 0;
+                while (consumed.load(std::memory_order_relaxed) < total) {
+                    if (queue->pop(ele, 10)) {
+                        checksum.fetch_add(ele, std::memory_order_relaxed);
+                        consumed.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+            });
+        }
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([&]() {
+                for (int i = 0; i < itemsPerProducer; ++i) {
+                    while (!queue->push(i)) std::this_thread::yield(); // bounded ring is full
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        const long long expected = static_cast<long long>(producers) * itemsPerProducer * (itemsPerProducer - 1LL) / 2;
+        if (checksum.load() != expected) {
+            std::cout << "checksum mismatch: " << checksum.load() << " != " << expected << std::endl;
+        }
+        return total / seconds / 1e6;
+    }
+
+    // @brief Test for ShardedQueue counters: 4 producers and 2 consumers hammer a few shards,
+    // size() must never exceed what was pushed (a pop ahead of the count would wrap it around).
+    void testShardedQueue() {
+        ShardedQueue<int> queue(64, 1024);
+        queue.setConsumerCount(2);
+        const int producers = 4;
+        const int itemsPerProducer = 200000;
+        std::atomic<int> popped{ 0 };
+        std::atomic<bool> wrapped{ false };
+        std::vector<std::thread> threads;
+
+        for (int c = 0; c < 2; ++c) {
+            threads.emplace_back([&, c]() {
+                int ele = 0;
+                while (popped.load(std::memory_order_relaxed) < producers * itemsPerProducer) {
+                    const int shard = queue.acquire(static_cast<size_t>(c), 10);
+                    if (shard < 0) continue;
+                    for (int n = 0; n < 16 && queue.tryPop(shard, ele); ++n) popped.fetch_add(1, std::memory_order_relaxed);
+                    queue.release(shard);
+                    if (queue.size() > static_cast<size_t>(producers * itemsPerProducer)) wrapped.store(true);
+                }
+            });
+        }
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([&, p]() {
+                for (int i = 0; i < itemsPerProducer; ++i) {
+                    while (!queue.push(static_cast<size_t>(p * 7 + i % 3), i)) std::this_thread::yield();
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const bool pass = !wrapped.load() && queue.size() == 0;
+        std::cout << (pass ? "pass: " : "FAIL: ") << "ShardedQueue size under 4P x 2C" << std::endl;
+    }
+
+    // @brief Test for RouteScanner: routing fields, fallbacks, and relay throughput against the
+    // full QJsonDocument round trip on 4-8 KB SDP offers and small ICE candidates.
+    void testRouteScanner() {
+        struct Case { const char* json; bool ok; const char* to; };
+        const Case cases[] = {
+            { R"({"type":"OFFER","to":"B","data":{"sdp":"v=0\r\n{[\"x\"]}"}})", true, "B" },
+            { R"( { "data":{"a":[1,{"b":"}"}]}, "from" : "evil", "to":"B", "type":"ICE" } )", true, "B" },
+            { R"({"type":"OFFER","to":"B","n":-1.5e3,"t":true,"z":null})", true, "B" },
+            { R"({"type":"OFFER","to":5})", false, "" },
+            { R"({"type":"OF\"FER","to":"B"})", false, "" },
+            { R"({"type":"OFFER","to":"B",})", false, "" },
+            { R"({"type":"OFFER","to":"B","d":{"x":1})", false, "" },
+            { R"([1,2])", false, "" },
+            { R"({"type":"OFFER","to":"B","fr\u006fm":"victim"})", false, "" },
+            { R"({"type":"OFFER","t\u006f":"C","to":"B"})", false, "" },
+            { R"({"type":"OFFER","to":"B","from":"x","from":"y"})", false, "" },
+            { R"({"type":"OFFER","to":"B","to":"C"})", false, "" },
+            { R"({"type":"OFFER","type":"ICE","to":"B"})", false, "" },
+        };
+        for (const Case& c : cases) {
+            const QString payload = QString::fromUtf8(c.json);
+            RouteScanner::Route route;
+            const bool ok = RouteScanner::scan(payload, route);
+            bool pass = ok == c.ok;
+            if (ok && pass) {
+                pass = RouteScanner::value(payload, route.to) == QLatin1String(c.to);
+                // The spliced text must parse to the same object with "from" replaced
+                QJsonObject expected = QJsonDocument::fromJson(payload.toUtf8()).object();
+                expected.insert("from", "A");
+                pass = pass && QJsonDocument::fromJson(RouteScanner::spliceFrom(payload, route, "A").toUtf8()).object() == expected;
+            }
+            std::cout << (pass ? "pass: " : "FAIL: ") << c.json << std::endl;
+        }
+
+        for (int sdpSize : { 4096, 8192 }) {
+            const QString offer = makeRelayMessage("OFFER", sdpSize);
+            std::cout << "OFFER " << sdpSize << " B: full parse " << benchRelay(offer, false)
+                      << " msg/s, route scan " << benchRelay(offer, true) << " msg/s" << std::endl;
+        }
+        const QString ice = makeRelayMessage("ICE", 0);
+        std::cout << "ICE: full parse " << benchRelay(ice, false)
+                  << " msg/s, route scan " << benchRelay(ice, true) << " msg/s" << std::endl;
+    }
+
+    // @brief Builds a client message; sdpSize 0 makes an ICE candidate instead of an SDP.
+    QString makeRelayMessage(const char* type, int sdpSize) {
+        QJsonObject data;
+        if (sdpSize > 0) {
+            QString sdp = "v=0\r\no=- 4611731400430051336 2 IN IP4 127.0.0.1\r\ns=-\r\nt=0 0\r\n";
+            for (int i = 0; sdp.size() < sdpSize; ++i) {
+                sdp += QString("a=candidate:%1 1 udp 2122260223 192.168.1.%2 %3 typ host generation 0\r\n")
+                    .arg(i).arg(i % 250).arg(50000 + i);
+                sdp += "a=fingerprint:sha-256 4A:AD:B9:B1:3F:82:18:3B:54:02:12:DF:3E:5D:49:6B:19:E5:7C:AB\r\n";
+            }
+            data.insert("type", "offer");
+            data.insert("sdp", sdp.left(sdpSize));
+        }
+        else {
+            data.insert("candidate", "candidate:842163049 1 udp 1677729535 203.0.113.7 46154 typ srflx raddr 0.0.0.0 rport 0 generation 0");
+            data.insert("mid", "0");
+        }
+        QJsonObject json;
+        json.insert("type", type);
+        json.insert("to", "6f1c2a9e4b7d4e0f8a3b5c6d7e8f9a0b");
+        json.insert("data", data);
+        return QJsonDocument(json).toJson(QJsonDocument::Compact);
+    }
+
+    // @brief Relays one message repeatedly the old way (parse + rebuild + serialize) or by
+    // scanning and splicing "from". @return Messages per second.
+    double benchRelay(const QString& payload, bool scan) {
+        const QString srcId = "0a9f8e7d6c5b4a3f2e1d0c9b8a7f6e5d";
+        const int iterations = 20000;
+        qsizetype sink = 0;
+
+        const auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            if (scan) {
+                RouteScanner::Route route;
+                RouteScanner::scan(payload, route);
+                sink += RouteScanner::spliceFrom(payload, route, srcId).size();
+            }
+            else {
+                const QJsonObject in = QJsonDocument::fromJson(payload.toUtf8()).object();
+                QJsonObject out;
+                out.insert("type", in["type"]);
+                out.insert("from", srcId);
+                out.insert("to", in["to"]);
+                out.insert("data", in["data"]);
+                sink += QString(QJsonDocument(out).toJson(QJsonDocument::Compact)).size();
+            }
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        if (sink == 0) std::cout << "empty output" << std::endl;
+        return iterations / seconds;
+    }
+
+    // @brief Test for batched ICE: a data.candidates batch is relayed unchanged in both wire formats
+    // (only "from" is rewritten), then relay cost of 20 single-candidate messages against one batch.
+    void testIceBatchRelay() {
+        const int batchSize = 20;
+        QJsonArray candidates;
+        for (int i = 0; i < batchSize; ++i) {
+            QJsonObject candidate;
+            candidate.insert("candidate", QString("candidate:%1 1 udp 2122260223 192.168.1.%2 %3 typ host generation 0")
+                .arg(842163049 + i).arg(10 + i).arg(50000 + i));
+            candidate.insert("sdpMid", "0");
+            candidates.append(candidate);
+        }
+        QJsonObject data;
+        data.insert("candidates", candidates);
+        QJsonObject json;
+        json.insert("type", "ICE");
+        json.insert("to", "6f1c2a9e4b7d4e0f8a3b5c6d7e8f9a0b");
+        json.insert("data", data);
+        const QString batch = QJsonDocument(json).toJson(QJsonDocument::Compact);
+
+        RouteScanner::Route route;
+        bool pass = RouteScanner::scan(batch, route);
+        const QJsonObject relayed = QJsonDocument::fromJson(RouteScanner::spliceFrom(batch, route, "A").toUtf8()).object();
+        pass = pass && relayed["from"].toString() == "A" && relayed["data"].toObject() == data;
+        std::cout << (pass ? "pass: " : "FAIL: ") << "JSON batch relayed unchanged" << std::endl;
+
+        const QByteArray frame = WireFormat::encode(SignalingType::ICE, QString(), json["to"].toString(), data);
+        WireFormat::Header header;
+        pass = WireFormat::parseHeader(frame, header);
+        const QByteArray spliced = WireFormat::spliceFrom(frame, header, "A");
+        WireFormat::Header splicedHeader;
+        pass = pass && WireFormat::parseHeader(spliced, splicedHeader)
+            && spliced.mid(splicedHeader.bodyBegin()) == frame.mid(header.bodyBegin());
+        QJsonObject decoded;
+        pass = pass && WireFormat::decode(spliced, decoded) && decoded["data"].toObject()["candidates"].toArray() == candidates;
+        std::cout << (pass ? "pass: " : "FAIL: ") << "binary batch relayed unchanged" << std::endl;
+
+        const QString single = makeRelayMessage("ICE", 0);
+        const double singleRate = benchRelay(single, true);
+        const double batchRate = benchRelay(batch, true);
+        std::cout << batchSize << " candidates: " << batchSize / singleRate * 1e6 << " us as single messages, "
+                  << 1 / batchRate * 1e6 << " us as one batch, " << batch.toUtf8().size() << " B vs "
+                  << batchSize * single.toUtf8().size() << " B" << std::endl;
+    }
+
+    // @brief Test for AsyncLogger: per-event cost on the calling thread with 1-4 threads
+    // logging at once, and how many events a burst drops when the rings fill up.
+    void testAsyncLogger() {
+        AsyncLogger& logger = AsyncLogger::instance();
+        if (!logger.setSink(QDir::temp().filePath("signaling-logger-bench.jsonl"))) {
+            std::cout << "cannot open the temporary log file" << std::endl;
+            return;
+        }
+        const QString clientId = "6f1c2a9e4b7d4e0f8a3b5c6d7e8f9a0b";
+        const QString payload = makeRelayMessage("OFFER", 4096);
+        const int eventsPerThread = 2000;  // below RING_CAPACITY: measures the hot path, not drops
+
+        for (int threads : { 1, 2, 4 }) {
+            const quint64 droppedBefore = logger.dropped();
+            std::atomic<qint64> totalNs{ 0 };
+            std::vector<std::thread> pool;
+            for (int t = 0; t < threads; ++t) {
+                pool.emplace_back([&]() {
+                    const auto begin = std::chrono::steady_clock::now();
+                    for (int i = 0; i < eventsPerThread; ++i) {
+                        logger.log(LOG_LEVEL_INFO, __FILE__, __LINE__, "send", { { "to", clientId }, { "chars", payload.size() }, { "seq", i } });
+                    }
+                    totalNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+                });
+            }
+            for (std::thread& thread : pool) thread.join();
+            logger.flush();
+            std::cout << threads << " threads: " << totalNs.load() / (threads * eventsPerThread)
+                      << " ns/event, dropped " << logger.dropped() - droppedBefore << std::endl;
+        }
+
+        // A burst far over the ring size must drop, not block
+        const quint64 droppedBefore = logger.dropped();
+        for (int i = 0; i < 20 * static_cast<int>(AsyncLogger::RING_CAPACITY); ++i) {
+            logger.log(LOG_LEVEL_INFO, __FILE__, __LINE__, "burst", { { "seq", i } });
+        }
+        logger.flush();
+        std::cout << "burst of " << 20 * AsyncLogger::RING_CAPACITY << ": dropped " << logger.dropped() - droppedBefore << std::endl;
+        logger.setSink(QString());
+    }
+
+    // @brief Test for Metrics: every latency lands in the bucket whose bounds contain it, and the
+    // per-update cost with 1-8 threads recording at once (shards keep it flat).
+    void testMetrics() {
+        bool bucketsOk = true;
+        for (qint64 ns = 1; ns < 200000000000LL; ns = ns * 101 / 100 + 1) {
+            const int bucket = Metrics::bucketOf(ns);
+            const double seconds = ns / 1e9;
+            if (bucket < Metrics::BUCKET_COUNT) {
+                bucketsOk = bucketsOk && seconds <= Metrics::bucketUpperSeconds(bucket) * (1 + 1e-12);
+                bucketsOk = bucketsOk && (bucket == 0 || seconds > Metrics::bucketUpperSeconds(bucket - 1));
+            }
+            else {
+                bucketsOk = bucketsOk && seconds > Metrics::bucketUpperSeconds(Metrics::BUCKET_COUNT - 1);
+            }
+        }
+        std::cout << (bucketsOk ? "pass: " : "FAIL: ") << "latency buckets" << std::endl;
+
+        const int updatesPerThread = 1000000;
+        for (int threads : { 1, 2, 4, 8 }) {
+            std::vector<std::thread> pool;
+            const auto begin = std::chrono::steady_clock::now();
+            for (int t = 0; t < threads; ++t) {
+                pool.emplace_back([&]() {
+                    for (int i = 0; i < updatesPerThread; ++i) {
+                        Metrics::instance().add(Metrics::MESSAGES_SENT);
+                        Metrics::instance().observeMessage(SignalingType::ICE, 1000 + i % 100000);
+                    }
+                });
+            }
+            for (std::thread& thread : pool) thread.join();
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            std::cout << threads << " threads: " << seconds * 1e9 / updatesPerThread
+                      << " ns per message (counter + histogram)" << std::endl;
+        }
+        const QByteArray text = Metrics::instance().scrape();
+        std::cout << "scrape: " << text.size() << " bytes" << std::endl;
+    }
+
+    // @brief PEER_JOINED fan-out to a 5000-peer lobby, Worker side, through the shipped pieces: a real
+    // SessionTable and IoThread::post()/postBatch() onto real IoThreads. Per peer (old: one
+    // serialization and one queued call per peer) against broadcastPresence + onWorkerBroadcast
+    // (one serialization, SessionTable::groupByOwner, one postBatch per I/O thread). The IoThreads
+    // are never started, so the queued calls are only posted: socket writes are not measured.
+    void benchPeerJoinedFanout() {
+        const int peerCount = 5000;
+        const int ioThreadCount = 4;
+        SessionTable sessions;
+        std::vector<QThread*> threads;
+        std::vector<IoThread*> ioThreads;
+        for (int t = 0; t < ioThreadCount; ++t) {
+            IoThread* io = new IoThread(t + 1, &sessions, [](SessionHandle, const QString&, const WireMessage&) {},
+                [](SessionHandle, const QString&) {});
+            QThread* thread = new QThread();
+            io->moveToThread(thread);
+            threads.push_back(thread);
+            ioThreads.push_back(io);
+        }
+        QVector<SessionHandle> peers;
+        for (int i = 0; i < peerCount; ++i) {
+            peers.append(sessions.open(QUuid::createUuid().toString(QUuid::Id128), ioThreads[i % ioThreadCount], nullptr));
+        }
+        const QString joinedId = QUuid::createUuid().toString(QUuid::Id128);
+        QJsonObject joinData;
+        joinData.insert("id", joinedId);
+        joinData.insert("room", "lobby");
+        QJsonObject notify;
+        notify.insert("type", "PEER_JOINED");
+        notify.insert("from", "Server");
+        notify.insert("data", joinData);
+
+        auto begin = std::chrono::steady_clock::now();
+        for (SessionHandle peer : peers) {
+            notify["to"] = sessions.id(peer);
+            IoThread* owner = sessions.owner(peer);
+            if (owner != nullptr) owner->post(peer, QString(QJsonDocument(notify).toJson(QJsonDocument::Compact)));
+        }
+        const double perPeer = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+
+        begin = std::chrono::steady_clock::now();
+        notify["to"] = "All";
+        const WireMessage shared(QString(QJsonDocument(notify).toJson(QJsonDocument::Compact)));
+        int offline = 0;
+        const QHash<IoThread*, QVector<SessionHandle>> groups = sessions.groupByOwner(peers, offline);
+        for (auto it = groups.cbegin(); it != groups.cend(); ++it) {
+            it.key()->postBatch(it.value(), shared);
+        }
+        const double once = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+
+        // Never started: deleting the objects discards the posted calls
+        for (int t = 0; t < ioThreadCount; ++t) {
+            delete ioThreads[t];
+            delete threads[t];
+        }
+        std::cout << peerCount << " peers: per-peer serialization " << perPeer << " us, " << peerCount
+                  << " posts; serialize once " << once << " us, " << groups.size() << " posts"
+                  << (offline > 0 ? " (offline targets!)" : "") << std::endl;
+    }
+
+    // @brief Test for RoomRegistry: join/move/leave results, then threads moving clients between
+    // rooms at random must leave every member set consistent with the client -> room map.
+    void testRoomRegistry() {
+        RoomRegistry rooms;
+        const SessionHandle a = 1, b = 2;
+        bool pass = rooms.join(a, "r1").before->isEmpty() && rooms.roomCount() == 1;
+        const RoomRegistry::Change second = rooms.join(b, "r1");
+        pass = pass && second.before->contains(a) && second.left.isEmpty();
+        const RoomRegistry::Change move = rooms.join(b, "r2");
+        pass = pass && move.left == "r1" && move.stayed->contains(a) && !move.stayed->contains(b) && move.before->isEmpty();
+        pass = pass && rooms.join(b, "r2").alreadyMember;
+        const RoomRegistry::Change leave = rooms.leave(a);
+        pass = pass && leave.left == "r1" && leave.stayed->isEmpty() && rooms.roomCount() == 1 && rooms.roomOf(a).isEmpty();
+        pass = pass && rooms.leave(a).left.isEmpty();
+        std::cout << (pass ? "pass: " : "FAIL: ") << "join/move/leave" << std::endl;
+
+        const int threads = 8;
+        const int clientsPerThread = 200;
+        const int roomCount = 16;
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; ++t) {
+            pool.emplace_back([&rooms, t]() {
+                for (int i = 0; i < 20000; ++i) {
+                    const SessionHandle client = static_cast<SessionHandle>(t * clientsPerThread + i % clientsPerThread + 1);
+                    if (i % 7 == 0) rooms.leave(client);
+                    else rooms.join(client, QString("room%1").arg((i * 31 + t) % roomCount));
+                }
+            });
+        }
+        for (std::thread& thread : pool) thread.join();
+
+        bool consistent = true;
+        int members = 0;
+        for (int r = 0; r < roomCount; ++r) {
+            const QString room = QString("room%1").arg(r);
+            for (SessionHandle client : *rooms.members(room)) {
+                consistent = consistent && rooms.roomOf(client) == room;
+                ++members;
+            }
+        }
+        int assigned = 0;
+        for (int t = 0; t < threads; ++t) {
+            for (int c = 0; c < clientsPerThread; ++c) {
+                assigned += rooms.roomOf(static_cast<SessionHandle>(t * clientsPerThread + c + 1)).isEmpty() ? 0 : 1;
+            }
+        }
+        consistent = consistent && members == assigned;
+        std::cout << (consistent ? "pass: " : "FAIL: ") << "concurrent moves, " << members << " members in "
+                  << rooms.roomCount() << " rooms" << std::endl;
+    }
+
+    // @brief Test for per-sender order across room changes: every 64th task of a sender moves it to
+    // another room, the workers check that each sender's tasks still arrive in submission order.
+    void testSenderOrderAcrossRooms(QObject* parent) {
+        const int senders = 64;
+        const int tasksPerSender = 2000;
+        RoomRegistry rooms;
+        std::vector<std::atomic<int>> last(senders + 1);
+        for (std::atomic<int>& seq : last) seq.store(0);
+        std::atomic<int> done{ 0 };
+        std::atomic<int> outOfOrder{ 0 };
+
+        WorkerPool* workerPool = new WorkerPool(parent);
+        workerPool->start(4, [&](const SignalingTask& task, Worker*) {
+            const int seq = task._payload.toInt();
+            if (seq % 64 == 0) rooms.join(task._handle, QString("room%1").arg(seq / 64 % 4));
+            if (last[task._handle].exchange(seq) != seq - 1) outOfOrder.fetch_add(1);
+            done.fetch_add(1);
+        });
+
+        for (int seq = 1; seq <= tasksPerSender; ++seq) {
+            for (SessionHandle handle = 1; handle <= senders; ++handle) {
+                const SignalingTask task(handle, QString::number(handle), QString::number(seq));
+                while (!workerPool->submitTask(task)) Sleep(1);
+            }
+        }
+        while (done.load() < senders * tasksPerSender) Sleep(1);
+        workerPool->stop();
+
+        std::cout << (outOfOrder.load() == 0 ? "pass: " : "FAIL: ") << "sender order across room changes, "
+                  << outOfOrder.load() << " out of order" << std::endl;
+    }
+
+    // @brief Test for SessionTable: open/close/reuse with stale handles, the ID <-> handle mapping
+    // and setOnline after close; then one lookup per forwarded message, by ID string against by handle.
+    void testSessionTable() {
+        SessionTable table;
+        IoThread* owner = reinterpret_cast<IoThread*>(0x10);
+        ClientSession* session = reinterpret_cast<ClientSession*>(0x20);
+
+        const SessionHandle a = table.open("a", owner, session);
+        const SessionHandle b = table.open("b", owner, session);
+        bool pass = a != NO_SESSION && b != NO_SESSION && a != b && table.size() == 2;
+        pass = pass && table.find("a") == a && table.id(b) == "b" && table.ids(QVector<SessionHandle>{ a, b }).size() == 2;
+        pass = pass && table.owner(a) == owner && table.session(a, owner) == session && table.session(a, nullptr) == nullptr;
+        pass = pass && !table.isOnline(a) && table.setOnline(a) && !table.setOnline(a) && table.isOnline(a) && table.onlineCount() == 1;
+
+        table.close(a);
+        pass = pass && !table.isOpen(a) && !table.isOnline(a) && table.owner(a) == nullptr && table.onlineCount() == 0;
+        pass = pass && table.find("a") == NO_SESSION && table.id(a).isEmpty() && !table.setOnline(a);
+        // The slot is reused with a new generation: the old handle must not reach the new session
+        const SessionHandle c = table.open("c", owner, session);
+        pass = pass && static_cast<quint32>(c) == static_cast<quint32>(a) && c != a && !table.isOpen(a) && table.isOpen(c);
+        int offline = 0;
+        const QHash<IoThread*, QVector<SessionHandle>> groups = table.groupByOwner({ a, b, c }, offline);
+        pass = pass && offline == 1 && groups.value(owner).size() == 2 && table.ownedBy(owner).size() == 2;
+        std::cout << (pass ? "pass: " : "FAIL: ") << "open/close/reuse" << std::endl;
+
+        const int sessions = 10000;
+        const int iterations = 1000000;
+        QHash<QString, IoThread*> byId;
+        QStringList ids;
+        QVector<SessionHandle> handles;
+        for (int i = 0; i < sessions; ++i) {
+            const QString id = QUuid::createUuid().toString(QUuid::Id128);
+            ids.append(id);
+            byId.insert(id, owner);
+            handles.append(table.open(id, owner, session));
+        }
+
+        quintptr sink = 0;
+        auto begin = std::chrono::steady_clock::now();
+        // Strided, so consecutive lookups do not hit the same cache lines
+        for (int i = 0, j = 0; i < iterations; ++i, j = (j + 7919) % sessions) {
+            sink += reinterpret_cast<quintptr>(byId.value(ids[j], nullptr));
+        }
+        const double byString = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / iterations;
+
+        begin = std::chrono::steady_clock::now();
+        for (int i = 0, j = 0; i < iterations; ++i, j = (j + 7919) % sessions) {
+            sink += reinterpret_cast<quintptr>(table.owner(handles[j]));
+        }
+        const double byHandle = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / iterations;
+
+        if (sink == 0) std::cout << "empty output" << std::endl;
+        std::cout << sessions << " sessions, owner lookup: by ID " << byString << " ns, by handle " << byHandle << " ns" << std::endl;
+    }
+
+    // @brief Test for WireFormat: JSON <-> frame round trips, then bytes on the wire and CPU per
+    // message of both formats for the server relay (scan + splice) and the client (build + parse).
+    void testWireFormat() {
+        for (const QString& text : { makeRelayMessage("OFFER", 4096), makeRelayMessage("ICE", 0) }) {
+            const QByteArray frame = WireFormat::fromText(text);
+            WireFormat::Header header;
+            bool pass = WireFormat::parseHeader(frame, header) && WireFormat::to(frame, header) == "6f1c2a9e4b7d4e0f8a3b5c6d7e8f9a0b";
+            const QByteArray spliced = WireFormat::spliceFrom(frame, header, "A");
+            QJsonObject expected = QJsonDocument::fromJson(text.toUtf8()).object();
+            expected.insert("from", "A");
+            QJsonObject decoded;
+            pass = pass && WireFormat::decode(spliced, decoded) && decoded == expected;
+            std::cout << (pass ? "pass: " : "FAIL: ") << "round trip " << header.bodyBegin() << "-byte header" << std::endl;
+        }
+        QJsonObject decoded;
+        const bool rejects = !WireFormat::decode(QByteArray("\x01\x02\x05\x00" "ab", 6), decoded)
+            && !WireFormat::decode(QByteArray("\x02\x02\x00\x00", 4), decoded) && WireFormat::fromText("{\"type\":\"X\"}").isEmpty();
+        std::cout << (rejects ? "pass: " : "FAIL: ") << "malformed frames" << std::endl;
+
+        for (int sdpSize : { 0, 4096, 8192 }) {
+            const QString text = makeRelayMessage(sdpSize > 0 ? "OFFER" : "ICE", sdpSize);
+            const QByteArray frame = WireFormat::fromText(text);
+            std::cout << (sdpSize > 0 ? "OFFER " : "ICE ") << sdpSize << " B: wire json " << text.toUtf8().size()
+                      << " B, binary " << frame.size() << " B; server relay json " << benchRelay(text, true)
+                      << " msg/s, binary " << benchFrameRelay(frame) << " msg/s; client build + parse json "
+                      << benchClientCodec(text, false) << " us, binary " << benchClientCodec(text, true) << " us" << std::endl;
+        }
+    }
+
+    // @brief Relays one frame repeatedly the way relayFrame() does. @return Messages per second.
+    double benchFrameRelay(const QByteArray& frame) {
+        const QString srcId = "0a9f8e7d6c5b4a3f2e1d0c9b8a7f6e5d";
+        const int iterations = 20000;
+        qsizetype sink = 0;
+
+        const auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            WireFormat::Header header;
+            WireFormat::parseHeader(frame, header);
+            sink += WireFormat::to(frame, header).size() + WireFormat::spliceFrom(frame, header, srcId).size();
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        if (sink == 0) std::cout << "empty output" << std::endl;
+        return iterations / seconds;
+    }
+
+    // @brief Serializes and parses one message the way a client does, as compact JSON or as a
+    // frame with a CBOR body. @return Microseconds per message.
+    double benchClientCodec(const QString& text, bool binary) {
+        const QJsonObject json = QJsonDocument::fromJson(text.toUtf8()).object();
+        const QJsonObject data = json["data"].toObject();
+        const SignalingType type = string_to_stype(json["type"].toString());
+        const int iterations = 5000;
+        qsizetype sink = 0;
+
+        const auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            QJsonObject parsed;
+            if (binary) {
+                const QByteArray frame = WireFormat::encode(type, "me", json["to"].toString(), data);
+                WireFormat::decode(frame, parsed);
+            }
+            else {
+                QJsonObject msg = json;
+                msg.insert("from", "me");
+                parsed = QJsonDocument::fromJson(QJsonDocument(msg).toJson(QJsonDocument::Compact)).object();
+            }
+            sink += parsed.size();
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        if (sink == 0) std::cout << "empty output" << std::endl;
+        return seconds * 1e6 / iterations;
     }
 
     // @brief Test for class WorkerPool.
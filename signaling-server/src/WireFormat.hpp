@@ -0,0 +1,272 @@
+#ifndef __WIRE_FORMAT_HPP__
+#define __WIRE_FORMAT_HPP__
+
+#include "Common.hpp"
+
+#include <QByteArray>
+#include <QCborMap>
+#include <QCborValue>
+#include <QString>
+
+/**
+* @namespace WireFormat
+* @brief Binary framing of signaling messages, the alternative to JSON text negotiated at REGISTER.
+*
+* A frame is one WebSocket binary message:
+*
+*     0       1       2         3         4            4+F          4+F+T
+*     +-------+-------+---------+---------+------------+------------+---------------+
+*     |version| type  | from: F | to: T   | from UTF-8 | to UTF-8   | data (CBOR)   |
+*     +-------+-------+---------+---------+------------+------------+---------------+
+*
+* The routing fields sit at fixed offsets, so the server relays OFFER/ANSWER/ICE by reading four
+* bytes and the "to" ID and rewriting "from", without touching the body. The body is the "data"
+* object as a CBOR map (empty body = empty object); the SDP travels as a raw CBOR text string,
+* without the JSON escaping of every line break.
+*/
+namespace WireFormat {
+
+ /**
+  * @brief Encoding a session sends and expects.
+  */
+ enum class Format {
+     JSON,    ///< Compact JSON text messages, the default.
+     BINARY   ///< Frames as described above, in binary messages.
+ };
+
+ const quint8 VERSION = 1;
+ const int HEADER_SIZE = 4;
+ const int MAX_ID_BYTES = 255;   ///< IDs are length-prefixed with one byte.
+
+ /**
+  * @brief Wire code of a message type. Fixed, independent of the SignalingType order.
+  * @return 0 for UNKNOWN.
+  */
+ inline quint8 typeCode(SignalingType type) {
+     switch (type) {
+         case SignalingType::REGISTER_REQUEST: return 1;
+         case SignalingType::OFFER: return 2;
+         case SignalingType::ANSWER: return 3;
+         case SignalingType::ICE: return 4;
+         case SignalingType::JOIN_ROOM: return 5;
+         case SignalingType::LEAVE_ROOM: return 6;
+         case SignalingType::REGISTER_SUCCESS: return 16;
+         case SignalingType::PEER_JOINED: return 17;
+         case SignalingType::PEER_LEFT: return 18;
+         case SignalingType::ROOM_JOINED: return 19;
+         case SignalingType::ROOM_LEFT: return 20;
+         case SignalingType::ERROR_MESSAGE: return 31;
+         default: return 0;
+     }
+ }
+
+ /**
+  * @brief Message type of a wire code; UNKNOWN for codes this build does not know.
+  */
+ inline SignalingType typeOf(quint8 code) {
+     switch (code) {
+         case 1: return SignalingType::REGISTER_REQUEST;
+         case 2: return SignalingType::OFFER;
+         case 3: return SignalingType::ANSWER;
+         case 4: return SignalingType::ICE;
+         case 5: return SignalingType::JOIN_ROOM;
+         case 6: return SignalingType::LEAVE_ROOM;
+         case 16: return SignalingType::REGISTER_SUCCESS;
+         case 17: return SignalingType::PEER_JOINED;
+         case 18: return SignalingType::PEER_LEFT;
+         case 19: return SignalingType::ROOM_JOINED;
+         case 20: return SignalingType::ROOM_LEFT;
+         case 31: return SignalingType::ERROR_MESSAGE;
+         default: return SignalingType::UNKNOWN;
+     }
+ }
+
+ /**
+  * @brief The fixed part of a frame.
+  */
+ struct Header {
+     SignalingType type = SignalingType::UNKNOWN;
+     int fromSize = 0;
+     int toSize = 0;
+     int fromBegin() const { return HEADER_SIZE; }
+     int toBegin() const { return HEADER_SIZE + fromSize; }
+     int bodyBegin() const { return HEADER_SIZE + fromSize + toSize; }
+ };
+
+ /**
+  * @brief Reads the header of a frame; the body is not looked at.
+  * @return false if the version is unknown or the frame is shorter than its IDs.
+  */
+ inline bool parseHeader(const QByteArray& frame, Header& header) {
+     if (frame.size() < HEADER_SIZE || static_cast<quint8>(frame[0]) != VERSION) return false;
+     header.type = typeOf(static_cast<quint8>(frame[1]));
+     header.fromSize = static_cast<quint8>(frame[2]);
+     header.toSize = static_cast<quint8>(frame[3]);
+     return frame.size() >= header.bodyBegin();
+ }
+
+ inline QString from(const QByteArray& frame, const Header& header) {
+     return QString::fromUtf8(frame.constData() + header.fromBegin(), header.fromSize);
+ }
+
+ inline QString to(const QByteArray& frame, const Header& header) {
+     return QString::fromUtf8(frame.constData() + header.toBegin(), header.toSize);
+ }
+
+ /**
+  * @brief Encodes the "data" object as a frame body.
+  */
+ inline QByteArray encodeData(const QJsonObject& data) {
+     if (data.isEmpty()) return QByteArray();
+     return QCborValue(QCborMap::fromJsonObject(data)).toCbor();
+ }
+
+ /**
+  * @brief Builds a frame.
+  * @param body The "data" object, already encoded with encodeData().
+  * @return An empty array if an ID is longer than MAX_ID_BYTES in UTF-8.
+  */
+ inline QByteArray encode(SignalingType type, const QString& from, const QString& to, const QByteArray& body) {
+     const QByteArray fromUtf8 = from.toUtf8();
+     const QByteArray toUtf8 = to.toUtf8();
+     if (fromUtf8.size() > MAX_ID_BYTES || toUtf8.size() > MAX_ID_BYTES) return QByteArray();
+
+     QByteArray frame;
+     frame.reserve(HEADER_SIZE + fromUtf8.size() + toUtf8.size() + body.size());
+     frame.append(static_cast<char>(VERSION));
+     frame.append(static_cast<char>(typeCode(type)));
+     frame.append(static_cast<char>(fromUtf8.size()));
+     frame.append(static_cast<char>(toUtf8.size()));
+     frame.append(fromUtf8).append(toUtf8).append(body);
+     return frame;
+ }
+
+ inline QByteArray encode(SignalingType type, const QString& from, const QString& to, const QJsonObject& data) {
+     return encode(type, from, to, encodeData(data));
+ }
+
+ /**
+  * @brief Copies a frame with "from" replaced; the body is copied byte for byte.
+  * @return An empty array if the ID is longer than MAX_ID_BYTES in UTF-8.
+  */
+ inline QByteArray spliceFrom(const QByteArray& frame, const Header& header, const QString& from) {
+     const QByteArray fromUtf8 = from.toUtf8();
+     if (fromUtf8.size() > MAX_ID_BYTES) return QByteArray();
+
+     QByteArray out;
+     out.reserve(frame.size() - header.fromSize + fromUtf8.size());
+     out.append(frame.constData(), 2);
+     out.append(static_cast<char>(fromUtf8.size()));
+     out.append(frame[3]);
+     out.append(fromUtf8);
+     out.append(frame.constData() + header.toBegin(), frame.size() - header.toBegin());
+     return out;
+ }
+
+ /**
+  * @brief Decodes the body of a frame.
+  * @return false if the body is not a CBOR map.
+  */
+ inline bool decodeData(const QByteArray& frame, const Header& header, QJsonObject& data) {
+     if (frame.size() == header.bodyBegin()) {
+         data = QJsonObject();
+         return true;
+     }
+     QCborParserError error;
+     const QCborValue body = QCborValue::fromCbor(
+         QByteArray::fromRawData(frame.constData() + header.bodyBegin(), frame.size() - header.bodyBegin()), &error);
+     if (error.error != QCborError::NoError || !body.isMap()) return false;
+     data = body.toMap().toJsonObject();
+     return true;
+ }
+
+ /**
+  * @brief Decodes a whole frame into the JSON message it stands for.
+  * @return false if the header or the body is malformed.
+  */
+ inline bool decode(const QByteArray& frame, QJsonObject& json) {
+     Header header;
+     QJsonObject data;
+     if (!parseHeader(frame, header) || !decodeData(frame, header, data)) return false;
+     json = QJsonObject();
+     json.insert("type", stype_to_string(header.type));
+     json.insert("from", from(frame, header));
+     json.insert("to", to(frame, header));
+     json.insert("data", data);
+     return true;
+ }
+
+ /**
+  * @brief Converts a JSON text message to a frame.
+  * @return An empty array if the text is not a message of a known type.
+  */
+ inline QByteArray fromText(const QString& text) {
+     const QJsonObject json = QJsonDocument::fromJson(text.toUtf8()).object();
+     const SignalingType type = string_to_stype(json["type"].toString());
+     if (type == SignalingType::UNKNOWN) return QByteArray();
+     return encode(type, json["from"].toString(), json["to"].toString(), json["data"].toObject());
+ }
+
+ /**
+  * @brief Converts a frame to a JSON text message.
+  * @return An empty string if the frame is malformed.
+  */
+ inline QString toText(const QByteArray& frame) {
+     QJsonObject json;
+     if (!decode(frame, json)) return QString();
+     return QString::fromUtf8(QJsonDocument(json).toJson(QJsonDocument::Compact));
+ }
+
+ /**
+  * @brief Reads the "wire" field of REGISTER_REQUEST / REGISTER_SUCCESS.
+  */
+ inline Format parse(const QJsonValue& value) {
+     return value.toString() == QLatin1String("binary") ? Format::BINARY : Format::JSON;
+ }
+
+ inline QString name(Format format) {
+     return format == Format::BINARY ? QStringLiteral("binary") : QStringLiteral("json");
+ }
+}
+
+/**
+* @struct WireMessage
+* @brief A message in either encoding. Sessions send the representation of their own format and
+* convert on demand; both members are implicitly shared, so copies along the pipeline are cheap.
+*/
+struct WireMessage {
+ QString text;      ///< JSON text; empty while the message only exists as a frame.
+ QByteArray frame;  ///< Binary frame; empty while the message only exists as text.
+
+ WireMessage() {}
+
+ /**
+  * @brief Wraps a JSON text message; implicit, the server builds its own messages as JSON.
+  */
+ WireMessage(const QString& json) : text(json) {}
+
+ /**
+  * @brief Wraps a binary frame.
+  */
+ static WireMessage binary(const QByteArray& frame) {
+     WireMessage message;
+     message.frame = frame;
+     return message;
+ }
+
+ /**
+  * @brief Adds the representation a session of the given format sends, converting at most once.
+  * @return false if the message has no such representation and cannot be converted; a BINARY
+  * session then falls back to the text.
+  */
+ bool prepare(WireFormat::Format format) {
+     if (format == WireFormat::Format::BINARY) {
+         if (frame.isEmpty() && !text.isEmpty()) frame = WireFormat::fromText(text);
+         return !frame.isEmpty();
+     }
+     if (text.isEmpty() && !frame.isEmpty()) text = WireFormat::toText(frame);
+     return !text.isEmpty();
+ }
+};
+
+#endif // __WIRE_FORMAT_HPP__
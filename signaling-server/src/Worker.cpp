@@ -1,6 +1,7 @@
 #include "Worker.h"
+#include "Metrics.h"
 
-Worker::Worker(int id, BlockingQueue<SignalingTask>::bqPtr queue, SignalingProcessor processor, QObject* parent)
+Worker::Worker(int id, TaskQueue::bqPtr queue, SignalingProcessor processor, QObject* parent)
 	: QObject(parent), _workerId(id), _queue(queue), _isRunning(false), _processor(processor)
 {}
 
@@ -20,21 +21,23 @@ void Worker::startLoop()
     INFO() << "Worker" << _workerId << "start";
     _isRunning.testAndSetRelaxed(false, true);
     while (true) {
-        SignalingTask task;
-        if (_isRunning.loadRelaxed()) {
-            if (_queue->pop(task, DEFAULT_TIMEOUT)) {
-                processMessage(task);
+        // Own shards first, otherwise steal one; a shard is held by one Worker at a time,
+        // so the tasks of a client are processed in the order they arrived
+        const int shard = _queue->acquire(static_cast<size_t>(_workerId - 1), DEFAULT_TIMEOUT);
+        if (shard < 0) {
+            if (_queue->isClosed() || !_isRunning.loadRelaxed()) {
+                break; // pool stopped and everything is drained
             }
+            continue;
         }
-        else {
-            if (_queue->tryPop(task)) {
-                processMessage(task);
-            }
-            else {
-                break;
-            }
+
+        SignalingTask task;
+        for (int n = 0; n < SHARD_BATCH && _queue->tryPop(shard, task); ++n) {
+            processMessage(task);
         }
+        _queue->release(shard);
     }
+    _isRunning.storeRelaxed(false);
     INFO() << "Worker" << _workerId << "exit";
     emit finished();
 }
@@ -44,13 +47,20 @@ int Worker::getId()
     return _workerId;
 }
 
+qint64 Worker::busyNanos() const
+{
+    return _busyNs.load(std::memory_order_relaxed);
+}
+
 void Worker::processMessage(const SignalingTask& task)
 {
+    const qint64 begin = Metrics::now();
     _processor(task, this);
+    _busyNs.store(_busyNs.load(std::memory_order_relaxed) + Metrics::now() - begin, std::memory_order_relaxed);
 }
 
 WorkerPool::WorkerPool(QObject* parent):
-    QObject(parent), _taskQueue(new BlockingQueue<SignalingTask>), _isRunning(false)
+    QObject(parent), _taskQueue(new TaskQueue(TASK_QUEUE_SHARDS, TASK_QUEUE_CAPACITY / TASK_QUEUE_SHARDS)), _isRunning(false)
 {}
 
 WorkerPool::~WorkerPool()
@@ -70,6 +80,8 @@ bool WorkerPool::start(size_t threadCount, Worker::SignalingProcessor processor)
         FATAL() << "Thread count must be greater than 0, you input: " << threadCount;
         assert(threadCount > 0);
     }
+    _taskQueue->open();
+    _taskQueue->setConsumerCount(threadCount);
 
     for (int i = 0; i < threadCount; ++i) {
         QThread* thread = new QThread(this);
@@ -79,8 +91,11 @@ bool WorkerPool::start(size_t threadCount, Worker::SignalingProcessor processor)
 
         // register signal with slot function
         connect(thread, &QThread::started, worker, &Worker::startLoop);
+        // Direct: responses are routed on the Worker thread instead of queuing through the main thread
         connect(worker, &Worker::sigSendResponse,
-            this, &WorkerPool::onSendResponse);
+            this, &WorkerPool::onSendResponse, Qt::DirectConnection);
+        connect(worker, &Worker::sigBroadcast,
+            this, &WorkerPool::onBroadcast, Qt::DirectConnection);
 
         _threads.append(thread);
         _workers.append(worker);
@@ -98,8 +113,9 @@ bool WorkerPool::stop()
         worker->stop();
     }
 
+    // Wakes the idle Workers; they drain what is left and exit
     if (_taskQueue != nullptr) {
-        _taskQueue->notifyAll();
+        _taskQueue->close();
     }
 
     for (QThread* thread : _threads) {
@@ -120,15 +136,37 @@ bool WorkerPool::submitTask(const SignalingTask& task)
         CRITICAL() << "WorkerPool is not running!";
         return false;
     }
-    _taskQueue->push(task);
+    // One shard per sender: its OFFER and the ICE candidates that follow stay in order
+    if (!_taskQueue->push(task._shardKey, task)) {
+        Metrics::instance().add(Metrics::TASKS_DROPPED);
+        LOG_EVENT(LOG_LEVEL_WARNING, "task_dropped", { "from", task._clientId }, { "queued", static_cast<qint64>(_taskQueue->size()) });
+        return false;
+    }
     return true;
 }
 
 int WorkerPool::getQueueSize() const { return _taskQueue->size(); }
 
-void WorkerPool::onSendResponse(const QString& targetId, const QString& json)
+int WorkerPool::threadCount() const { return _threads.size(); }
+
+QVector<qint64> WorkerPool::busyNanos() const
+{
+    QVector<qint64> busy;
+    busy.reserve(_workers.size());
+    for (const Worker* worker : _workers) {
+        busy.append(worker->busyNanos());
+    }
+    return busy;
+}
+
+void WorkerPool::onSendResponse(SessionHandle target, const WireMessage& message)
+{
+    emit sigWorkerResult(target, message);
+}
+
+void WorkerPool::onBroadcast(const QVector<SessionHandle>& targets, const WireMessage& message)
 {
-    emit sigWorkerResult(targetId, json);
+    emit sigWorkerBroadcast(targets, message);
 }
 
 void WorkerPool::handleWorkerFinished() {
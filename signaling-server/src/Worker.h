@@ -2,9 +2,33 @@
 #define __WORKER_H__  
 
 #include "Common.hpp"  
-#include "BlockingQueue.hpp"  
-
-const int DEFAULT_TIMEOUT = 100;  
+#include "WireFormat.hpp"
+#include "ShardedQueue.hpp"  
+
+/**
+* @brief How long an idle Worker sleeps in pop(); -1 = until a task arrives or the queue is closed.
+*/
+const int DEFAULT_TIMEOUT = -1;
+
+/**
+* @brief Slots in the WorkerPool task queue over all shards. submitTask() fails instead of blocking when a shard is full.
+*/
+const size_t TASK_QUEUE_CAPACITY = 65536;
+
+/**
+* @brief Shards of the task queue. Tasks of one client always land in the same shard.
+*/
+const size_t TASK_QUEUE_SHARDS = 64;
+
+/**
+* @brief Tasks a Worker takes from a shard before giving it back, bounds how long one hot client holds it.
+*/
+const int SHARD_BATCH = 32;
+
+/**
+* @brief The queue shared by the WorkerPool and its Workers, sharded by client for per-client ordering.
+*/
+using TaskQueue = ShardedQueue<SignalingTask>;
 
 /**  
 * @class Worker  
@@ -27,12 +51,12 @@ public:
 
   /**  
    * @brief Constructs a Worker instance.  
-   * @param id Unique identifier for the Worker.  
-   * @param queue Pointer to the shared blocking queue containing tasks.  
+   * @param id Unique identifier for the Worker, 1-based; id - 1 selects its home shards.  
+   * @param queue Pointer to the shared task queue.  
    * @param processor Function to process tasks.  
    * @param parent Pointer to the parent QObject (default is nullptr).  
    */  
-  explicit Worker(int id, BlockingQueue<SignalingTask>::bqPtr queue, SignalingProcessor processor, QObject* parent = nullptr);  
+  explicit Worker(int id, TaskQueue::bqPtr queue, SignalingProcessor processor, QObject* parent = nullptr);  
   /**  
    * @brief Destructor for the Worker class.  
    */  
@@ -56,13 +80,26 @@ public:
    */  
   int getId();
 
+  /**  
+   * @brief Gets the time spent processing tasks since the Worker started. Safe from any thread.  
+   * @return Busy time in nanoseconds.  
+   */  
+  qint64 busyNanos() const;
+
 signals:  
   /**  
    * @brief Signal emitted when a task is processed and a response is ready.  
-   * @param targetId The ID of the target client.  
-   * @param json The processed data in JSON format.  
+   * @param target The handle of the target session.  
+   * @param message The processed data, JSON text or a binary frame.  
    */  
-  void sigSendResponse(const QString& targetId, const QString& json);  
+  void sigSendResponse(SessionHandle target, const WireMessage& message);  
+
+  /**  
+   * @brief Signal emitted when one message goes to many clients, serialized once.  
+   * @param targets The handles of the target sessions.  
+   * @param message The message, shared by every target.  
+   */  
+  void sigBroadcast(const QVector<SessionHandle>& targets, const WireMessage& message);  
 
   /**  
    * @brief Signal emitted when the Worker exits its processing loop and completes cleanup.  
@@ -78,9 +115,10 @@ private:
 
 private:  
   int _workerId;  ///< Unique identifier for the Worker.  
-  BlockingQueue<SignalingTask>::bqPtr _queue;  ///< Shared blocking queue for tasks.  
+  TaskQueue::bqPtr _queue;  ///< Shared task queue.  
   QAtomicInt _isRunning;  ///< Atomic flag indicating whether the Worker is running.  
   SignalingProcessor _processor;  ///< Function to process tasks.  
+  std::atomic<qint64> _busyNs{ 0 };  ///< Time inside _processor; written by the Worker thread only.  
 };  
 
 /**  
@@ -125,7 +163,7 @@ public:
    /**  
     * @brief Producer interface: Submits a task to the queue.  
     * @param task The signaling task to be processed.  
-    * @return True if the task is successfully submitted, false if the thread pool is stopped.  
+    * @return True if the task is successfully submitted, false if the thread pool is stopped or the queue is full.  
     */  
    bool submitTask(const SignalingTask& task);  
 
@@ -135,17 +173,38 @@ public:
     */  
    int getQueueSize() const;  
 
+   /**  
+    * @brief Gets the number of running Worker threads.  
+    */  
+   int threadCount() const;  
+
+   /**  
+    * @brief Gets the busy time of every Worker, indexed by Worker ID - 1.  
+    * @return Nanoseconds spent processing tasks per Worker.  
+    */  
+   QVector<qint64> busyNanos() const;  
+
 signals:  
    /**  
     * @brief Forwards the processing results from Workers to the TcpSignalingServer.  
-    * @param targetId The target client ID.  
-    * @param json The response data.  
+    * Emitted on the Worker thread; receivers must be thread-safe.  
+    * @param target The target session handle.  
+    * @param message The response data.  
     */  
-   void sigWorkerResult(const QString& targetId, const QString& json);  
+   void sigWorkerResult(SessionHandle target, const WireMessage& message);  
+
+   /**  
+    * @brief Forwards broadcasts from Workers. Emitted on the Worker thread; receivers must be thread-safe.  
+    * @param targets The target session handles.  
+    * @param message The message, shared by every target.  
+    */  
+   void sigWorkerBroadcast(const QVector<SessionHandle>& targets, const WireMessage& message);  
 
 private:
 
-    void onSendResponse(const QString& targetId, const QString& json);
+    void onSendResponse(SessionHandle target, const WireMessage& message);
+
+    void onBroadcast(const QVector<SessionHandle>& targets, const WireMessage& message);
 
 private:  
    /**  
@@ -155,7 +214,7 @@ private:
    void handleWorkerFinished();  
 
 private:  
-   BlockingQueue<SignalingTask>::bqPtr _taskQueue;  ///< Task queue owned by the WorkerPool.  
+   TaskQueue::bqPtr _taskQueue;                     ///< Task queue owned by the WorkerPool.  
    QVector<QThread*> _threads;                      ///< Container for QThread instances.  
    QVector<Worker*> _workers;                       ///< Container for Worker objects.  
    QAtomicInt _isRunning;                           ///< Atomic flag indicating whether the thread pool is running.  
@@ -0,0 +1,684 @@
+// Load generator for the signaling server (Linux).
+//
+//   signaling-loadgen [--url ws://127.0.0.1:11290] [--server <signaling-server-headless> | --server-pid <pid>]
+//                     [--clients 2000] [--threads 2] [--connect-concurrency 256]
+//                     [--rate 20000] [--duration 10] [--mix 1:1:8] [--sdp-bytes 4096] [--wire json|binary]
+//                     [--ice-batch 1] [--output result.json]
+//
+// Opens --clients WebSocket clients, registers them, then sends OFFER/ANSWER/ICE (ratio --mix) between
+// random pairs at a fixed total --rate for --duration seconds (open loop, so a slow server shows up as
+// latency, not as a lower send rate). Every relay message carries its send time in data.t; the receiving
+// client, in the same process, takes the forward latency from it. Results are written as JSON:
+// connection setup rate, registration time, messages/sec, p50/p99/p999 latency, bytes on the wire per
+// message, and - when the server process is known (--server spawns it, --server-pid attaches) - its RSS
+// growth per session and CPU time per relayed message. --wire binary negotiates WireFormat frames at
+// REGISTER, so both formats can be compared on the same traffic. --ice-batch N sends N candidates per ICE
+// message in data.candidates, as the client does when it coalesces its trickle.
+#include "Common.hpp"
+#include "WireFormat.hpp"
+
+#include <QCborMap>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QTimer>
+#include <QUrl>
+#include <QtEndian>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace
+{
+    struct Config {
+        QUrl url = QUrl("ws://127.0.0.1:11290");
+        QString serverPath;
+        qint64 serverPid = 0;
+        int clients = 2000;
+        int threads = 2;
+        int connectConcurrency = 256;
+        double rate = 20000;
+        int duration = 10;
+        int mix[3] = { 1, 1, 8 };  // OFFER : ANSWER : ICE
+        int sdpBytes = 4096;
+        bool binary = false;  // --wire binary
+        int iceBatch = 1;     // candidates per ICE message
+        QString output;
+    };
+
+    // Shared by the shards; read by the main thread to follow the phases
+    struct Counters {
+        std::atomic<int> connected{ 0 };
+        std::atomic<int> connectFailed{ 0 };
+        std::atomic<int> registered{ 0 };
+        std::atomic<qint64> peerJoined{ 0 };
+        std::atomic<qint64> received{ 0 };
+    };
+
+    struct ShardResult {
+        qint64 sent = 0;
+        qint64 received = 0;
+        qint64 errors = 0;
+        qint64 disconnected = 0;
+        qint64 bytesSent = 0;      // message payloads, without the WebSocket framing
+        qint64 bytesReceived = 0;
+        std::vector<qint64> latencyUs;
+    };
+
+    const auto g_epoch = std::chrono::steady_clock::now();
+
+    qint64 nowUs()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_epoch).count();
+    }
+
+    const QLatin1String TIME_KEY("\"t\":");
+
+    // Binary bodies start with the send time: a CBOR map, key "t", then a 64-bit unsigned integer
+    const char CBOR_TIME_KEY[] = { 0x61, 't', 0x1b };
+    const int CBOR_TIME_OFFSET = 1 + sizeof(CBOR_TIME_KEY);
+
+    /**
+    * @brief A slice of the clients with its own thread and event loop.
+    * All methods except the constructor run on the shard's thread.
+    */
+    class Shard : public QObject
+    {
+    public:
+        Shard(int index, const Config& config, Counters* counters)
+            : _config(config), _counters(counters), _rng(index * 7919 + 17)
+        {
+            // JSON-escaped SDP filler, same shape as a browser offer
+            QString sdp = "v=0\\r\\no=- 4611731400430051336 2 IN IP4 127.0.0.1\\r\\ns=-\\r\\nt=0 0\\r\\n";
+            for (int i = 0; sdp.size() < config.sdpBytes; ++i) {
+                sdp += QString("a=candidate:%1 1 udp 2122260223 192.168.1.%2 %3 typ host generation 0\\r\\n")
+                    .arg(i).arg(i % 250).arg(50000 + i);
+            }
+            sdp.truncate(config.sdpBytes);
+            while (sdp.endsWith('\\')) sdp.chop(1);  // do not cut an escape in half
+            _offerBody = QString("\"type\":\"offer\",\"sdp\":\"%1\"").arg(sdp);
+            _answerBody = QString("\"type\":\"answer\",\"sdp\":\"%1\"").arg(sdp);
+            _iceBody = "\"candidate\":\"candidate:842163049 1 udp 1677729535 203.0.113.7 46154 typ srflx raddr 0.0.0.0 rport 0 generation 0\",\"sdpMid\":\"0\",\"sdpMLineIndex\":0";
+            QJsonArray candidates;
+            for (int i = 0; i < config.iceBatch; ++i) {
+                QJsonObject candidate;
+                candidate.insert("candidate", QString("candidate:%1 1 udp 2122260223 192.168.1.%2 %3 typ host generation 0")
+                    .arg(842163049 + i).arg(10 + i % 240).arg(50000 + i));
+                candidate.insert("sdpMid", "0");
+                candidates.append(candidate);
+            }
+            if (config.iceBatch > 1) {
+                const QByteArray json = QJsonDocument(QJsonObject{ { "candidates", candidates } }).toJson(QJsonDocument::Compact);
+                _iceBody = QString::fromUtf8(json.mid(1, json.size() - 2));  // members only, after "t"
+            }
+
+            // The same bodies as CBOR map entries, after the "t" entry added per message
+            QString rawSdp = sdp;
+            rawSdp.replace("\\r\\n", "\r\n");
+            _offerCbor = cborEntries({ { "type", "offer" }, { "sdp", rawSdp } });
+            _answerCbor = cborEntries({ { "type", "answer" }, { "sdp", rawSdp } });
+            _iceCbor = config.iceBatch > 1 ? cborEntries({ { "candidates", candidates } }) :
+                cborEntries({ { "candidate", "candidate:842163049 1 udp 1677729535 203.0.113.7 46154 typ srflx raddr 0.0.0.0 rport 0 generation 0" },
+                { "sdpMid", "0" }, { "sdpMLineIndex", 0 } });
+        }
+
+        void openClients(int count)
+        {
+            _toOpen = count;
+            _maxInFlight = qMax(1, _config.connectConcurrency / _config.threads);
+            while (_inFlight < _maxInFlight && _toOpen > 0) openNext();
+        }
+
+        QStringList peerIds() const
+        {
+            QStringList ids;
+            for (const Client& client : _clients) {
+                if (!client.peerId.isEmpty()) ids.append(client.peerId);
+            }
+            return ids;
+        }
+
+        void startTraffic(std::shared_ptr<const QStringList> peers)
+        {
+            _peers = std::move(peers);
+            for (int i = 0; i < static_cast<int>(_clients.size()); ++i) {
+                if (!_clients[i].peerId.isEmpty()) _senders.push_back(i);
+            }
+            if (_senders.empty() || _peers->size() < 2) return;
+
+            _ratePerUs = _config.rate / _config.threads / 1e6;
+            _lastTickUs = nowUs();
+            _credit = 0;
+            _result.latencyUs.reserve(static_cast<size_t>(_config.rate / _config.threads * _config.duration * 1.1));
+
+            _ticker = new QTimer(this);
+            _ticker->setTimerType(Qt::PreciseTimer);
+            QObject::connect(_ticker, &QTimer::timeout, this, [this]() { onTick(); });
+            _ticker->start(1);
+        }
+
+        void stopTraffic()
+        {
+            if (_ticker) _ticker->stop();
+        }
+
+        ShardResult takeResult()
+        {
+            return std::move(_result);
+        }
+
+        void closeAll()
+        {
+            for (Client& client : _clients) {
+                if (client.socket) client.socket->abort();
+            }
+        }
+
+    private:
+        struct Client {
+            QWebSocket* socket = nullptr;
+            QString peerId;
+            bool binary = false;  // the server accepted the binary wire format
+        };
+
+        // Map entries without the map header, and their count
+        struct CborEntries {
+            QByteArray bytes;
+            int count = 0;
+        };
+
+        static CborEntries cborEntries(const QJsonObject& data)
+        {
+            const QByteArray map = QCborValue(QCborMap::fromJsonObject(data)).toCbor();
+            return CborEntries{ map.mid(1), static_cast<int>(data.size()) };  // small maps: one header byte
+        }
+
+        void openNext()
+        {
+            --_toOpen;
+            ++_inFlight;
+            const int index = static_cast<int>(_clients.size());
+            QWebSocket* socket = new QWebSocket(QString(), QWebSocketProtocol::VersionLatest, this);
+            _clients.push_back(Client{ socket, QString() });
+
+            QObject::connect(socket, &QWebSocket::connected, this, [this, socket]() {
+                _counters->connected.fetch_add(1, std::memory_order_relaxed);
+                socket->setProperty("settled", true);
+                socket->sendTextMessage(_config.binary ?
+                    "{\"type\":\"REGISTER_REQUEST\",\"to\":\"Server\",\"data\":{\"wire\":\"binary\"}}" :
+                    "{\"type\":\"REGISTER_REQUEST\",\"to\":\"Server\",\"data\":{}}");
+                handshakeDone();
+            });
+            QObject::connect(socket, &QWebSocket::errorOccurred, this, [this, socket](QAbstractSocket::SocketError) {
+                // Only errors before the handshake completed count as connect failures
+                if (!socket->property("settled").toBool()) {
+                    socket->setProperty("settled", true);
+                    _counters->connectFailed.fetch_add(1, std::memory_order_relaxed);
+                    handshakeDone();
+                }
+            });
+            QObject::connect(socket, &QWebSocket::disconnected, this, [this]() {
+                ++_result.disconnected;
+            });
+            QObject::connect(socket, &QWebSocket::textMessageReceived, this, [this, index](const QString& message) {
+                onText(index, message);
+            });
+            QObject::connect(socket, &QWebSocket::binaryMessageReceived, this, [this, index](const QByteArray& frame) {
+                onBinary(index, frame);
+            });
+            socket->open(_config.url);
+        }
+
+        void handshakeDone()
+        {
+            --_inFlight;
+            if (_toOpen > 0) openNext();
+        }
+
+        void onText(int index, const QString& message)
+        {
+            _counters->received.fetch_add(1, std::memory_order_relaxed);
+            _result.bytesReceived += message.size();  // ASCII only
+
+            // Relay messages are ours: only pull the send time out, do not parse the SDP
+            const int at = message.indexOf(TIME_KEY);
+            if (at >= 0) {
+                qint64 sentUs = 0;
+                for (int i = at + TIME_KEY.size(); i < message.size() && message[i].isDigit(); ++i) {
+                    sentUs = sentUs * 10 + message[i].digitValue();
+                }
+                _result.latencyUs.push_back(nowUs() - sentUs);
+                ++_result.received;
+                return;
+            }
+
+            onJson(index, QJsonDocument::fromJson(message.toUtf8()).object());
+        }
+
+        void onBinary(int index, const QByteArray& frame)
+        {
+            _counters->received.fetch_add(1, std::memory_order_relaxed);
+            _result.bytesReceived += frame.size();
+
+            WireFormat::Header header;
+            if (!WireFormat::parseHeader(frame, header)) {
+                ++_result.errors;
+                return;
+            }
+            // Relay messages are ours: the send time sits at a fixed place in the body
+            const int at = header.bodyBegin() + CBOR_TIME_OFFSET;
+            if (frame.size() >= at + 8 && memcmp(frame.constData() + header.bodyBegin() + 1, CBOR_TIME_KEY, sizeof(CBOR_TIME_KEY)) == 0) {
+                const qint64 sentUs = static_cast<qint64>(qFromBigEndian<quint64>(frame.constData() + at));
+                _result.latencyUs.push_back(nowUs() - sentUs);
+                ++_result.received;
+                return;
+            }
+
+            QJsonObject json;
+            if (WireFormat::decode(frame, json)) onJson(index, json);
+            else ++_result.errors;
+        }
+
+        void onJson(int index, const QJsonObject& json)
+        {
+            const QString type = json["type"].toString();
+            if (type == "REGISTER_SUCCESS") {
+                const QJsonObject data = json["data"].toObject();
+                _clients[index].peerId = data["peerId"].toString();
+                _clients[index].binary = WireFormat::parse(data["wire"]) == WireFormat::Format::BINARY;
+                _counters->registered.fetch_add(1, std::memory_order_relaxed);
+            }
+            else if (type == "PEER_JOINED") {
+                _counters->peerJoined.fetch_add(1, std::memory_order_relaxed);
+            }
+            else if (type == "ERROR_MESSAGE") {
+                ++_result.errors;
+            }
+        }
+
+        void onTick()
+        {
+            const qint64 now = nowUs();
+            // At most 100 ms of backlog, so a stalled event loop does not turn into one huge burst
+            _credit = qMin(_credit + (now - _lastTickUs) * _ratePerUs, _ratePerUs * 100000);
+            _lastTickUs = now;
+
+            const int total = _config.mix[0] + _config.mix[1] + _config.mix[2];
+            std::uniform_int_distribution<size_t> pickSender(0, _senders.size() - 1);
+            std::uniform_int_distribution<int> pickPeer(0, static_cast<int>(_peers->size()) - 1);
+            std::uniform_int_distribution<int> pickType(0, total - 1);
+
+            for (; _credit >= 1; _credit -= 1) {
+                const Client& sender = _clients[_senders[pickSender(_rng)]];
+                const QString* target = &_peers->at(pickPeer(_rng));
+                if (*target == sender.peerId) target = &_peers->at((pickPeer(_rng) + 1) % _peers->size());
+                if (*target == sender.peerId) continue;
+
+                const int roll = pickType(_rng);
+                const int kind = roll < _config.mix[0] ? 0 : roll < _config.mix[0] + _config.mix[1] ? 1 : 2;
+
+                qint64 bytes = 0;
+                if (sender.binary) {
+                    static const SignalingType types[] = { SignalingType::OFFER, SignalingType::ANSWER, SignalingType::ICE };
+                    const CborEntries& entries = kind == 0 ? _offerCbor : kind == 1 ? _answerCbor : _iceCbor;
+                    QByteArray body;
+                    body.reserve(CBOR_TIME_OFFSET + 8 + entries.bytes.size());
+                    body.append(static_cast<char>(0xa0 + 1 + entries.count));
+                    body.append(CBOR_TIME_KEY, sizeof(CBOR_TIME_KEY));
+                    char time[8];
+                    qToBigEndian<quint64>(static_cast<quint64>(nowUs()), time);
+                    body.append(time, sizeof(time));
+                    body.append(entries.bytes);
+                    bytes = sender.socket->sendBinaryMessage(WireFormat::encode(types[kind], QString(), *target, body));
+                }
+                else {
+                    static const char* const types[] = { "OFFER", "ANSWER", "ICE" };
+                    const QString& entries = kind == 0 ? _offerBody : kind == 1 ? _answerBody : _iceBody;
+                    bytes = sender.socket->sendTextMessage(QString("{\"type\":\"%1\",\"to\":\"%2\",\"data\":{\"t\":%3,%4}}")
+                        .arg(QString::fromLatin1(types[kind]), *target, QString::number(nowUs()), entries));
+                }
+                _result.bytesSent += qMax<qint64>(0, bytes);
+                ++_result.sent;
+            }
+        }
+
+        const Config& _config;
+        Counters* _counters;
+        std::mt19937 _rng;
+        std::vector<Client> _clients;
+        int _toOpen = 0;
+        int _inFlight = 0;
+        int _maxInFlight = 1;
+
+        std::shared_ptr<const QStringList> _peers;
+        std::vector<int> _senders;
+        QTimer* _ticker = nullptr;
+        double _ratePerUs = 0;
+        double _credit = 0;
+        qint64 _lastTickUs = 0;
+        QString _offerBody;
+        QString _answerBody;
+        QString _iceBody;
+        CborEntries _offerCbor;
+        CborEntries _answerCbor;
+        CborEntries _iceCbor;
+        ShardResult _result;
+    };
+
+    // Runs the main event loop until cond() holds or the timeout expires
+    bool waitUntil(const std::function<bool()>& cond, int timeoutMs)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        QEventLoop loop;
+        QTimer poll;
+        QObject::connect(&poll, &QTimer::timeout, &loop, [&]() {
+            if (cond() || timer.elapsed() >= timeoutMs) loop.quit();
+        });
+        poll.start(10);
+        if (!cond()) loop.exec();
+        return cond();
+    }
+
+    qint64 readRssKb(qint64 pid)
+    {
+        if (pid <= 0) return -1;
+        QFile status(QString("/proc/%1/status").arg(pid));
+        if (!status.open(QIODevice::ReadOnly)) return -1;
+        for (const QByteArray& line : status.readAll().split('\n')) {
+            if (line.startsWith("VmRSS:")) {
+                return line.mid(6).trimmed().split(' ').first().toLongLong();
+            }
+        }
+        return -1;
+    }
+
+    // utime + stime of a process in microseconds, -1 if unknown
+    qint64 readCpuUs(qint64 pid)
+    {
+        if (pid <= 0) return -1;
+        QFile stat(QString("/proc/%1/stat").arg(pid));
+        if (!stat.open(QIODevice::ReadOnly)) return -1;
+        // The command name may contain spaces: fields are counted after its closing parenthesis
+        const QByteArray line = stat.readAll();
+        const QList<QByteArray> fields = line.mid(line.lastIndexOf(')') + 2).split(' ');
+        if (fields.size() < 13) return -1;
+        const qint64 ticks = fields[11].toLongLong() + fields[12].toLongLong();
+        return ticks * 1000000 / sysconf(_SC_CLK_TCK);
+    }
+
+    void raiseFileLimit()
+    {
+        rlimit limit = {};
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+    }
+
+    qint64 percentile(const std::vector<qint64>& sorted, double p)
+    {
+        if (sorted.empty()) return -1;
+        const size_t index = std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+        return sorted[index];
+    }
+
+    bool parseOptions(const QCoreApplication& app, Config& config)
+    {
+        QCommandLineParser parser;
+        parser.setApplicationDescription("Signaling server load generator");
+        parser.addHelpOption();
+        const QCommandLineOption urlOption("url", "Server URL (default ws://127.0.0.1:11290).", "url");
+        const QCommandLineOption serverOption("server", "Spawn this signaling-server-headless binary on the URL's port.", "path");
+        const QCommandLineOption pidOption("server-pid", "PID of an already running server, for memory per session.", "pid");
+        const QCommandLineOption clientsOption("clients", "Number of WebSocket clients (default 2000).", "n");
+        const QCommandLineOption threadsOption("threads", "Generator threads (default 2).", "n");
+        const QCommandLineOption concurrencyOption("connect-concurrency", "Handshakes in flight (default 256).", "n");
+        const QCommandLineOption rateOption("rate", "Total relay messages per second (default 20000).", "n");
+        const QCommandLineOption durationOption("duration", "Traffic phase in seconds (default 10).", "s");
+        const QCommandLineOption mixOption("mix", "OFFER:ANSWER:ICE ratio (default 1:1:8).", "o:a:i");
+        const QCommandLineOption sdpOption("sdp-bytes", "SDP size of OFFER/ANSWER (default 4096).", "n");
+        const QCommandLineOption wireOption("wire", "Wire format negotiated at REGISTER: json or binary (default json).", "format");
+        const QCommandLineOption iceBatchOption("ice-batch", "Candidates per ICE message, in data.candidates when above 1 (default 1).", "n");
+        const QCommandLineOption outputOption("output", "Write the JSON result to this file instead of stdout.", "file");
+        parser.addOptions({ urlOption, serverOption, pidOption, clientsOption, threadsOption, concurrencyOption,
+            rateOption, durationOption, mixOption, sdpOption, wireOption, iceBatchOption, outputOption });
+        parser.process(app);
+
+        auto positive = [&](const QCommandLineOption& option, int& out) {
+            if (!parser.isSet(option)) return true;
+            bool ok = false;
+            const int value = parser.value(option).toInt(&ok);
+            if (!ok || value <= 0) {
+                CRITICAL() << "Invalid" << option.names().first() << ":" << parser.value(option);
+                return false;
+            }
+            out = value;
+            return true;
+        };
+
+        if (parser.isSet(urlOption)) config.url = QUrl(parser.value(urlOption));
+        config.serverPath = parser.value(serverOption);
+        config.serverPid = parser.value(pidOption).toLongLong();
+        config.output = parser.value(outputOption);
+        if (parser.isSet(rateOption)) config.rate = parser.value(rateOption).toDouble();
+        if (parser.isSet(wireOption)) {
+            const QString wire = parser.value(wireOption);
+            if (wire != "json" && wire != "binary") {
+                CRITICAL() << "Invalid wire:" << wire;
+                return false;
+            }
+            config.binary = wire == "binary";
+        }
+
+        if (parser.isSet(mixOption)) {
+            const QStringList parts = parser.value(mixOption).split(':');
+            if (parts.size() != 3) {
+                CRITICAL() << "Invalid mix:" << parser.value(mixOption);
+                return false;
+            }
+            for (int i = 0; i < 3; ++i) config.mix[i] = qMax(0, parts[i].toInt());
+            if (config.mix[0] + config.mix[1] + config.mix[2] == 0) {
+                CRITICAL() << "Invalid mix:" << parser.value(mixOption);
+                return false;
+            }
+        }
+
+        return config.url.isValid() && config.rate > 0 &&
+            positive(clientsOption, config.clients) && positive(threadsOption, config.threads) &&
+            positive(concurrencyOption, config.connectConcurrency) && positive(durationOption, config.duration) &&
+            positive(sdpOption, config.sdpBytes) && positive(iceBatchOption, config.iceBatch);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("signaling-loadgen");
+
+    Config config;
+    if (!parseOptions(app, config)) {
+        return 2;
+    }
+    raiseFileLimit();
+
+    // Optional local server under test
+    QProcess server;
+    qint64 serverPid = config.serverPid;
+    if (!config.serverPath.isEmpty()) {
+        server.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        server.start(config.serverPath, { "--port", QString::number(config.url.port(11290)) });
+        if (!server.waitForStarted(5000)) {
+            CRITICAL() << "Cannot start" << config.serverPath << ":" << server.errorString();
+            return 1;
+        }
+        serverPid = server.processId();
+        QThread::msleep(300);  // let it bind
+    }
+    const qint64 rssBeforeKb = readRssKb(serverPid);
+
+    Counters counters;
+    std::vector<Shard*> shards;
+    std::vector<QThread*> threads;
+    for (int i = 0; i < config.threads; ++i) {
+        QThread* thread = new QThread(&app);
+        Shard* shard = new Shard(i, config, &counters);
+        shard->moveToThread(thread);
+        QObject::connect(thread, &QThread::finished, shard, &QObject::deleteLater);
+        thread->start();
+        shards.push_back(shard);
+        threads.push_back(thread);
+    }
+
+    // 1. Connect and register
+    QElapsedTimer phase;
+    phase.start();
+    for (int i = 0; i < config.threads; ++i) {
+        const int count = config.clients / config.threads + (i < config.clients % config.threads ? 1 : 0);
+        QMetaObject::invokeMethod(shards[i], [shard = shards[i], count]() { shard->openClients(count); }, Qt::QueuedConnection);
+    }
+    qint64 connectMs = -1;
+    waitUntil([&]() {
+        const int done = counters.connected.load() + counters.connectFailed.load();
+        if (connectMs < 0 && done >= config.clients) connectMs = phase.elapsed();
+        return done >= config.clients && counters.registered.load() >= counters.connected.load();
+    }, 120000);
+    if (connectMs < 0) connectMs = phase.elapsed();
+    const qint64 registerMs = phase.elapsed();
+    const int connected = counters.connected.load();
+    const int registered = counters.registered.load();
+
+    // Every REGISTER fans out PEER_JOINED to the peers before it: wait for that storm to pass
+    const qint64 expectedJoins = static_cast<qint64>(registered) * (registered - 1) / 2;
+    waitUntil([&]() { return counters.peerJoined.load() >= expectedJoins; }, 60000);
+    const qint64 fanoutMs = phase.elapsed();
+    const qint64 rssAfterKb = readRssKb(serverPid);
+
+    // 2. Traffic between random registered pairs
+    auto peers = std::make_shared<QStringList>();
+    for (Shard* shard : shards) {
+        QStringList ids;
+        QMetaObject::invokeMethod(shard, [shard, &ids]() { ids = shard->peerIds(); }, Qt::BlockingQueuedConnection);
+        peers->append(ids);
+    }
+    std::shared_ptr<const QStringList> sharedPeers = peers;
+    const qint64 cpuBeforeUs = readCpuUs(serverPid);
+    phase.restart();
+    for (Shard* shard : shards) {
+        QMetaObject::invokeMethod(shard, [shard, sharedPeers]() { shard->startTraffic(sharedPeers); }, Qt::QueuedConnection);
+    }
+    waitUntil([]() { return false; }, config.duration * 1000);
+    for (Shard* shard : shards) {
+        QMetaObject::invokeMethod(shard, [shard]() { shard->stopTraffic(); }, Qt::BlockingQueuedConnection);
+    }
+    const double trafficSeconds = phase.elapsed() / 1000.0;
+    waitUntil([]() { return false; }, 1000);  // in-flight messages
+    const qint64 cpuAfterUs = readCpuUs(serverPid);
+
+    ShardResult total;
+    for (Shard* shard : shards) {
+        ShardResult part;
+        QMetaObject::invokeMethod(shard, [shard, &part]() { part = shard->takeResult(); shard->closeAll(); }, Qt::BlockingQueuedConnection);
+        total.sent += part.sent;
+        total.received += part.received;
+        total.errors += part.errors;
+        total.disconnected += part.disconnected;
+        total.bytesSent += part.bytesSent;
+        total.bytesReceived += part.bytesReceived;
+        total.latencyUs.insert(total.latencyUs.end(), part.latencyUs.begin(), part.latencyUs.end());
+    }
+    std::sort(total.latencyUs.begin(), total.latencyUs.end());
+
+    for (QThread* thread : threads) {
+        thread->quit();
+        thread->wait();
+    }
+    if (server.state() != QProcess::NotRunning) {
+        server.terminate();  // SIGTERM: drains and exits
+        if (!server.waitForFinished(10000)) server.kill();
+    }
+
+    // 3. Report
+    QJsonObject cfg;
+    cfg.insert("url", config.url.toString());
+    cfg.insert("clients", config.clients);
+    cfg.insert("threads", config.threads);
+    cfg.insert("rate", config.rate);
+    cfg.insert("duration_s", config.duration);
+    cfg.insert("mix", QString("%1:%2:%3").arg(config.mix[0]).arg(config.mix[1]).arg(config.mix[2]));
+    cfg.insert("sdp_bytes", config.sdpBytes);
+    cfg.insert("wire", config.binary ? "binary" : "json");
+    cfg.insert("ice_batch", config.iceBatch);
+
+    QJsonObject connect;
+    connect.insert("connected", connected);
+    connect.insert("failed", counters.connectFailed.load());
+    connect.insert("seconds", connectMs / 1000.0);
+    connect.insert("per_second", connectMs > 0 ? connected * 1000.0 / connectMs : 0.0);
+    connect.insert("registered", registered);
+    connect.insert("register_seconds", registerMs / 1000.0);
+    connect.insert("peer_joined_seconds", fanoutMs / 1000.0);
+
+    QJsonObject latency;
+    latency.insert("samples", static_cast<qint64>(total.latencyUs.size()));
+    latency.insert("p50", percentile(total.latencyUs, 0.50));
+    latency.insert("p99", percentile(total.latencyUs, 0.99));
+    latency.insert("p999", percentile(total.latencyUs, 0.999));
+    latency.insert("max", total.latencyUs.empty() ? -1 : total.latencyUs.back());
+
+    QJsonObject traffic;
+    traffic.insert("sent", total.sent);
+    traffic.insert("received", total.received);
+    traffic.insert("errors", total.errors);
+    traffic.insert("disconnected", total.disconnected);
+    traffic.insert("seconds", trafficSeconds);
+    traffic.insert("sent_per_second", total.sent / trafficSeconds);
+    traffic.insert("received_per_second", total.received / trafficSeconds);
+    traffic.insert("bytes_sent", total.bytesSent);
+    traffic.insert("bytes_per_message_sent", total.sent > 0 ? static_cast<double>(total.bytesSent) / total.sent : 0.0);
+    traffic.insert("bytes_per_message_received", total.received > 0 ? static_cast<double>(total.bytesReceived) / total.received : 0.0);
+    // Includes the 1 s drain after the traffic phase, so it is a slight over-estimate
+    traffic.insert("server_cpu_us_per_message", cpuBeforeUs >= 0 && cpuAfterUs >= 0 && total.received > 0 ?
+        static_cast<double>(cpuAfterUs - cpuBeforeUs) / total.received : -1.0);
+    traffic.insert("latency_us", latency);
+
+    QJsonObject memory;
+    memory.insert("server_pid", serverPid);
+    memory.insert("rss_before_kb", rssBeforeKb);
+    memory.insert("rss_after_register_kb", rssAfterKb);
+    memory.insert("bytes_per_session", rssBeforeKb >= 0 && rssAfterKb >= 0 && registered > 0 ?
+        (rssAfterKb - rssBeforeKb) * 1024.0 / registered : -1.0);
+
+    QJsonObject result;
+    result.insert("config", cfg);
+    result.insert("connect", connect);
+    result.insert("traffic", traffic);
+    result.insert("memory", memory);
+    const QByteArray json = QJsonDocument(result).toJson(QJsonDocument::Indented);
+
+    if (config.output.isEmpty()) {
+        fwrite(json.constData(), 1, json.size(), stdout);
+    }
+    else {
+        QFile file(config.output);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+            CRITICAL() << "Cannot write" << config.output;
+            return 1;
+        }
+    }
+    return total.received > 0 ? 0 : 1;
+}
@@ -0,0 +1,223 @@
+// Headless signaling server: no Widgets, no display, starts listening immediately.
+//
+//   signaling-server-headless [--address <ip>] [--port <n>] [--workers <n>] [--io-threads <n>] [--log-file <path>]
+//                             [--metrics-port <n>]
+//
+// Every option can also come from the environment (SIGNALING_ADDRESS, SIGNALING_PORT,
+// SIGNALING_WORKERS, SIGNALING_IO_THREADS, SIGNALING_LOG_FILE, SIGNALING_METRICS_PORT); command line wins. 0 threads = pick from the core count.
+// All logs go through the AsyncLogger as JSON lines, to stderr unless a log file is given.
+// SIGTERM / SIGINT (Ctrl+C, service stop on Windows) stop accepting, drain the WorkerPool and exit.
+// Closing the console window or shutting down Windows drains too: the system ends the process
+// once the handler returns, so the handler waits for main to finish (Windows allows about 5 s
+// for a close, 20 s for a shutdown).
+#include "SignalingServer.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+#include <csignal>
+
+#ifdef Q_OS_WIN
+#include <Windows.h>
+#else
+#include <QSocketNotifier>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char* ENV_ADDRESS = "SIGNALING_ADDRESS";
+    const char* ENV_PORT = "SIGNALING_PORT";
+    const char* ENV_WORKERS = "SIGNALING_WORKERS";
+    const char* ENV_IO_THREADS = "SIGNALING_IO_THREADS";
+    const char* ENV_LOG_FILE = "SIGNALING_LOG_FILE";
+    const char* ENV_METRICS_PORT = "SIGNALING_METRICS_PORT";
+
+    struct Options {
+        QHostAddress address = QHostAddress::Any;
+        quint16 port = 11290;
+        int workers = DEFAULT_WORKER_NUMBER;
+        int ioThreads = DEFAULT_IO_THREAD_NUMBER;
+        QString logFile;
+        quint16 metricsPort = 0;  ///< 0 = no metrics listener
+    };
+
+    // Command line value if set, otherwise the environment variable, otherwise empty
+    QString optionValue(const QCommandLineParser& parser, const QCommandLineOption& option, const char* env)
+    {
+        if (parser.isSet(option)) return parser.value(option);
+        return qEnvironmentVariable(env);
+    }
+
+    bool parsePort(const QString& text, const char* name, bool allowZero, quint16& out)
+    {
+        if (text.isEmpty()) return true;
+        bool ok = false;
+        const uint value = text.toUInt(&ok);
+        if (!ok || (value == 0 && !allowZero) || value > 65535) {
+            CRITICAL() << "Invalid" << name << ":" << text;
+            return false;
+        }
+        out = static_cast<quint16>(value);
+        return true;
+    }
+
+    bool parseCount(const QString& text, const char* name, int& out)
+    {
+        if (text.isEmpty()) return true;
+        bool ok = false;
+        const int value = text.toInt(&ok);
+        if (!ok || value < 0) {
+            CRITICAL() << "Invalid" << name << ":" << text;
+            return false;
+        }
+        out = value;
+        return true;
+    }
+
+    bool parseOptions(const QCoreApplication& app, Options& options)
+    {
+        QCommandLineParser parser;
+        parser.setApplicationDescription("Headless WebRTC signaling server");
+        parser.addHelpOption();
+
+        const QCommandLineOption addressOption("address", "Bind address (env SIGNALING_ADDRESS, default any).", "ip");
+        const QCommandLineOption portOption("port", "Listen port (env SIGNALING_PORT, default 11290).", "port");
+        const QCommandLineOption workersOption("workers", "Worker threads, 0 = one per core (env SIGNALING_WORKERS).", "n");
+        const QCommandLineOption ioOption("io-threads", "I/O threads, 0 = half the cores (env SIGNALING_IO_THREADS).", "n");
+        const QCommandLineOption logOption("log-file", "Append JSON-lines logs to this file instead of stderr (env SIGNALING_LOG_FILE).", "path");
+        const QCommandLineOption metricsOption("metrics-port", "Serve GET /metrics on this port, 0 = off (env SIGNALING_METRICS_PORT).", "port");
+        parser.addOptions({ addressOption, portOption, workersOption, ioOption, logOption, metricsOption });
+        parser.process(app);
+
+        options.logFile = optionValue(parser, logOption, ENV_LOG_FILE);
+        if (!options.logFile.isEmpty() && !AsyncLogger::instance().setSink(options.logFile)) {
+            CRITICAL() << "Cannot open log file:" << options.logFile;
+            return false;
+        }
+
+        const QString address = optionValue(parser, addressOption, ENV_ADDRESS);
+        if (!address.isEmpty() && !options.address.setAddress(address)) {
+            CRITICAL() << "Invalid address:" << address;
+            return false;
+        }
+
+        return parsePort(optionValue(parser, portOption, ENV_PORT), "port", false, options.port) &&
+            parsePort(optionValue(parser, metricsOption, ENV_METRICS_PORT), "metrics port", true, options.metricsPort) &&
+            parseCount(optionValue(parser, workersOption, ENV_WORKERS), "worker count", options.workers) &&
+            parseCount(optionValue(parser, ioOption, ENV_IO_THREADS), "I/O thread count", options.ioThreads);
+    }
+
+#ifdef Q_OS_WIN
+    HANDLE g_shutdownDone = nullptr;   ///< Set by main once the server is drained and the log flushed
+
+    BOOL WINAPI onConsoleEvent(DWORD type)
+    {
+        switch (type) {
+        case CTRL_C_EVENT:
+        case CTRL_BREAK_EVENT:
+            // Runs on a system thread; a queued call is safe from there
+            QMetaObject::invokeMethod(QCoreApplication::instance(), &QCoreApplication::quit, Qt::QueuedConnection);
+            return TRUE;
+        case CTRL_CLOSE_EVENT:
+        case CTRL_SHUTDOWN_EVENT:
+            // The process is terminated as soon as this returns: hold it until main is done
+            QMetaObject::invokeMethod(QCoreApplication::instance(), &QCoreApplication::quit, Qt::QueuedConnection);
+            if (g_shutdownDone != nullptr) {
+                WaitForSingleObject(g_shutdownDone, INFINITE);
+            }
+            return TRUE;
+        default:
+            return FALSE;
+        }
+    }
+
+    void installShutdownHandler(QCoreApplication&)
+    {
+        g_shutdownDone = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        SetConsoleCtrlHandler(onConsoleEvent, TRUE);
+    }
+
+    void signalShutdownDone()
+    {
+        if (g_shutdownDone != nullptr) {
+            SetEvent(g_shutdownDone);
+        }
+    }
+#else
+    int g_signalFds[2] = { -1, -1 };
+
+    // Only async-signal-safe work here: wake the event loop through the socket pair
+    void onSignal(int)
+    {
+        const char byte = 1;
+        const ssize_t written = ::write(g_signalFds[0], &byte, sizeof(byte));
+        (void)written;
+    }
+
+    void installShutdownHandler(QCoreApplication& app)
+    {
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, g_signalFds) != 0) {
+            WARNING() << "socketpair failed, SIGTERM will not drain the server";
+            return;
+        }
+        QSocketNotifier* notifier = new QSocketNotifier(g_signalFds[1], QSocketNotifier::Read, &app);
+        QObject::connect(notifier, &QSocketNotifier::activated, &app, [notifier]() {
+            notifier->setEnabled(false);
+            char byte = 0;
+            const ssize_t got = ::read(g_signalFds[1], &byte, sizeof(byte));
+            (void)got;
+            QCoreApplication::quit();
+        });
+
+        struct sigaction action = {};
+        action.sa_handler = onSignal;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGTERM, &action, nullptr);
+        sigaction(SIGINT, &action, nullptr);
+        std::signal(SIGPIPE, SIG_IGN);
+    }
+
+    // Nothing waits for main here: the signal handler returns right away
+    void signalShutdownDone()
+    {
+    }
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("signaling-server-headless");
+    AsyncLogger::instance().installQtMessageHandler();
+
+    Options options;
+    if (!parseOptions(app, options)) {
+        return 2;
+    }
+    installShutdownHandler(app);
+
+    SignalingServer* server = SignalingServer::getInstance(options.address, options.port, options.workers, options.ioThreads);
+    if (!server->start(options.address, options.port)) {
+        return 1;
+    }
+    if (options.metricsPort != 0 && !server->startMetrics(options.address, options.metricsPort)) {
+        server->shutdown();
+        return 1;
+    }
+    INFO() << "Workers:" << server->workerCount() << "I/O threads:" << server->ioThreadCount();
+
+    const int code = app.exec();
+
+    INFO() << "Shutting down, draining queued tasks";
+    server->shutdown();
+    INFO() << "Signaling Server stopped";
+    if (AsyncLogger::instance().dropped() > 0) {
+        WARNING() << "Log events dropped:" << AsyncLogger::instance().dropped();
+    }
+    AsyncLogger::instance().stop();
+    signalShutdownDone();
+    return code;
+}
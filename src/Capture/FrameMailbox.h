@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QMutex>
+#include <QVideoFrame>
+#include <atomic>
+
+// Single-slot "latest frame wins" mailbox between the capture thread and the encode thread.
+// put() never blocks the producer: a newer frame overwrites one the encoder has not picked
+// up yet, and the overwritten frame is counted as dropped instead of being queued.
+class FrameMailbox
+{
+public:
+    // Stores the frame. Returns true if the slot was empty, i.e. the consumer has to be woken up;
+    // false means a wake-up is already pending and the stale frame was replaced.
+    bool put(const QVideoFrame& frame)
+    {
+        m_captured.fetch_add(1, std::memory_order_relaxed);
+
+        QMutexLocker guard(&m_mutex);
+        const bool wasEmpty = !m_hasFrame;
+        if (!wasEmpty) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        m_frame = frame; // QVideoFrame is implicitly shared, no pixel copy here
+        m_hasFrame = true;
+        return wasEmpty;
+    }
+
+    // Takes the latest frame out of the slot. Returns false if the slot is empty.
+    bool take(QVideoFrame& frame)
+    {
+        QMutexLocker guard(&m_mutex);
+        if (!m_hasFrame) return false;
+        frame = std::move(m_frame);
+        m_frame = QVideoFrame();
+        m_hasFrame = false;
+        return true;
+    }
+
+    // Drops a pending frame without counting it (used when capture stops).
+    void clear()
+    {
+        QMutexLocker guard(&m_mutex);
+        m_frame = QVideoFrame();
+        m_hasFrame = false;
+    }
+
+    quint64 captured() const { return m_captured.load(std::memory_order_relaxed); }
+    quint64 dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    QMutex m_mutex;
+    QVideoFrame m_frame;
+    bool m_hasFrame = false;
+
+    std::atomic<quint64> m_captured{ 0 }; // frames delivered by QVideoSink
+    std::atomic<quint64> m_dropped{ 0 };  // frames overwritten before the encoder got to them
+};
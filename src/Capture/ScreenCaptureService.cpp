@@ -16,6 +16,14 @@ ScreenCaptureService::~ScreenCaptureService()
     stopCapture();
     // Qt Ķ(parent)Զڴ棬
     // Ϊ˱գֶֹͣһ¸
+
+    // û parentmoveToThread Ҫ󣩣߳˳ֶͷ
+    if (m_encodeThread) {
+        m_encodeThread->quit();
+        m_encodeThread->wait();
+    }
+    delete m_encoder;
+    m_encoder = nullptr;
 }
 
 void ScreenCaptureService::init()
@@ -37,35 +45,90 @@ void ScreenCaptureService::init()
     m_session->setVideoOutput(m_videoSink); // ᵼ½ڣ
 
     // źţÿĻˢ£frameChanged 
+    //  GUI ֻ̣߳֡Ž䣬κα빤
+    m_captureClock.start();
     connect(m_videoSink, &QVideoSink::videoFrameChanged, this, [this](const QVideoFrame& frame) {
         if (m_encoder && frame.isValid()) {
-            // һ֡
-            m_encoder->encode(frame);
+            // ڲɼ̴߳ϲɼʱ̣ݴ RTP ʱܱŶӰ
+            QVideoFrame stamped = frame;
+            if (stamped.startTime() < 0) {
+                stamped.setStartTime(m_captureClock.nsecsElapsed() / 1000);
+            }
+
+            // ԭΪղҪѱ̣߳֡ǣлŶ
+            if (m_mailbox.put(stamped)) {
+                QMetaObject::invokeMethod(m_encoder, [this]() { encodePendingFrame(); },
+                    Qt::QueuedConnection);
+            }
         }
     });
 }
 
+void ScreenCaptureService::encodePendingFrame()
+{
+    QVideoFrame frame;
+    if (!m_mailbox.take(frame)) return;
+
+    if (m_encoder->encode(frame)) {
+        m_framesEncoded.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void ScreenCaptureService::setVideoTarget(int width, int height, int fps, int bitrate)
+{
+    m_targetWidth = width;
+    m_targetHeight = height;
+    m_targetFps = fps;
+    m_targetBitrate = bitrate;
+
+    if (m_encoder) {
+        QMetaObject::invokeMethod(m_encoder, [this, width, height, fps, bitrate]() {
+            if (!m_encoder->reconfigure(width, height, fps, bitrate)) {
+                qDebug() << "Encoder reconfigure to" << width << "x" << height << "failed";
+            }
+            }, Qt::QueuedConnection);
+    }
+}
+
+void ScreenCaptureService::requestKeyframe()
+{
+    if (m_encoder) {
+        QMetaObject::invokeMethod(m_encoder, [this]() { m_encoder->requestKeyframe(); }, Qt::QueuedConnection);
+    }
+}
+
 void ScreenCaptureService::startCapture()
 {   
     if (!m_encoder) {
-        m_encoder = new VideoEncoder(this);
+        // ܴ parent޷ moveToThread
+        m_encoder = new VideoEncoder();
         // ˴÷ֱʣ1920 * 1080 30fps 3Mbps
         // ҪͷֱʶӦã
-        if (m_encoder->init(640, 360, 15, 1000000)) {
+        if (m_encoder->init(m_targetWidth, m_targetHeight, m_targetFps, m_targetBitrate)) {
             qDebug() << "Video Encoder Initialized!";
         }
         else {
             qDebug() << "Encoder Init Failed!";
+            delete m_encoder;
+            m_encoder = nullptr;
             return;
         }
 
         // 3. Encoder -> Sender
-        m_encoder->onEncodedData = [this](const std::vector<uint8_t>& data, uint32_t ts) {
-            QByteArray qData(reinterpret_cast<const char*>(data.data()), data.size());
+        // صڱִ߳УźŻŶӷʽͶݵ߳
+        // ֡Annex-BͶݣÿֻ֡䡢һΣͶٰз NAL
+        m_encoder->onEncodedFrame = [this](const uint8_t* data, size_t size, uint32_t ts) {
+            // ߳ͶҪڴ棬 AVPacket Ψһһο
+            QByteArray qData(reinterpret_cast<const char*>(data), static_cast<int>(size));
             emit encodedFrameReady(qData, ts);
             // qDebug() << "Captured data is :" << data <<"\n";
             // stopCapture();
             };
+
+        m_encodeThread = new QThread(this);
+        m_encodeThread->setObjectName("VideoEncodeThread");
+        m_encoder->moveToThread(m_encodeThread);
+        m_encodeThread->start();
     }
 
     // û׼ãӡ
@@ -84,11 +147,25 @@ void ScreenCaptureService::stopCapture()
 {
     if (m_screenCapture) {
         m_screenCapture->stop();
-        qDebug() << "Screen Capture Stopped!";
+        m_mailbox.clear();
+        const CaptureStats s = stats();
+        qDebug() << "Screen Capture Stopped! captured:" << s.framesCaptured
+                 << "dropped:" << s.framesDropped << "encoded:" << s.framesEncoded
+                 << "unchanged:" << s.framesUnchanged;
         emit captureStateChanged(false);
     }
 }
 
+CaptureStats ScreenCaptureService::stats() const
+{
+    CaptureStats s;
+    s.framesCaptured = m_mailbox.captured();
+    s.framesDropped = m_mailbox.dropped();
+    s.framesEncoded = m_framesEncoded.load(std::memory_order_relaxed);
+    s.framesUnchanged = m_encoder ? m_encoder->framesUnchanged() : 0;
+    return s;
+}
+
 // void ScreenCaptureService::initEncoder()
 // {
 //     // qDebug() << "Initializing Encoder for Target:" << targetIp;
@@ -5,12 +5,25 @@
 #include <QMediaCaptureSession>
 #include <QScreenCapture>
 #include <QVideoWidget>
+#include <QThread>
+#include <QElapsedTimer>
+#include <atomic>
 #include <memory>  // for std::unique_ptr
 #include "../encoder/VideoEncoder.h"
+#include "FrameMailbox.h"
 // #include "../network/RtcRtpSender.h" 
 
 class RtcRtpSender;
 
+// ɼ/ˮ߼ڹ۲߳
+struct CaptureStats
+{
+    quint64 framesCaptured = 0; // QVideoSink ֡
+    quint64 framesDropped = 0;  // ߳֡ǵ֡
+    quint64 framesEncoded = 0;  // ʵ֡Ŀ֡ʱĲ㣩
+    quint64 framesUnchanged = 0; // ûб仯 sws_scale ֡
+};
+
 // ̳ QObject ΪʹźŲۻ
 class ScreenCaptureService : public QObject
 {
@@ -31,21 +44,44 @@ public:
     // UIָ
     QVideoWidget* getVideoPreviewWidget();
 
+    // ̰߳ȫ̵߳
+    CaptureStats stats() const;
+
+public slots:
+    // ABR Ŀ꣺ͣɼתִ߳УûʱΪʼ
+    void setVideoTarget(int width, int height, int fps, int bitrate);
+    // The receiver sent a PLI: the next encoded frame is an IDR
+    void requestKeyframe();
+
 signals:
     // 磺״̬ (ѡ)
     void captureStateChanged(bool isRunning);
 
     void videoDataReady(const QByteArray& data, uint32_t timestamp);
+    // һı֡Annex-Bʼ룩timestamp Ϊ 90kHz RTP ʱ
     void encodedFrameReady(const QByteArray& encodedData, uint32_t timestamp);
 
 private:
     void init();
 
+    // ڱִ߳Уȡµһ֡
+    void encodePendingFrame();
+
     QMediaCaptureSession* m_session = nullptr;
     QScreenCapture* m_screenCapture = nullptr;
     QVideoWidget* m_previewWidget = nullptr; // һԤС
     QVideoSink* m_videoSink = nullptr; // ȡ֡
-    VideoEncoder* m_encoder = nullptr; // ѹ֡
+    VideoEncoder* m_encoder = nullptr; // ѹ֡ m_encodeThread 
+    QThread* m_encodeThread = nullptr; // ̣߳֡ס GUI ߳
+    FrameMailbox m_mailbox;            // ɼ ->  ĵ䣬֡Ǿ֡
+    std::atomic<quint64> m_framesEncoded{ 0 };
+    QElapsedTimer m_captureClock;      // ֡û startTime ʱڱǲɼʱ
+
+    // Ŀ꣨GUI ̶߳дֻ߳ͨ reconfigure õ
+    int m_targetWidth = 640;
+    int m_targetHeight = 360;
+    int m_targetFps = 15;
+    int m_targetBitrate = 1000000;
 
     // WebRTC RTP 
     // ʹָ (unique_ptr) ڴ棬ֶ delete
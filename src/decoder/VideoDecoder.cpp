@@ -0,0 +1,135 @@
+#include "VideoDecoder.h"
+#include <QDebug>
+#include <cstring>
+
+namespace
+{
+    void copyPlane(uchar* dst, int dstStride, const uint8_t* src, int srcStride, int bytesPerLine, int lines)
+    {
+        if (dstStride == srcStride) {
+            std::memcpy(dst, src, static_cast<size_t>(srcStride) * lines);
+            return;
+        }
+        for (int y = 0; y < lines; y++) {
+            std::memcpy(dst + static_cast<size_t>(y) * dstStride, src + static_cast<size_t>(y) * srcStride, bytesPerLine);
+        }
+    }
+}
+
+VideoDecoder::VideoDecoder()
+{
+    m_pkt = av_packet_alloc();
+    m_picture = av_frame_alloc();
+}
+
+VideoDecoder::~VideoDecoder()
+{
+    cleanup();
+    av_frame_free(&m_picture);
+    av_packet_free(&m_pkt);
+}
+
+bool VideoDecoder::init()
+{
+    cleanup();
+
+    const AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_H264);
+    if (!codec) {
+        qDebug() << "H.264 Decoder not found!";
+        return false;
+    }
+
+    m_codecCtx = avcodec_alloc_context3(codec);
+    // Output every picture as soon as it is decoded: no B-frames are sent, so no reordering delay
+    m_codecCtx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    // Frame threading buffers one frame per thread; slice threading adds no latency
+    m_codecCtx->thread_type = FF_THREAD_SLICE;
+    m_codecCtx->thread_count = 0;
+
+    if (avcodec_open2(m_codecCtx, codec, nullptr) < 0) {
+        qDebug() << "Could not open decoder";
+        avcodec_free_context(&m_codecCtx);
+        return false;
+    }
+    return true;
+}
+
+bool VideoDecoder::decode(const uint8_t* data, size_t size, QVideoFrame& frame)
+{
+    if (!m_codecCtx || !data || size == 0) return false;
+
+    // The packet only borrows the access unit; avcodec copies what it needs to keep
+    m_pkt->data = const_cast<uint8_t*>(data);
+    m_pkt->size = static_cast<int>(size);
+    const int sent = avcodec_send_packet(m_codecCtx, m_pkt);
+    av_packet_unref(m_pkt);
+    if (sent < 0 && sent != AVERROR(EAGAIN)) {
+        return false;
+    }
+
+    bool produced = false;
+    while (avcodec_receive_frame(m_codecCtx, m_picture) == 0) {
+        // With LOW_DELAY there is at most one picture per access unit; keep the newest
+        produced = toVideoFrame(m_picture, frame) || produced;
+        av_frame_unref(m_picture);
+    }
+    return produced;
+}
+
+void VideoDecoder::flush()
+{
+    if (m_codecCtx) avcodec_flush_buffers(m_codecCtx);
+}
+
+bool VideoDecoder::toVideoFrame(const AVFrame* picture, QVideoFrame& frame)
+{
+    const AVFrame* yuv = picture;
+
+    if (picture->format != AV_PIX_FMT_YUV420P && picture->format != AV_PIX_FMT_YUVJ420P) {
+        if (!m_converted || m_converted->width != picture->width || m_converted->height != picture->height) {
+            av_frame_free(&m_converted);
+            m_converted = av_frame_alloc();
+            m_converted->format = AV_PIX_FMT_YUV420P;
+            m_converted->width = picture->width;
+            m_converted->height = picture->height;
+            if (av_frame_get_buffer(m_converted, 32) < 0) {
+                av_frame_free(&m_converted);
+                return false;
+            }
+        }
+        m_swsCtx = sws_getCachedContext(m_swsCtx,
+            picture->width, picture->height, static_cast<AVPixelFormat>(picture->format),
+            picture->width, picture->height, AV_PIX_FMT_YUV420P,
+            SWS_BILINEAR, nullptr, nullptr, nullptr);
+        if (!m_swsCtx) return false;
+        sws_scale(m_swsCtx, picture->data, picture->linesize, 0, picture->height,
+            m_converted->data, m_converted->linesize);
+        yuv = m_converted;
+    }
+
+    QVideoFrame out(QVideoFrameFormat(QSize(yuv->width, yuv->height), QVideoFrameFormat::Format_YUV420P));
+    if (!out.map(QVideoFrame::WriteOnly)) {
+        qDebug() << "Map decoded frame failed";
+        return false;
+    }
+
+    const int chromaW = (yuv->width + 1) / 2;
+    const int chromaH = (yuv->height + 1) / 2;
+    copyPlane(out.bits(0), out.bytesPerLine(0), yuv->data[0], yuv->linesize[0], yuv->width, yuv->height);
+    copyPlane(out.bits(1), out.bytesPerLine(1), yuv->data[1], yuv->linesize[1], chromaW, chromaH);
+    copyPlane(out.bits(2), out.bytesPerLine(2), yuv->data[2], yuv->linesize[2], chromaW, chromaH);
+    out.unmap();
+
+    frame = out;
+    return true;
+}
+
+void VideoDecoder::cleanup()
+{
+    if (m_codecCtx) avcodec_free_context(&m_codecCtx);
+    if (m_swsCtx) {
+        sws_freeContext(m_swsCtx);
+        m_swsCtx = nullptr;
+    }
+    av_frame_free(&m_converted);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <QVideoFrame>
+#include <cstddef>
+#include <cstdint>
+
+// FFmpeg is a C library
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+#include <libavutil/imgutils.h>
+}
+
+// H.264 decoder for one incoming stream. Feeds Annex-B access units to avcodec and hands the
+// pictures back as YUV420P QVideoFrames. Lives on the decode thread, not thread-safe.
+class VideoDecoder
+{
+public:
+    VideoDecoder();
+    ~VideoDecoder();
+
+    VideoDecoder(const VideoDecoder&) = delete;
+    VideoDecoder& operator=(const VideoDecoder&) = delete;
+
+    bool init();
+
+    // Decodes one access unit. Returns false if the decoder produced no picture for it
+    // (not initialised, corrupt data, or the frame is still referenced internally).
+    bool decode(const uint8_t* data, size_t size, QVideoFrame& frame);
+
+    // Drops buffered reference pictures, e.g. after a loss when waiting for the next keyframe
+    void flush();
+
+private:
+    void cleanup();
+    bool toVideoFrame(const AVFrame* picture, QVideoFrame& frame);
+
+    AVCodecContext* m_codecCtx = nullptr;
+    AVPacket* m_pkt = nullptr;
+    AVFrame* m_picture = nullptr;
+
+    // Only used when the stream is not already YUV420P
+    SwsContext* m_swsCtx = nullptr;
+    AVFrame* m_converted = nullptr;
+};
@@ -0,0 +1,219 @@
+#include "DamageTracker.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DAMAGE_TRACKER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+    const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+    const uint32_t PRIME32_1 = 0x9E3779B1U;
+
+    const int CHUNK_BYTES = 16;
+    const int TILE_ROW_BYTES = DamageTracker::TILE_SIZE * 4;
+    const int TILE_CHUNKS = TILE_ROW_BYTES / CHUNK_BYTES;
+
+    uint64_t avalanche(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= PRIME64_2;
+        h ^= h >> 29;
+        h *= PRIME64_1;
+        h ^= h >> 32;
+        return h;
+    }
+
+    // Per-position keys, so swapping two chunks of a row changes the hash
+    struct Keys
+    {
+        uint64_t words[TILE_CHUNKS * 2 + 2];
+
+        Keys()
+        {
+            uint64_t x = PRIME64_1;
+            for (uint64_t& w : words) {
+                x += PRIME64_1; // splitmix64
+                w = avalanche(x);
+            }
+        }
+    };
+
+    const Keys& keys()
+    {
+        static const Keys k;
+        return k;
+    }
+
+#ifdef DAMAGE_TRACKER_SSE2
+    // XXH3-style accumulate/scramble on two 64-bit lanes, one row of the tile at a time
+    inline __m128i accumulate(__m128i acc, __m128i data, __m128i key)
+    {
+        const __m128i dataKey = _mm_xor_si128(data, key);
+        const __m128i product = _mm_mul_epu32(dataKey, _mm_shuffle_epi32(dataKey, 0x31));
+        return _mm_add_epi64(_mm_add_epi64(acc, _mm_shuffle_epi32(data, 0x4E)), product);
+    }
+
+    inline __m128i scramble(__m128i acc, __m128i key)
+    {
+        const __m128i prime = _mm_set1_epi32(static_cast<int>(PRIME32_1));
+        acc = _mm_xor_si128(_mm_xor_si128(acc, _mm_srli_epi64(acc, 47)), key);
+        const __m128i lo = _mm_mul_epu32(acc, prime);
+        const __m128i hi = _mm_mul_epu32(_mm_srli_epi64(acc, 32), prime);
+        return _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+    }
+
+    uint64_t hashTile(const uint8_t* p, int rowBytes, int rows, int stride)
+    {
+        const uint64_t* k = keys().words;
+        const __m128i* key = reinterpret_cast<const __m128i*>(k);
+        const __m128i rowKey = _mm_loadu_si128(key + TILE_CHUNKS);
+
+        __m128i acc = _mm_set_epi64x(static_cast<long long>(PRIME64_2), static_cast<long long>(PRIME64_1));
+        const int fullChunks = rowBytes / CHUNK_BYTES;
+        const int tail = rowBytes % CHUNK_BYTES;
+
+        for (int y = 0; y < rows; ++y, p += stride) {
+            int c = 0;
+            for (; c < fullChunks; ++c) {
+                const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + c * CHUNK_BYTES));
+                acc = accumulate(acc, data, _mm_loadu_si128(key + c));
+            }
+            if (tail) { // right edge tile narrower than 4-pixel multiples of 16 bytes
+                uint8_t last[CHUNK_BYTES] = {};
+                std::memcpy(last, p + c * CHUNK_BYTES, tail);
+                acc = accumulate(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(last)), _mm_loadu_si128(key + c));
+            }
+            acc = scramble(acc, rowKey);
+        }
+
+        uint64_t lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        return avalanche(lanes[0] ^ (lanes[1] * PRIME64_1) ^ static_cast<uint64_t>(rowBytes) ^
+            (static_cast<uint64_t>(rows) << 32));
+    }
+#else
+    uint64_t hashTile(const uint8_t* p, int rowBytes, int rows, int stride)
+    {
+        const uint64_t* k = keys().words;
+        uint64_t h = PRIME64_2 ^ static_cast<uint64_t>(rowBytes) ^ (static_cast<uint64_t>(rows) << 32);
+
+        for (int y = 0; y < rows; ++y, p += stride) {
+            int i = 0;
+            for (; i + 8 <= rowBytes; i += 8) {
+                uint64_t w;
+                std::memcpy(&w, p + i, sizeof(w));
+                h ^= w ^ k[i / 8];
+                h = ((h << 31) | (h >> 33)) * PRIME64_1;
+            }
+            if (i < rowBytes) { // packed 32-bit pixels: at most one 4-byte pixel left
+                uint32_t w;
+                std::memcpy(&w, p + i, sizeof(w));
+                h ^= w ^ k[i / 8];
+                h = ((h << 31) | (h >> 33)) * PRIME64_1;
+            }
+            h = (h ^ (h >> 29)) * PRIME64_2;
+        }
+        return avalanche(h);
+    }
+#endif
+}
+
+size_t DamageTracker::update(const uint8_t* pixels, int width, int height, int stride)
+{
+    if (width != m_width || height != m_height) {
+        m_width = width;
+        m_height = height;
+        m_tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        m_tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+        m_hashes.assign(static_cast<size_t>(m_tilesX) * m_tilesY, 0);
+        m_dirty.assign(m_hashes.size(), 1);
+    }
+    else {
+        std::fill(m_dirty.begin(), m_dirty.end(), 0);
+    }
+
+    size_t damaged = 0;
+    for (int ty = 0; ty < m_tilesY; ++ty) {
+        const int y = ty * TILE_SIZE;
+        const int rows = std::min(TILE_SIZE, height - y);
+        for (int tx = 0; tx < m_tilesX; ++tx) {
+            const int x = tx * TILE_SIZE;
+            const int rowBytes = std::min(TILE_SIZE, width - x) * 4;
+            const uint64_t h = hashTile(pixels + static_cast<size_t>(y) * stride + x * 4, rowBytes, rows, stride);
+
+            const size_t index = static_cast<size_t>(ty) * m_tilesX + tx;
+            if (m_dirty[index] || m_hashes[index] != h) {
+                m_hashes[index] = h;
+                m_dirty[index] = 1;
+                ++damaged;
+            }
+        }
+    }
+
+    buildDamage(m_dirty);
+    return damaged;
+}
+
+void DamageTracker::buildDamage(const std::vector<uint8_t>& dirty)
+{
+    m_damage.clear();
+    size_t openBegin = 0; // rects that ended on the previous tile row and may grow downwards
+
+    for (int ty = 0; ty < m_tilesY; ++ty) {
+        const size_t rowBegin = m_damage.size();
+        const int y = ty * TILE_SIZE;
+
+        int tx = 0;
+        while (tx < m_tilesX) {
+            if (!dirty[static_cast<size_t>(ty) * m_tilesX + tx]) {
+                ++tx;
+                continue;
+            }
+            const int runBegin = tx;
+            while (tx < m_tilesX && dirty[static_cast<size_t>(ty) * m_tilesX + tx]) ++tx;
+
+            Rect run;
+            run.x = runBegin * TILE_SIZE;
+            run.y = y;
+            run.width = std::min(tx * TILE_SIZE, m_width) - run.x;
+            run.height = std::min(TILE_SIZE, m_height - y);
+
+            // Same horizontal span as a rect directly above: extend it instead of starting a new one
+            bool merged = false;
+            for (size_t i = openBegin; i < rowBegin; ++i) {
+                Rect& above = m_damage[i];
+                if (above.x == run.x && above.width == run.width && above.y + above.height == run.y) {
+                    above.height += run.height;
+                    merged = true;
+                    break;
+                }
+            }
+            if (!merged) m_damage.push_back(run);
+        }
+
+        // Rects extended on this row must stay open, so keep the whole range from the first one
+        size_t nextOpen = m_damage.size();
+        for (size_t i = openBegin; i < m_damage.size(); ++i) {
+            if (m_damage[i].y + m_damage[i].height == y + std::min(TILE_SIZE, m_height - y)) {
+                nextOpen = i;
+                break;
+            }
+        }
+        openBegin = nextOpen;
+    }
+}
+
+void DamageTracker::reset()
+{
+    m_width = 0;
+    m_height = 0;
+    m_tilesX = 0;
+    m_tilesY = 0;
+    m_hashes.clear();
+    m_dirty.clear();
+    m_damage.clear();
+}
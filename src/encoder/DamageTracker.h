@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Tile-hash damage detection for captured screen frames.
+//
+// The frame is split into TILE_SIZE x TILE_SIZE tiles and every tile is hashed (SSE2 on x86/x64,
+// 64-bit scalar elsewhere). A tile whose hash differs from the previous update() is damaged.
+// Only the hashes are kept, not the previous picture, so memory is a few KB even at 4K.
+//
+// Not thread-safe; meant to live next to the encoder on the encode thread.
+class DamageTracker
+{
+public:
+    static constexpr int TILE_SIZE = 64;
+
+    // A damaged region in source pixels, aligned to tiles and clipped to the frame.
+    struct Rect
+    {
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    // Hashes a packed 32-bit (BGRA/RGBA) image and compares it with the previous one.
+    // Returns the number of damaged tiles. The first frame, or a frame of a different size,
+    // is damaged everywhere.
+    size_t update(const uint8_t* pixels, int width, int height, int stride);
+
+    // Damaged regions of the last update(): runs of damaged tiles merged into rectangles.
+    const std::vector<Rect>& damage() const { return m_damage; }
+
+    size_t tileCount() const { return m_hashes.size(); }
+
+    // Forgets the previous frame, the next update() reports everything as damaged.
+    void reset();
+
+private:
+    void buildDamage(const std::vector<uint8_t>& dirty);
+
+    int m_width = 0;
+    int m_height = 0;
+    int m_tilesX = 0;
+    int m_tilesY = 0;
+    std::vector<uint64_t> m_hashes;  // row-major, one per tile
+    std::vector<uint8_t> m_dirty;
+    std::vector<Rect> m_damage;
+};
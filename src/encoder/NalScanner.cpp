@@ -0,0 +1,63 @@
+#include "NalScanner.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NAL_SCANNER_SSE2 1
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace
+{
+#ifdef NAL_SCANNER_SSE2
+    inline int lowestBit(unsigned mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long idx;
+        _BitScanForward(&idx, mask);
+        return static_cast<int>(idx);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+#endif
+}
+
+const uint8_t* NalScanner::findStartCode(const uint8_t* begin, const uint8_t* end)
+{
+    const uint8_t* p = begin;
+    if (end - p < 3) return end;
+
+#ifdef NAL_SCANNER_SSE2
+    // Test 16 candidate positions at once: p[i] == 0 && p[i+1] == 0 && p[i+2] == 1
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    while (end - p >= 18) {
+        const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        const __m128i b2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2));
+        const __m128i hit = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)),
+            _mm_cmpeq_epi8(b2, one));
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+        if (mask) return p + lowestBit(mask);
+        p += 16;
+    }
+    for (; end - p >= 3; ++p) {
+        if (p[2] == 1 && p[1] == 0 && p[0] == 0) return p;
+    }
+    return end;
+#else
+    // memchr is vectorized by every mainstream libc: jump from 0x01 to 0x01
+    // and only then look back for the two zero bytes
+    while (end - p >= 3) {
+        const void* hit = std::memchr(p + 2, 1, static_cast<size_t>(end - (p + 2)));
+        if (!hit) return end;
+        const uint8_t* q = static_cast<const uint8_t*>(hit);
+        if (q[-1] == 0 && q[-2] == 0) return q - 2;
+        p = q - 1;
+    }
+    return end;
+#endif
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// A non-owning view of one H.264 NAL unit (start code stripped) inside a caller-owned buffer,
+// e.g. AVPacket::data. Only valid as long as that buffer is alive and unmodified.
+struct NalUnit
+{
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    uint8_t header() const { return data[0]; }
+    uint8_t type() const { return data[0] & 0x1F; }
+};
+
+// Annex-B start-code scanner. Uses SSE2 on x86/x64 and a memchr-based scan elsewhere;
+// neither path allocates.
+namespace NalScanner
+{
+    // Returns a pointer to the first byte of the next "00 00 01" in [begin, end), or end.
+    // A 4-byte start code "00 00 00 01" is found one byte late; split() trims that zero.
+    const uint8_t* findStartCode(const uint8_t* begin, const uint8_t* end);
+
+    // Calls fn(const NalUnit&) for every NAL unit in an Annex-B buffer and returns how many
+    // were found. Leading bytes before the first start code are ignored.
+    template<class Fn>
+    size_t split(const uint8_t* data, size_t size, Fn&& fn)
+    {
+        const uint8_t* end = data + size;
+        const uint8_t* sc = findStartCode(data, end);
+        size_t count = 0;
+
+        while (sc != end) {
+            const uint8_t* nalBegin = sc + 3;
+            const uint8_t* next = findStartCode(nalBegin, end);
+
+            // Zero bytes in front of the next start code belong to it ("00 00 00 01")
+            // or are trailing_zero_8bits, never to the NAL itself
+            const uint8_t* nalEnd = next;
+            while (nalEnd > nalBegin && nalEnd[-1] == 0) --nalEnd;
+
+            if (nalEnd > nalBegin) {
+                NalUnit nal;
+                nal.data = nalBegin;
+                nal.size = static_cast<size_t>(nalEnd - nalBegin);
+                fn(nal);
+                ++count;
+            }
+            sc = next;
+        }
+        return count;
+    }
+}
@@ -1,6 +1,8 @@
 #include "VideoEncoder.h"
 #include <QDebug>
+#include <QRandomGenerator>
 #include <libavutil/frame.h>
+#include <algorithm>
 
 VideoEncoder::VideoEncoder(QObject* parent) : QObject(parent) {
     m_pkt = av_packet_alloc();
@@ -13,6 +15,63 @@ VideoEncoder::~VideoEncoder() {
 bool VideoEncoder::init(int width, int height, int fps, int bitrate) {
     m_targetW = width;
     m_targetH = height;
+    m_fps = fps > 0 ? fps : 30;
+    m_bitrate = bitrate;
+    m_lastPts = -1;
+    m_lastEncodedUs = -1;
+    m_rtpTimestampBase = QRandomGenerator::global()->generate();
+    m_clock.start();
+
+    return openCodec();
+}
+
+bool VideoEncoder::reconfigure(int width, int height, int fps, int bitrate) {
+    if (fps > 0) m_fps = fps; // ֡ encode() ʵʱأҪؿ
+    if (!m_codecCtx) {
+        // An earlier reopen failed completely: try again with the new target
+        m_targetW = width;
+        m_targetH = height;
+        m_bitrate = bitrate;
+        return openCodec();
+    }
+
+    if (width != m_targetW || height != m_targetH) {
+        // x264 ֧иķֱʣֻؿpts  RTP ʱ׼
+        qDebug() << "Encoder resolution" << m_targetW << "x" << m_targetH << "->" << width << "x" << height;
+        const int oldW = m_targetW;
+        const int oldH = m_targetH;
+        const int oldBitrate = m_bitrate;
+        m_targetW = width;
+        m_targetH = height;
+        m_bitrate = bitrate;
+        closeCodec();
+        if (openCodec()) return true;
+
+        // Keep encoding at the previous size rather than stopping for good
+        qWarning() << "Encoder reopen at" << width << "x" << height << "failed, keeping" << oldW << "x" << oldH;
+        m_targetW = oldW;
+        m_targetH = oldH;
+        m_bitrate = oldBitrate;
+        if (!openCodec()) {
+            qWarning() << "Encoder reopen at" << oldW << "x" << oldH << "failed, encoding stopped";
+        }
+        return false;
+    }
+
+    if (bitrate != m_bitrate) {
+        // libx264 װһ send_frame ʱ bit_rate 仯 x264_encoder_reconfig
+        m_bitrate = bitrate;
+        m_codecCtx->bit_rate = bitrate;
+        m_codecCtx->rc_max_rate = bitrate;
+        m_codecCtx->rc_buffer_size = bitrate;
+    }
+    return true;
+}
+
+bool VideoEncoder::openCodec() {
+    const int width = m_targetW;
+    const int height = m_targetH;
+    const int bitrate = m_bitrate;
 
     // 1.  H.264 
     const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_H264);
@@ -24,10 +83,14 @@ bool VideoEncoder::init(int width, int height, int fps, int bitrate) {
     // 2. 
     m_codecCtx = avcodec_alloc_context3(codec);
     m_codecCtx->bit_rate = bitrate;
+    // 1  VBVʿԱ reconfig ʵʱؼ֡Ҳ˲ʱʶ̫
+    m_codecCtx->rc_max_rate = bitrate;
+    m_codecCtx->rc_buffer_size = bitrate;
     m_codecCtx->width = width;
     m_codecCtx->height = height;
-    m_codecCtx->time_base = { 1, fps };
-    m_codecCtx->framerate = { fps, 1 };
+    // time_base ȡ RTP ʱӣpts ɲɼʱ任㣬ֹ֡ʱҲܱʵĲŽ
+    m_codecCtx->time_base = { 1, RTP_VIDEO_CLOCK };
+    m_codecCtx->framerate = { m_fps, 1 }; // Ϊص֡
     m_codecCtx->gop_size = 10; // ؼ֡
     m_codecCtx->max_b_frames = 0; // ʵʱ 0 B֡ӳ
     m_codecCtx->pix_fmt = AV_PIX_FMT_YUV420P; // H.264 ׼ʽ
@@ -36,13 +99,21 @@ bool VideoEncoder::init(int width, int height, int fps, int bitrate) {
     AVDictionary* opts = nullptr;
     av_dict_set(&opts, "preset", "ultrafast", 0);
     av_dict_set(&opts, "tune", "zerolatency", 0);
+    // zerolatency Ĭ force-cfrص x264 ذʵʱʣɱ֡ʣ
+    // ultrafast ĬϹص AQ libx264 ֻ AQ ʱʹ ROI˵ aq-mode=1
+    av_dict_set(&opts, "x264-params", "force-cfr=0:aq-mode=1", 0);
+    // A frame sent with pict_type I (requestKeyframe) becomes an IDR, not just an I-frame
+    av_dict_set(&opts, "forced-idr", "1", 0);
 
-    m_codecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    //  AV_CODEC_FLAG_GLOBAL_HEADERSPS/PPS Ҫÿؼ֡ն˲ܴ IDR ʼ
 
     if (avcodec_open2(m_codecCtx, codec, &opts) < 0) {
         qDebug() << "Could not open codec";
+        av_dict_free(&opts);
+        avcodec_free_context(&m_codecCtx);
         return false;
     }
+    av_dict_free(&opts);
 
     // 4.  YUV ֡ڴ
     m_frameYUV = av_frame_alloc();
@@ -50,25 +121,129 @@ bool VideoEncoder::init(int width, int height, int fps, int bitrate) {
     m_frameYUV->width = m_codecCtx->width;
     m_frameYUV->height = m_codecCtx->height;
     av_frame_get_buffer(m_frameYUV, 32);
+    m_yuvValid = false; // ·Ļһ֡ת
 
     return true;
 }
 
-void VideoEncoder::encode(const QVideoFrame& inputFrame) {
-    if (!m_codecCtx) return;
+void VideoEncoder::closeCodec() {
+    if (m_codecCtx) {
+        avcodec_free_context(&m_codecCtx);
+        m_codecCtx = nullptr;
+    }
+    if (m_frameYUV) {
+        av_frame_free(&m_frameYUV);
+        m_frameYUV = nullptr;
+    }
+}
+
+bool VideoEncoder::encode(const QVideoFrame& inputFrame) {
+    if (!m_codecCtx) return false;
+
+    // ǰĿ֡֡ABR ֡ʱЧ 10% ɼ 30fps 󿳳 15fps
+    const int64_t captureUs = inputFrame.startTime() >= 0 ? inputFrame.startTime() : m_clock.nsecsElapsed() / 1000;
+    if (m_lastEncodedUs >= 0 && captureUs > m_lastEncodedUs &&
+        captureUs - m_lastEncodedUs < 900000 / m_fps) {
+        return false;
+    }
 
     // A. ӳ Qt ֡ڴ
     QVideoFrame cloneFrame = inputFrame;
     if (!cloneFrame.map(QVideoFrame::ReadOnly)) {
         qDebug() << "Map frame failed";
-        return;
+        return false;
+    }
+
+    // 仯⣺ֻ 32 λʽ sws һ£֡仯
+    size_t damagedTiles = 0;
+    if (cloneFrame.bytesPerLine(0) >= cloneFrame.width() * 4) {
+        damagedTiles = m_damage.update(cloneFrame.bits(0), cloneFrame.width(), cloneFrame.height(),
+            cloneFrame.bytesPerLine(0));
+    }
+    else {
+        m_damage.reset();
+        damagedTiles = 1;
+    }
+
+    if (damagedTiles == 0 && m_yuvValid) {
+        // û䣺תҲ룬ֻ KEEPALIVE_INTERVAL_US һ֡ YUV һΣx264 ȫ skip 飩
+        cloneFrame.unmap();
+        if (captureUs - m_lastEncodedUs < KEEPALIVE_INTERVAL_US && !m_forceKeyframe) {
+            m_framesUnchanged.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        av_frame_remove_side_data(m_frameYUV, AV_FRAME_DATA_REGIONS_OF_INTEREST);
+    }
+    else {
+        const bool converted = convertToYuv(cloneFrame);
+        cloneFrame.unmap();
+        if (!converted) {
+            m_damage.reset(); // һ֡ûȥϣܵ"ѷ"Ļ׼
+            return false;
+        }
+
+        // ֻһ֣ѱ仯Ϊ ROI  x264Ȼڱ仯ĵط
+        const bool partial = m_yuvValid && damagedTiles < m_damage.tileCount();
+        av_frame_remove_side_data(m_frameYUV, AV_FRAME_DATA_REGIONS_OF_INTEREST);
+        if (partial) {
+            attachRegionsOfInterest(m_lastSrcW, m_lastSrcH);
+        }
+        m_yuvValid = true;
+    }
+
+    // C. ͸
+    // òɼʱ̻ 90kHz ptsʱˣ¿ʼɼʱ֡ƽ֤
+    m_lastEncodedUs = captureUs;
+    int64_t pts = 0;
+    if (m_lastPts >= 0) {
+        int64_t delta = av_rescale_q(captureUs - m_lastCaptureUs, { 1, 1000000 }, { 1, RTP_VIDEO_CLOCK });
+        if (delta <= 0) delta = RTP_VIDEO_CLOCK / m_fps;
+        pts = m_lastPts + delta;
     }
+    m_lastPts = pts;
+    m_lastCaptureUs = captureUs;
+    m_frameYUV->pts = pts; // ʱ
+    // A requested keyframe goes out as an IDR (forced-idr), otherwise x264 picks the type
+    m_frameYUV->pict_type = m_forceKeyframe ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+    m_forceKeyframe = false;
+    int ret = avcodec_send_frame(m_codecCtx, m_frameYUV);
 
+    // D. ձİ
+    while (ret >= 0) {
+        ret = avcodec_receive_packet(m_codecCtx, m_pkt);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
+        else if (ret < 0) break;
+
+        if (onEncodedData || onEncodedFrame) {
+            //  PTS (Presentation Time Stamp) Ӧ 90kHz ʱ
+            // time_base  1/90000pts Ѿ RTP ʱӿ̶ȣֵɣ 32 λƣ
+            const int64_t pktPts = m_pkt->pts != AV_NOPTS_VALUE ? m_pkt->pts : m_lastPts;
+            const uint32_t rtpTimestamp = m_rtpTimestampBase + static_cast<uint32_t>(pktPts);
+
+            if (onEncodedFrame) {
+                onEncodedFrame(m_pkt->data, static_cast<size_t>(m_pkt->size), rtpTimestamp);
+            }
+
+            //  Annex-B ʽ 00 00 01 / 00 00 00 01 ָ NALU
+            // ֱӰָ AVPacket ͼصҲڴ
+            if (onEncodedData) {
+                NalScanner::split(m_pkt->data, static_cast<size_t>(m_pkt->size), [&](const NalUnit& nal) {
+                    onEncodedData(nal, rtpTimestamp);
+                });
+            }
+        }
+        av_packet_unref(m_pkt);
+    }
+    return true;
+}
+
+bool VideoEncoder::convertToYuv(const QVideoFrame& cloneFrame) {
     // B. ֱ/ʽת (SWS Scale)
-    // ʹ 2K/4Kᱻǿŵ 1920x1080 YUV420P
+    // ֱʣŵǰĿֱ YUV420PֻԴĿߴ˲ؽ SwsContext
     if (!m_swsCtx || cloneFrame.width() != m_lastSrcW ||
-        cloneFrame.height() != m_lastSrcH) {
-        qDebug() << "Source resolution changed to" << cloneFrame.width() << "x" << cloneFrame.height() << "- Recreating SwsContext";
+        cloneFrame.height() != m_lastSrcH || m_targetW != m_swsDstW || m_targetH != m_swsDstH) {
+        qDebug() << "Scale changed to" << cloneFrame.width() << "x" << cloneFrame.height()
+                 << "->" << m_targetW << "x" << m_targetH << "- Recreating SwsContext";
 
         // ɵĴڣͷ
         if (m_swsCtx) {
@@ -79,6 +254,8 @@ void VideoEncoder::encode(const QVideoFrame& inputFrame) {
         // ¼¼
         m_lastSrcW = cloneFrame.width();
         m_lastSrcH = cloneFrame.height();
+        m_swsDstW = m_targetW;
+        m_swsDstH = m_targetH;
 
         
         // 򻯼 RGB32 (AV_PIX_FMT_BGRA  RGBA)
@@ -90,10 +267,7 @@ void VideoEncoder::encode(const QVideoFrame& inputFrame) {
     }
 
     // ȫ飺ĴʧܣҪ sws_scale 
-    if (!m_swsCtx) {
-        cloneFrame.unmap();
-        return;
-    }
+    if (!m_swsCtx) return false;
 
     // ִת
     const uint8_t* srcData[4] = { cloneFrame.bits(0) };
@@ -101,99 +275,33 @@ void VideoEncoder::encode(const QVideoFrame& inputFrame) {
 
     sws_scale(m_swsCtx, srcData, srcLinesize, 0, cloneFrame.height(),
         m_frameYUV->data, m_frameYUV->linesize);
+    return true;
+}
 
-    cloneFrame.unmap();
-
-    // C. ͸
-    m_frameYUV->pts = m_frameCount++; // ʱ
-    int ret = avcodec_send_frame(m_codecCtx, m_frameYUV);
-
-    // D. ձİ
-    while (ret >= 0) {
-        ret = avcodec_receive_packet(m_codecCtx, m_pkt);
-        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
-        else if (ret < 0) break;
-
-        if (onEncodedData) {
-            uint8_t* data = m_pkt->data;
-            int size = m_pkt->size;
-
-            //  Annex-B ʽȡ NALU
-            // Ҫҵ 00 00 01  00 00 00 01 ָ
-            int curPos = 0;
-            while (curPos < size) {
-                // Ѱ start code
-                int nalStart = -1;
-                int prefixLen = 0;
-
-                // 򵥵 start code ߼
-                // ע⣺ FFmpeg Ǳ׼ Annex-B
-                // ʵ avcodec_receive_packet ͨͷ Start Code
-
-                // ǰĿʼֱͨӾ Start Code
-                if (curPos + 4 <= size && data[curPos] == 0 && data[curPos + 1] == 0 && data[curPos + 2] == 0 && data[curPos + 3] == 1) {
-                    nalStart = curPos + 4;
-                    prefixLen = 4;
-                }
-                else if (curPos + 3 <= size && data[curPos] == 0 && data[curPos + 1] == 0 && data[curPos + 2] == 1) {
-                    nalStart = curPos + 3;
-                    prefixLen = 3;
-                }
-
-                if (nalStart == -1) {
-                    // Ҳ start codeⱾݣ̫ܣ߽
-                    break;
-                }
-
-                // Ѱһ start code ȷǰ NALU λ
-                int nextNalStart = size; // ĬΪβ
-                for (int i = nalStart; i < size - 3; ++i) {
-                    if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
-                        nextNalStart = i; // 00 00 01
-                        // ǰ滹и 0Ǿ 00 00 00 01һλ
-                        if (i > 0 && data[i - 1] == 0) nextNalStart = i - 1;
-                        break;
-                    }
-                }
-
-                int nalSize = nextNalStart - nalStart;
-                if (nalSize > 0) {
-                    std::vector<uint8_t> nalBuffer(data + nalStart, data + nalStart + nalSize);
-
-                    //  PTS (Presentation Time Stamp) Ӧ 90kHz ʱ
-                    // ffmpeg  pts ͨ time_base ( 1/30)
-                    // RTP Ҫ 90000Hz
-                    
-                    uint32_t rtpTimestamp = 0;
-                    if (m_pkt->pts != AV_NOPTS_VALUE) {
-                        // 򻯼㣺Ϊ time_base = {1, fps}
-                        //  pts ֡ 0, 1, 2...
-                        // 90kHz ÿ֡ = 90000 / fps
-                        //  fps=30 -> 3000
-                        rtpTimestamp = static_cast<uint32_t>(m_pkt->pts * (90000 / 30));
-                    }
-
-                    // صȥ NALU  + ʱ
-                    onEncodedData(nalBuffer, rtpTimestamp);
-                }
-
-                curPos = nextNalStart;
-            }
-        }
-        av_packet_unref(m_pkt);
+void VideoEncoder::attachRegionsOfInterest(int srcW, int srcH) {
+    const std::vector<DamageTracker::Rect>& damage = m_damage.damage();
+    if (damage.empty() || damage.size() > static_cast<size_t>(MAX_ROI_REGIONS)) return;
+
+    AVFrameSideData* sd = av_frame_new_side_data(m_frameYUV, AV_FRAME_DATA_REGIONS_OF_INTEREST,
+        damage.size() * sizeof(AVRegionOfInterest));
+    if (!sd) return;
+
+    AVRegionOfInterest* roi = reinterpret_cast<AVRegionOfInterest*>(sd->data);
+    for (size_t i = 0; i < damage.size(); ++i) {
+        // Դֱ -> ֱʣȡ֤仯 ROI 
+        const DamageTracker::Rect& r = damage[i];
+        roi[i].self_size = sizeof(AVRegionOfInterest);
+        roi[i].left = r.x * m_targetW / srcW;
+        roi[i].top = r.y * m_targetH / srcH;
+        roi[i].right = std::min(m_targetW, ((r.x + r.width) * m_targetW + srcW - 1) / srcW);
+        roi[i].bottom = std::min(m_targetH, ((r.y + r.height) * m_targetH + srcH - 1) / srcH);
+        roi[i].qoffset = { -1, 5 }; // ֵ =  QP
     }
 }
 
 void VideoEncoder::cleanup() {
-    if (m_codecCtx) {
-        avcodec_free_context(&m_codecCtx);
-        m_codecCtx = nullptr;
-    }
-    // ȷͷ֡ڴ淽ʽ
-    if (m_frameYUV) {
-        av_frame_free(&m_frameYUV); // ָ
-        m_frameYUV = nullptr;
-    }
+    // ȷͷ֡ڴ淽ʽ closeCodec() av_frame_free ָ룩
+    closeCodec();
     if (m_swsCtx) {
         sws_freeContext(m_swsCtx);
         m_swsCtx = nullptr;
@@ -1,7 +1,11 @@
 #pragma once
 #include <QObject>
 #include <QVideoFrame>
+#include <QElapsedTimer>
+#include <atomic>
 #include <functional>
+#include "NalScanner.h"
+#include "DamageTracker.h"
 
 // FFmpeg  C Կ
 extern "C" {
@@ -21,13 +25,50 @@ public:
     // ʼ (ĿΪ 1080p ScreenCaptureд)
     bool init(int width, int height, int fps, int bitrate);
 
+    // ʱABRڱ̵߳ãжϲɼ
+    // /ֱ֡Чx264 reconfigֱʱ仯ʱؿһ֡Ϊ IDR
+    // Returns false if the new resolution could not be opened: the previous one is reopened instead
+    bool reconfigure(int width, int height, int fps, int bitrate);
+
+    // The receiver lost a frame (PLI): the next frame is encoded as an IDR. Encoder thread only
+    void requestKeyframe() { m_forceKeyframe = true; }
+
     // һ֡ Qt Ļ
-    void encode(const QVideoFrame& frame);
+    // frame.startTime() Ϊɼʱ̣΢룩RTP ʱݴ˻㣻Ϊ -1 ʱ˻Ϊʱ
+    //  false ʾһ֡ûͽδʼӳʧܡǰ֡ʣûб仯
+    bool encode(const QVideoFrame& frame);
+
+    // ûб仯ʱ̰֡߳ȫ
+    quint64 framesUnchanged() const { return m_framesUnchanged.load(std::memory_order_relaxed); }
+
+    // RTP ƵʱƵ (RFC 6184)
+    static constexpr int RTP_VIDEO_CLOCK = 90000;
+
+    // 澲ֹʱҲٸôñһ֡ýն˺ ABR ֪
+    static constexpr int64_t KEEPALIVE_INTERVAL_US = 1000000;
+
+    // ROI ôͲ·֡ԭش
+    static constexpr int MAX_ROI_REGIONS = 64;
 
     // صõ H.264 ͨﴫȥ
-    std::function<void(const std::vector<uint8_t>&, uint32_t)> onEncodedData;
+    // ÿ NAL صһΣnal ָ AVPacket ڲ壨ӵڴ棩ֻڻصڼЧ
+    std::function<void(const NalUnit& nal, uint32_t timestamp)> onEncodedData;
+
+    // ص֡һ AVPacketAnnex-B ʽʼ룩ȥͬӵڴ
+    // ý H264RtpPacketizer Ҫ֡ͣ Marker λֻ֡һ
+    std::function<void(const uint8_t* data, size_t size, uint32_t timestamp)> onEncodedFrame;
 
 private:
+    //  m_targetW/Hm_bitrate  x264ʱ״̬Ӱ
+    bool openCodec();
+    void closeCodec();
+
+    // B. ֱ/ʽתӳ BGRA ֡ -> m_frameYUV
+    bool convertToYuv(const QVideoFrame& mappedFrame);
+
+    // һ update() ı仯Ϊ ROI ҵ m_frameYUV ϣ갴ű㣩
+    void attachRegionsOfInterest(int srcW, int srcH);
+
     // Դͷ
     void cleanup();
 
@@ -38,8 +79,24 @@ private:
 
     int m_targetW = 1920; // ͳһΪ1080pķֱʣѹʱ
     int m_targetH = 1080;
-    int m_frameCount = 0;
+    int m_fps = 30;
+    int m_bitrate = 1000000;
+    bool m_forceKeyframe = false;     // set by requestKeyframe(), cleared when the IDR is sent
+    int64_t m_lastEncodedUs = -1;     // һͽĲɼʱ̣ڰ m_fps ֡
+
+    // ʱ time_base ֱȡ 1/90000pts  RTP ʱӿ̶
+    QElapsedTimer m_clock;            // ֡û startTime ʱĶʱ
+    int64_t m_lastPts = -1;           // һ֡ pts (90kHz)
+    int64_t m_lastCaptureUs = 0;      // һ֡Ĳɼʱ (us)
+    uint32_t m_rtpTimestampBase = 0;  // RFC 3550 Ҫֵ
 
     int m_lastSrcW = -1;// ¼һԴֱʣڼ仯
     int m_lastSrcH = -1;
+    int m_swsDstW = -1; // SwsContext ǰֱʣֻű˲ؽ
+    int m_swsDstH = -1;
+
+    // 仯⣺64x64 ֿϣû仯֡ sws_scale 
+    DamageTracker m_damage;
+    bool m_yuvValid = false;          // m_frameYUV ǷһͽĻ
+    std::atomic<quint64> m_framesUnchanged{ 0 };
 };
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "AbrController.h"
+#include <algorithm>
+
+AbrController::AbrController() : AbrController(Config()) {}
+
+AbrController::AbrController(const Config& config) : m_config(config)
+{
+    // Screen content: keep pixels as long as possible, drop frame rate first
+    m_ladder = {
+        { 2500000, 1920, 1080, 30 },
+        { 1500000, 1920, 1080, 15 },
+        {  900000, 1280,  720, 15 },
+        {  500000,  960,  540, 10 },
+        {  250000,  640,  360, 10 },
+        {       0,  640,  360,  5 },
+    };
+    reset();
+}
+
+void AbrController::reset()
+{
+    m_bitrate = m_config.startBitrate;
+    m_rung = rungFor(m_config.startBitrate);
+    m_prevQueueDelayMs = -1.0;
+    m_prevFramesDropped = 0;
+    m_lastCongestedBitrate = 0.0;
+    m_lastBackoffUs = -1;
+    m_lastUpgradeUs = -1;
+}
+
+size_t AbrController::rungFor(int bitrate) const
+{
+    for (size_t i = 0; i < m_ladder.size(); i++) {
+        if (bitrate >= m_ladder[i].minBitrate) return i;
+    }
+    return m_ladder.size() - 1;
+}
+
+AbrController::Target AbrController::update(const Feedback& feedback, int64_t nowUs)
+{
+    const bool queueKnown = feedback.queueDelayMs >= 0.0;
+    const bool dropped = feedback.framesDropped > m_prevFramesDropped;
+    // Growth is only measured between two known samples
+    const bool queueGrowing = queueKnown && m_prevQueueDelayMs >= 0.0 &&
+        feedback.queueDelayMs > m_config.queueDelayLowMs &&
+        feedback.queueDelayMs > m_prevQueueDelayMs * 1.5;
+    const bool congested = dropped || queueGrowing ||
+        feedback.queueDelayMs > m_config.queueDelayHighMs ||
+        feedback.lossFraction > m_config.lossHigh;
+    // Unknown loss is fine (the DataChannel path has none), an unknown queue is not
+    const bool headroom = queueKnown && feedback.queueDelayMs < m_config.queueDelayLowMs &&
+        feedback.lossFraction < m_config.lossLow;
+
+    m_prevFramesDropped = feedback.framesDropped;
+    if (queueKnown) m_prevQueueDelayMs = feedback.queueDelayMs;
+
+    if (congested) {
+        // Back off from what actually got through, not from what we asked for
+        double base = m_bitrate;
+        if (feedback.sentBitrate > 0.0) base = std::min(base, feedback.sentBitrate);
+        double factor = m_config.backoffFactor;
+        if (feedback.lossFraction > m_config.lossHigh) {
+            factor = std::min(factor, 1.0 - 0.5 * feedback.lossFraction);
+        }
+        m_lastCongestedBitrate = m_bitrate;
+        m_bitrate = base * factor;
+        m_lastBackoffUs = nowUs;
+    }
+    else if (headroom && (m_lastBackoffUs < 0 || nowUs - m_lastBackoffUs >= m_config.holdAfterBackoffUs)) {
+        // Far below the last congestion point: ramp quickly; close to it: probe gently
+        const bool nearCongestion = m_lastCongestedBitrate > 0.0 && m_bitrate > 0.85 * m_lastCongestedBitrate;
+        m_bitrate *= nearCongestion ? m_config.probeFactor : m_config.rampUpFactor;
+    }
+    // Otherwise (moderate loss or queue, or no feedback) hold the current rate
+
+    m_bitrate = std::min(std::max(m_bitrate, static_cast<double>(m_config.minBitrate)),
+        static_cast<double>(m_config.maxBitrate));
+
+    // Step down the ladder at once, step up only with 15% margin and not too often:
+    // every step up reopens the encoder and costs an IDR
+    const size_t wanted = rungFor(static_cast<int>(m_bitrate));
+    if (wanted > m_rung) {
+        m_rung = wanted;
+    }
+    else if (wanted < m_rung) {
+        const Rung& up = m_ladder[m_rung - 1];
+        const bool enoughMargin = m_bitrate >= up.minBitrate * 1.15;
+        const bool settled = m_lastUpgradeUs < 0 || nowUs - m_lastUpgradeUs >= m_config.upgradeIntervalUs;
+        if (enoughMargin && settled) {
+            m_rung--;
+            m_lastUpgradeUs = nowUs;
+        }
+    }
+
+    return target();
+}
+
+AbrController::Target AbrController::target() const
+{
+    const Rung& rung = m_ladder[m_rung];
+    Target t;
+    // Round to 10 kbit/s so tiny oscillations don't trigger an x264 reconfig every update
+    t.bitrate = static_cast<int>(m_bitrate / 10000.0 + 0.5) * 10000;
+    t.fps = rung.fps;
+    t.width = rung.width;
+    t.height = rung.height;
+    return t;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Adaptive bitrate controller for the screen-share encoder.
+//
+// Fed periodically with transport feedback: the sender-side queue (pacer + SCTP bufferedAmount)
+// on the DataChannel path, RTCP receiver reports (loss, RTT) on the media-track path. Bitrate
+// moves multiplicatively: quick ramp-up while there is headroom, slower probing near the rate
+// where congestion was last seen, and an immediate back-off when the queue grows or loss
+// appears. Resolution and frame rate follow from the bitrate through a ladder tuned for screen
+// content (frame rate goes first, text legibility last), with hysteresis so the encoder is not
+// reopened for every small change. Missing feedback never counts as headroom: without a queue
+// measurement the rate is held.
+//
+// Not thread-safe; times are microseconds on one monotonic clock supplied by the caller.
+class AbrController
+{
+public:
+    struct Config
+    {
+        int minBitrate = 200000;
+        int maxBitrate = 4000000;
+        int startBitrate = 1000000;
+        double rampUpFactor = 1.15;          // per update with headroom, far from the last congestion
+        double probeFactor = 1.03;           // per update close to the last congested rate
+        double backoffFactor = 0.85;
+        double queueDelayLowMs = 30.0;       // below: headroom
+        double queueDelayHighMs = 150.0;     // above: congested
+        double lossLow = 0.02;
+        double lossHigh = 0.10;
+        int64_t holdAfterBackoffUs = 1000000;    // no increase right after a back-off
+        int64_t upgradeIntervalUs = 5000000;     // min time between resolution/fps upgrades
+    };
+
+    struct Feedback
+    {
+        double queueDelayMs = -1.0;   // time the queued bytes need at the current rate, < 0 if unknown
+        double lossFraction = -1.0;   // RTCP fraction lost, < 0 if unknown
+        double rttMs = -1.0;          // < 0 if unknown
+        double sentBitrate = 0.0;     // measured since the previous update, 0 if unknown
+        uint64_t framesDropped = 0;   // cumulative sender-side drops (pacer)
+    };
+
+    struct Target
+    {
+        int bitrate = 0;
+        int fps = 0;
+        int width = 0;
+        int height = 0;
+
+        bool operator==(const Target& o) const
+        {
+            return bitrate == o.bitrate && fps == o.fps && width == o.width && height == o.height;
+        }
+        bool operator!=(const Target& o) const { return !(*this == o); }
+    };
+
+    AbrController();
+    explicit AbrController(const Config& config);
+
+    // Returns the target after taking the feedback into account
+    Target update(const Feedback& feedback, int64_t nowUs);
+
+    Target target() const;
+    void reset();
+
+private:
+    struct Rung
+    {
+        int minBitrate;
+        int width;
+        int height;
+        int fps;
+    };
+
+    size_t rungFor(int bitrate) const;
+
+    Config m_config;
+    std::vector<Rung> m_ladder;   // descending minBitrate
+    size_t m_rung = 0;
+    double m_bitrate = 0.0;
+
+    double m_prevQueueDelayMs = -1.0;   // last known queue delay, < 0 if none yet
+    uint64_t m_prevFramesDropped = 0;
+    double m_lastCongestedBitrate = 0.0;
+    int64_t m_lastBackoffUs = -1;
+    int64_t m_lastUpgradeUs = -1;
+};
@@ -0,0 +1,248 @@
+#include "JitterBuffer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const int64_t RTP_VIDEO_CLOCK = 90000;
+    const int64_t TRANSIT_WINDOW_US = 2000000;  // base transit = min over the last 2 s
+    const double BUFFER_DELAY_SMOOTHING = 1.0 / 16.0;
+
+    int64_t unwrap16(int64_t last, uint16_t value)
+    {
+        return last + static_cast<int16_t>(static_cast<uint16_t>(value - static_cast<uint16_t>(last)));
+    }
+
+    int64_t unwrap32(int64_t last, uint32_t value)
+    {
+        return last + static_cast<int32_t>(static_cast<uint32_t>(value - static_cast<uint32_t>(last)));
+    }
+}
+
+JitterBuffer::JitterBuffer() : JitterBuffer(Config()) {}
+
+JitterBuffer::JitterBuffer(const Config& config) : m_config(config) {}
+
+void JitterBuffer::insert(Packet packet, int64_t nowUs)
+{
+    m_stats.packetsReceived++;
+
+    RtpPacket rtp;
+    if (!RtpDepacketizer::parse(reinterpret_cast<const uint8_t*>(packet.data()), packet.size(), rtp)) {
+        m_stats.packetsDiscarded++;
+        return;
+    }
+
+    if (!m_started) {
+        m_started = true;
+        m_lastSeq = rtp.sequenceNumber;
+        m_lastTimestamp = rtp.timestamp;
+    }
+    const int64_t seq = unwrap16(m_lastSeq, rtp.sequenceNumber);
+    const int64_t ts = unwrap32(m_lastTimestamp, rtp.timestamp);
+    m_lastSeq = std::max(m_lastSeq, seq);
+    m_lastTimestamp = std::max(m_lastTimestamp, ts);
+
+    // Late packet of a frame that was already played out or given up on
+    if (m_hasReleased && (ts <= m_lastReleasedTimestamp || seq <= m_lastReleasedSeq)) {
+        m_stats.packetsDiscarded++;
+        return;
+    }
+
+    Frame& frame = m_frames[ts];
+    if (frame.packets.empty()) {
+        frame.timestamp = ts;
+        frame.firstArrivalUs = nowUs;
+    }
+    if (frame.packets.count(seq)) { // duplicate (e.g. retransmission that raced the original)
+        m_stats.packetsDiscarded++;
+        return;
+    }
+    if (rtp.marker) {
+        frame.hasMarker = true;
+        frame.markerSeq = seq;
+    }
+
+    Slot& slot = frame.packets[seq];
+    slot.buffer = std::move(packet);
+    // Re-parse against the moved-to buffer so payload points at storage we own
+    RtpDepacketizer::parse(reinterpret_cast<const uint8_t*>(slot.buffer.data()), slot.buffer.size(), slot.rtp);
+
+    if (!frame.complete && isComplete(frame)) {
+        onFrameComplete(frame, nowUs);
+    }
+
+    while (m_frames.size() > m_config.maxFrames) {
+        dropFrame(m_frames.begin());
+    }
+}
+
+bool JitterBuffer::isComplete(const Frame& frame) const
+{
+    if (!frame.hasMarker || frame.packets.empty()) return false;
+
+    const int64_t first = frame.packets.begin()->first;
+    const int64_t last = frame.packets.rbegin()->first;
+    if (last != frame.markerSeq) return false;
+    if (static_cast<int64_t>(frame.packets.size()) != last - first + 1) return false;
+
+    return RtpDepacketizer::startsNal(frame.packets.begin()->second.rtp);
+}
+
+void JitterBuffer::onFrameComplete(Frame& frame, int64_t nowUs)
+{
+    frame.complete = true;
+    frame.completeUs = nowUs;
+
+    const int64_t mediaUs = mediaTimeUs(frame.timestamp);
+
+    // RFC 3550 6.4.1 interarrival jitter, on whole frames instead of packets
+    if (m_hasPrevComplete) {
+        const int64_t d = (nowUs - m_prevCompleteUs) - (mediaUs - m_prevCompleteMediaUs);
+        m_jitterUs += (std::abs(static_cast<double>(d)) - m_jitterUs) / 16.0;
+    }
+    m_hasPrevComplete = true;
+    m_prevCompleteUs = nowUs;
+    m_prevCompleteMediaUs = mediaUs;
+
+    // Sliding-window minimum of the transit time (monotonic deque)
+    const int64_t transit = nowUs - mediaUs;
+    while (!m_transitWindow.empty() && m_transitWindow.back().second >= transit) {
+        m_transitWindow.pop_back();
+    }
+    m_transitWindow.emplace_back(nowUs, transit);
+    while (m_transitWindow.front().first < nowUs - TRANSIT_WINDOW_US) {
+        m_transitWindow.pop_front();
+    }
+}
+
+int64_t JitterBuffer::mediaTimeUs(int64_t timestamp) const
+{
+    return timestamp * 1000000 / RTP_VIDEO_CLOCK;
+}
+
+int64_t JitterBuffer::playoutUs(const Frame& frame) const
+{
+    const double target = std::min(std::max(m_config.jitterFactor * m_jitterUs, m_config.minDelayMs * 1000.0),
+        m_config.maxDelayMs * 1000.0);
+    const int64_t baseTransit = m_transitWindow.empty() ? frame.completeUs - mediaTimeUs(frame.timestamp)
+        : m_transitWindow.front().second;
+    return mediaTimeUs(frame.timestamp) + baseTransit + static_cast<int64_t>(target);
+}
+
+void JitterBuffer::dropFrame(std::map<int64_t, Frame>::iterator it)
+{
+    Frame& frame = it->second;
+    if (!frame.packets.empty()) {
+        m_hasReleased = true;
+        m_lastReleasedSeq = std::max(m_lastReleasedSeq, frame.packets.rbegin()->first);
+        m_lastReleasedTimestamp = std::max(m_lastReleasedTimestamp, frame.timestamp);
+    }
+    m_frames.erase(it);
+    m_stats.framesDropped++;
+    m_waitingKeyframe = true;
+    m_keyframeRequested = true;
+}
+
+bool JitterBuffer::pop(int64_t nowUs, EncodedFrame& out)
+{
+    while (!m_frames.empty()) {
+        auto it = m_frames.begin();
+        Frame& frame = it->second;
+
+        if (!frame.complete) {
+            // An incomplete frame blocks the queue until a newer frame is due or it gets too old
+            bool newerDue = false;
+            for (auto next = std::next(it); next != m_frames.end(); ++next) {
+                if (next->second.complete && playoutUs(next->second) <= nowUs) {
+                    newerDue = true;
+                    break;
+                }
+            }
+            if (newerDue || nowUs - frame.firstArrivalUs > m_config.maxDelayMs * 1000LL) {
+                dropFrame(it);
+                continue;
+            }
+            return false;
+        }
+
+        if (nowUs < playoutUs(frame)) return false;
+
+        // Packets between the previous frame and this one were lost: references are broken
+        const int64_t firstSeq = frame.packets.begin()->first;
+        if (m_hasReleased && firstSeq != m_lastReleasedSeq + 1) {
+            m_waitingKeyframe = true;
+        }
+
+        out.data.clear();
+        out.keyframe = false;
+        bool ok = true;
+        for (const auto& entry : frame.packets) {
+            ok = RtpDepacketizer::appendToAccessUnit(entry.second.rtp, out.data, out.keyframe) && ok;
+        }
+
+        m_hasReleased = true;
+        m_lastReleasedSeq = frame.markerSeq;
+        m_lastReleasedTimestamp = frame.timestamp;
+
+        if (!ok || (m_waitingKeyframe && !out.keyframe)) {
+            m_frames.erase(it);
+            m_stats.framesDropped++;
+            m_waitingKeyframe = true;
+            m_keyframeRequested = true;
+            continue;
+        }
+        m_waitingKeyframe = false;
+        m_keyframeRequested = false;  // the keyframe answered any request still held back
+
+        out.rtpTimestamp = static_cast<uint32_t>(frame.timestamp);
+        out.completeUs = frame.completeUs;
+        out.releaseUs = nowUs;
+        m_frames.erase(it);
+
+        m_stats.framesReleased++;
+        m_stats.bufferDelayMs += ((out.releaseUs - out.completeUs) / 1000.0 - m_stats.bufferDelayMs) * BUFFER_DELAY_SMOOTHING;
+        return true;
+    }
+    return false;
+}
+
+int64_t JitterBuffer::nextEventUs() const
+{
+    if (m_frames.empty()) return -1;
+
+    int64_t next = m_frames.begin()->second.firstArrivalUs + m_config.maxDelayMs * 1000LL;
+    for (const auto& entry : m_frames) {
+        if (entry.second.complete) {
+            next = std::min(next, playoutUs(entry.second));
+        }
+    }
+    return next;
+}
+
+bool JitterBuffer::takeKeyframeRequest(int64_t nowUs)
+{
+    if (!m_keyframeRequested) return false;
+    // Still pending: asked again once the interval is over if no keyframe arrived meanwhile
+    if (m_lastKeyframeRequestUs >= 0 && nowUs - m_lastKeyframeRequestUs < m_config.keyframeRequestIntervalMs * 1000LL) {
+        return false;
+    }
+    m_keyframeRequested = false;
+    m_lastKeyframeRequestUs = nowUs;
+    return true;
+}
+
+JitterBuffer::Stats JitterBuffer::stats() const
+{
+    Stats s = m_stats;
+    s.jitterMs = m_jitterUs / 1000.0;
+    s.targetDelayMs = std::min(std::max(m_config.jitterFactor * m_jitterUs / 1000.0, static_cast<double>(m_config.minDelayMs)),
+        static_cast<double>(m_config.maxDelayMs));
+    s.bufferedFrames = m_frames.size();
+    return s;
+}
+
+void JitterBuffer::reset()
+{
+    *this = JitterBuffer(m_config);
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "RtpDepacketizer.h"
+
+// One reassembled H.264 access unit leaving the jitter buffer.
+struct EncodedFrame
+{
+    std::vector<uint8_t> data;  // Annex-B, start codes included
+    uint32_t rtpTimestamp = 0;
+    bool keyframe = false;
+    int64_t completeUs = 0;     // arrival time of the packet that completed the frame
+    int64_t releaseUs = 0;      // time the buffer handed the frame out
+};
+
+// Adaptive jitter buffer for H.264 over RTP.
+//
+// Packets are grouped into frames by RTP timestamp and ordered by sequence number. A frame is
+// released once it is complete and its playout time has come:
+//     playout = mediaTime + baseTransit + targetDelay
+// baseTransit is the smallest network transit seen in the last couple of seconds, targetDelay
+// follows the RFC 3550 interarrival jitter estimate. After a loss, frames are dropped until the
+// next keyframe so the decoder never sees a broken reference chain.
+//
+// Not thread-safe; all times are microseconds on one monotonic clock supplied by the caller.
+class JitterBuffer
+{
+public:
+    using Packet = std::vector<std::byte>;  // same layout as rtc::binary, moved in without a copy
+
+    struct Config
+    {
+        int minDelayMs = 0;
+        int maxDelayMs = 400;        // also how long an incomplete frame may block the queue
+        double jitterFactor = 3.0;   // targetDelay = jitterFactor * jitter
+        size_t maxFrames = 128;      // hard cap, the oldest frame is dropped beyond it
+        int keyframeRequestIntervalMs = 500;  // at most one PLI per interval while waiting for a keyframe
+    };
+
+    struct Stats
+    {
+        uint64_t packetsReceived = 0;
+        uint64_t packetsDiscarded = 0;  // malformed, duplicate or too late
+        uint64_t framesReleased = 0;
+        uint64_t framesDropped = 0;     // incomplete, or waiting for a keyframe after loss
+        double jitterMs = 0.0;          // RFC 3550 interarrival jitter of complete frames
+        double targetDelayMs = 0.0;     // extra playout delay currently applied
+        double bufferDelayMs = 0.0;     // smoothed time frames spent complete in the buffer
+        size_t bufferedFrames = 0;
+    };
+
+    JitterBuffer();
+    explicit JitterBuffer(const Config& config);
+
+    void insert(Packet packet, int64_t nowUs);
+
+    // Returns the next frame whose playout time has come, false if none is due yet.
+    bool pop(int64_t nowUs, EncodedFrame& frame);
+
+    // Earliest time pop() can return something or drop a stalled frame; -1 if empty.
+    int64_t nextEventUs() const;
+
+    // True after a loss when the owner should ask the sender for a keyframe (PLI). Throttled to
+    // one per keyframeRequestIntervalMs: every dropped frame asks again, the sender needs one.
+    bool takeKeyframeRequest(int64_t nowUs);
+
+    Stats stats() const;
+    void reset();
+
+private:
+    struct Slot
+    {
+        Packet buffer;
+        RtpPacket rtp;
+    };
+
+    struct Frame
+    {
+        int64_t timestamp = 0;            // unwrapped RTP timestamp
+        std::map<int64_t, Slot> packets;  // keyed by unwrapped sequence number
+        bool hasMarker = false;
+        int64_t markerSeq = 0;
+        bool complete = false;
+        int64_t firstArrivalUs = 0;
+        int64_t completeUs = 0;
+    };
+
+    bool isComplete(const Frame& frame) const;
+    void onFrameComplete(Frame& frame, int64_t nowUs);
+    int64_t playoutUs(const Frame& frame) const;
+    int64_t mediaTimeUs(int64_t timestamp) const;
+    void dropFrame(std::map<int64_t, Frame>::iterator it);
+
+    Config m_config;
+    std::map<int64_t, Frame> m_frames;  // keyed by unwrapped RTP timestamp
+
+    // 16/32-bit wrap-around handling
+    bool m_started = false;
+    int64_t m_lastSeq = 0;
+    int64_t m_lastTimestamp = 0;
+
+    // Release state
+    bool m_hasReleased = false;
+    int64_t m_lastReleasedSeq = 0;
+    int64_t m_lastReleasedTimestamp = 0;
+    bool m_waitingKeyframe = true;     // nothing decodable before the first keyframe
+    bool m_keyframeRequested = false;
+    int64_t m_lastKeyframeRequestUs = -1;
+
+    // Delay estimation
+    bool m_hasPrevComplete = false;
+    int64_t m_prevCompleteUs = 0;
+    int64_t m_prevCompleteMediaUs = 0;
+    double m_jitterUs = 0.0;
+    std::deque<std::pair<int64_t, int64_t>> m_transitWindow;  // (arrivalUs, transitUs), ascending transit
+
+    Stats m_stats;
+};
@@ -1,7 +1,10 @@
 #include "PeerConnectionManager.hpp"
 #include "../signaling/WsSignalingClient.hpp"
+#include "../encoder/NalScanner.h"
 #include <QJsonObject>
 #include <QJsonDocument>
+#include <QThread>
+#include <QTimer>
 #include <QDebug>
 
 PeerConnectionManager::PeerConnectionManager(QObject* parent)
@@ -10,17 +13,63 @@ PeerConnectionManager::PeerConnectionManager(QObject* parent)
     , m_pc(nullptr)
     , m_videoChannel(nullptr)
     , m_isCaller(false)
-{}
+    , m_packetizer(m_ssrc, static_cast<uint8_t>(payloadType_), MAX_RTP_PAYLOAD_SIZE)
+    , m_packetPool(m_packetizer.packetCapacity(), PACKET_POOL_PREALLOCATE)
+{
+    // No parent: the receiver is moved to the decode thread and deleted after it stops
+    m_receiver = new VideoReceiver();
+    m_decodeThread = new QThread(this);
+    m_decodeThread->setObjectName("VideoDecodeThread");
+    m_receiver->moveToThread(m_decodeThread);
+
+    connect(m_receiver, &VideoReceiver::frameDecoded, this, &PeerConnectionManager::remoteFrameReady,
+        Qt::DirectConnection);
+    connect(m_receiver, &VideoReceiver::keyframeRequested, this, [this]() {
+        // PLI over RTCP; the DataChannel path has no feedback channel and relies on the GOP
+        if (m_videoTrack && m_videoTrack->isOpen()) {
+            m_videoTrack->requestKeyframe();
+        }
+        }, Qt::QueuedConnection);
+
+    m_decodeThread->start();
+
+    m_pacerClock.start();
+    m_pacerTimer = new QTimer(this);
+    m_pacerTimer->setSingleShot(true);
+    m_pacerTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_pacerTimer, &QTimer::timeout, this, &PeerConnectionManager::pumpPacer);
+
+    m_abrTimer = new QTimer(this);
+    m_abrTimer->setInterval(500);
+    connect(m_abrTimer, &QTimer::timeout, this, &PeerConnectionManager::onAbrTick);
+
+    m_iceTimer = new QTimer(this);
+    m_iceTimer->setSingleShot(true);
+    m_iceTimer->setTimerType(Qt::PreciseTimer);
+    m_iceTimer->setInterval(ICE_BATCH_WINDOW_MS);
+    connect(m_iceTimer, &QTimer::timeout, this, &PeerConnectionManager::flushCandidates);
+}
 
 PeerConnectionManager::~PeerConnectionManager()
-{}
+{
+    m_decodeThread->quit();
+    m_decodeThread->wait();
+    delete m_receiver;
+    m_receiver = nullptr;
+}
 
 void PeerConnectionManager::start(const QString& targetId)
 {
     m_targetPeerId = targetId;
     m_isCaller = true;
     createPeerConnection();
-    setupDataChannel(); // the user who send the offer must establish DataChannel
+    // the user who send the offer must establish the video path (track or DataChannel)
+    if (m_transport == VideoTransport::MediaTrack) {
+        setupVideoTrack();
+    }
+    else {
+        setupDataChannel();
+    }
     // sendtest();
 }
 
@@ -29,6 +78,8 @@ void PeerConnectionManager::createPeerConnection()
     rtc::Configuration config;
 
     m_pc = std::make_shared<rtc::PeerConnection>(config);
+    // Tags this connection's candidates; stop() and the next connection bump it
+    const quint64 iceGeneration = ++m_iceGeneration;
 
     // 1. Status monitoring
     m_pc->onStateChange([this](rtc::PeerConnection::State state) {
@@ -43,12 +94,31 @@ void PeerConnectionManager::createPeerConnection()
             });
         });
 
-    // 2. ICE Exchange
-    m_pc->onLocalCandidate([this](rtc::Candidate cand) {
-        QJsonObject data;
-        data["candidate"] = QString::fromStdString(cand.candidate());
-        data["sdpMid"] = QString::fromStdString(cand.mid());
-        sendSignalingMessage(stype_to_string(SignalingType::ICE), m_targetPeerId, data);
+    // 2. ICE Exchange: candidates of one coalescing window share a message (see flushCandidates)
+    m_pc->onLocalCandidate([this, iceGeneration](rtc::Candidate cand) {
+        QJsonObject candidate;
+        candidate["candidate"] = QString::fromStdString(cand.candidate());
+        candidate["sdpMid"] = QString::fromStdString(cand.mid());
+        QMetaObject::invokeMethod(this, [this, iceGeneration, candidate]() {
+            if (iceGeneration != m_iceGeneration) {
+                return;   // queued before stop(): belongs to a closed connection
+            }
+            m_pendingCandidates.append(candidate);
+            if (!m_iceTimer->isActive()) {
+                m_iceTimer->start();
+            }
+            });
+        });
+
+    // End of candidates: queued behind the last candidate, sends the batch without waiting
+    m_pc->onGatheringStateChange([this, iceGeneration](rtc::PeerConnection::GatheringState state) {
+        if (state == rtc::PeerConnection::GatheringState::Complete) {
+            QMetaObject::invokeMethod(this, [this, iceGeneration]() {
+                if (iceGeneration == m_iceGeneration) {
+                    flushCandidates();
+                }
+                });
+        }
         });
 
     // 3. SDP Exchange (Generate Offer/Answer)
@@ -67,6 +137,84 @@ void PeerConnectionManager::createPeerConnection()
             bindDataChannel(dc);
         }
         });
+
+    // 5. Peer bind media track (the caller decides the transport in its offer)
+    m_pc->onTrack([this](std::shared_ptr<rtc::Track> track) {
+        if (track->mid() == "video") {
+            bindVideoTrack(track);
+        }
+        });
+}
+
+void PeerConnectionManager::setupVideoTrack()
+{
+    if (!m_pc) {
+        WARNING() << "PeerConnection is not created!";
+        return;
+    }
+
+    rtc::Description::Video media("video", rtc::Description::Direction::SendOnly);
+    media.addH264Codec(payloadType_);
+    media.addSSRC(m_ssrc, "video-stream");
+    auto track = m_pc->addTrack(media);
+
+    // Handler chain: H264 packetizer -> RTCP sender reports -> NACK retransmission
+    m_rtpConfig = std::make_shared<rtc::RtpPacketizationConfig>(
+        m_ssrc, "video-stream", static_cast<uint8_t>(payloadType_), rtc::H264RtpPacketizer::ClockRate);
+    auto packetizer = std::make_shared<rtc::H264RtpPacketizer>(
+        rtc::NalUnit::Separator::StartSequence, m_rtpConfig, MAX_RTP_PAYLOAD_SIZE);
+    packetizer->addToChain(std::make_shared<rtc::RtcpSrReporter>(m_rtpConfig));
+    packetizer->addToChain(std::make_shared<rtc::RtcpNackResponder>());
+    // PLI/FIR from the receiver: the encoder makes its next frame an IDR
+    packetizer->addToChain(std::make_shared<rtc::PliHandler>([this]() {
+        QMetaObject::invokeMethod(this, [this]() { emit keyframeRequested(); });
+        }));
+    packetizer->addToChain(std::make_shared<RtcpFeedbackHandler>(m_ssrc, [this](const RtcpFeedback& feedback) {
+        QMetaObject::invokeMethod(this, [this, feedback]() {
+            m_lastRtcp = feedback;
+            m_lastRtcpUs = m_pacerClock.nsecsElapsed() / 1000;
+            });
+        }));
+    track->setMediaHandler(packetizer);
+
+    bindVideoTrack(track);
+}
+
+void PeerConnectionManager::bindVideoTrack(std::shared_ptr<rtc::Track> track)
+{
+    m_videoTrack = track;
+
+    if (!m_isCaller) {
+        // Receiver side: answer RTCP (receiver reports, NACK/PLI) for the incoming stream
+        m_videoTrack->setMediaHandler(std::make_shared<rtc::RtcpReceivingSession>());
+    }
+
+    m_videoTrack->onOpen([this]() {
+        qDebug("video track open successfully!");
+        QMetaObject::invokeMethod(this, [this]() {
+            emit p2pConnected();
+            if (m_isCaller) {
+                startAbr();
+                emit videoPathOpened();
+            }
+            });
+        });
+
+    m_videoTrack->onMessage([this](rtc::binary data) {
+        // Raw RTP of the incoming video stream (RTCP is consumed by the handler chain)
+        TRACE_PACKET("recv", data.data(), data.size());
+        m_receiver->pushPacket(std::move(data));
+        }, nullptr);
+}
+
+void PeerConnectionManager::setVideoTransport(VideoTransport transport)
+{
+    m_transport = transport;
+}
+
+PeerConnectionManager::VideoTransport PeerConnectionManager::videoTransport() const
+{
+    return m_transport;
 }
 
 void PeerConnectionManager::setupDataChannel()
@@ -88,12 +236,22 @@ void PeerConnectionManager::bindDataChannel(std::shared_ptr<rtc::DataChannel> dc
 {
     m_videoChannel = dc;
 
+    // The pacer stops above highWaterBytes and resumes once SCTP has drained below lowWaterBytes
+    m_videoChannel->setBufferedAmountLowThreshold(m_pacer.config().lowWaterBytes);
+    m_videoChannel->onBufferedAmountLow([this]() {
+        QMetaObject::invokeMethod(this, [this]() { pumpPacer(); });
+        });
+
     m_videoChannel->onOpen([this]() {
         qDebug("datachannel open successfully!");
         if(m_isCaller) sendtest();    
         QMetaObject::invokeMethod(this, [this]() {
             emit p2pConnected();
             if(m_isCaller) emit dataChannelOpened();
+            if(m_isCaller) {
+                startAbr();
+                emit videoPathOpened();
+            }
             });
         });
 
@@ -108,15 +266,10 @@ void PeerConnectionManager::bindDataChannel(std::shared_ptr<rtc::DataChannel> dc
         }
 
         if (std::holds_alternative<rtc::binary>(data)) {
-            auto& binData = std::get<rtc::binary>(data);
-
-            QByteArray qData(reinterpret_cast<const char*>(binData.data()), binData.size());
-
-            qDebug() << "received qData:" << qData.toHex(' ');
-
-            // QMetaObject::invokeMethod(this, [this, qData]() {
-            //     emit encodedFrameReceived(qData);
-            //     });
+            // One hand-packetized RTP packet per message
+            auto& packet = std::get<rtc::binary>(data);
+            TRACE_PACKET("recv", packet.data(), packet.size());
+            m_receiver->pushPacket(std::move(packet));
         }
         });
 }
@@ -131,6 +284,8 @@ void PeerConnectionManager::handleSignalingMessage(const QJsonObject& json)
     QMetaObject::invokeMethod(this, [=]() {
         if (type == SignalingType::REGISTER_SUCCESS) {
             m_myId = data["peerId"].toString();
+            // Older servers do not answer "wire" and keep JSON
+            m_binaryWire = WireFormat::parse(data["wire"]) == WireFormat::Format::BINARY;
             qDebug() << "My ID:" << m_myId;
             emit peersList(data["peers"].toArray());
         }
@@ -158,16 +313,45 @@ void PeerConnectionManager::handleSignalingMessage(const QJsonObject& json)
             m_pc->setRemoteDescription(rtc::Description(sdp, rtc::Description::Type::Answer));
         }
         else if (type == SignalingType::ICE) {
-            std::string cand = data["candidate"].toString().toStdString();
-            std::string mid = data["sdpMid"].toString().toStdString();
-            m_pc->addRemoteCandidate(rtc::Candidate(cand, mid));
+            // One candidate, or a batch in "candidates" (see flushCandidates)
+            const QJsonArray batch = data.contains("candidates") ? data["candidates"].toArray() : QJsonArray{ data };
+            for (const QJsonValue& value : batch) {
+                const QJsonObject candidate = value.toObject();
+                std::string cand = candidate["candidate"].toString().toStdString();
+                std::string mid = candidate["sdpMid"].toString().toStdString();
+                m_pc->addRemoteCandidate(rtc::Candidate(cand, mid));
+            }
         }
         });
 }
 
+void PeerConnectionManager::flushCandidates()
+{
+    m_iceTimer->stop();
+    if (m_pendingCandidates.isEmpty()) {
+        return;
+    }
+    // A lone candidate keeps the single-candidate layout, so older peers still understand it
+    QJsonObject data;
+    if (m_pendingCandidates.size() == 1) {
+        data = m_pendingCandidates.first().toObject();
+    }
+    else {
+        data["candidates"] = m_pendingCandidates;
+    }
+    m_pendingCandidates = QJsonArray();
+    sendSignalingMessage(stype_to_string(SignalingType::ICE), m_targetPeerId, data);
+}
+
 void PeerConnectionManager::sendSignalingMessage(const QString& type, const QString& to, const QJsonObject& data)
 {
     if (m_ws && m_ws->readyState() == rtc::WebSocket::State::Open) {
+        // Fixed header the server routes on, SDP/candidate as a CBOR body: no JSON escaping or parsing
+        if (m_binaryWire) {
+            const QByteArray frame = WireFormat::encode(string_to_stype(type), m_myId, to, data);
+            m_ws->send(reinterpret_cast<const std::byte*>(frame.constData()), static_cast<size_t>(frame.size()));
+            return;
+        }
         QJsonObject msg;
         msg["type"] = type;
         msg["from"] = m_myId;
@@ -206,6 +390,13 @@ void PeerConnectionManager::onConnectServer(const QString& url)
                 handleSignalingMessage(doc.object());
             }
         }
+        else {
+            const rtc::binary& bytes = std::get<rtc::binary>(data);
+            QJsonObject json;
+            if (WireFormat::decode(QByteArray(reinterpret_cast<const char*>(bytes.data()), static_cast<qsizetype>(bytes.size())), json)) {
+                handleSignalingMessage(json);
+            }
+        }
         });
 
     QObject::connect(this, &PeerConnectionManager::peerJoined, this, &PeerConnectionManager::onJoined);
@@ -245,6 +436,7 @@ void PeerConnectionManager::onJoined(const QString& peerId)
 void PeerConnectionManager::registerClient()
 {
     QJsonObject data;
+    data["wire"] = WireFormat::name(WireFormat::Format::BINARY);
     sendSignalingMessage("REGISTER_REQUEST", "Server", data);
 }
 void PeerConnectionManager::sendtest(){
@@ -263,132 +455,87 @@ void PeerConnectionManager::sendtest(){
 
 void PeerConnectionManager::sendEncodedFrame(const QByteArray& encodedData, uint32_t timestamp)
 {
-    // 1. ͨ
-    if (m_videoChannel && m_videoChannel->isOpen()) {
-
-        // 2. ׼ԭʼ
-        const uint8_t* nalData = reinterpret_cast<const uint8_t*>(encodedData.constData());
-        size_t totalSize = encodedData.size();
-        if (totalSize == 0) return;
-
-        // H.264 ͷϢ
-        uint8_t nalHeader = nalData[0];
-        uint8_t nalType = nalHeader & 0x1F;
-
-        // ¡------------------------
-        // RTP Ƭ߼
-
-        //   A: NALUСֱӴ 
-        if (totalSize <= MAX_RTP_PAYLOAD_SIZE) {
-            // ֱӷ libdatachannel Ҫ std::vector<std::byte>
-            std::vector<std::byte> packet(12 + totalSize);
-
-            // ǸֵҪuint8_t* Ҫһָָڴ
-            uint8_t* header = reinterpret_cast<uint8_t*>(packet.data());
-
-            // RTP Header (12 bytes)
-            header[0] = 0x80;
-            header[1] = 0x80 | (payloadType_ & 0x7F); // Marker = 1
-            header[2] = (m_sequenceNumber >> 8) & 0xFF;
-            header[3] = m_sequenceNumber & 0xFF;
-            m_sequenceNumber++;
-
-            header[4] = (currentTimestamp_ >> 24) & 0xFF;
-            header[5] = (currentTimestamp_ >> 16) & 0xFF;
-            header[6] = (currentTimestamp_ >> 8) & 0xFF;
-            header[7] = currentTimestamp_ & 0xFF;
-            header[8] = (m_ssrc >> 24) & 0xFF;
-            header[9] = (m_ssrc >> 16) & 0xFF;
-            header[10] = (m_ssrc >> 8) & 0xFF;
-            header[11] = m_ssrc & 0xFF;
-
-            // Copy Payload
-            std::memcpy(header + 12, nalData, totalSize);
-
-            // 1. ת QByteArray (Ϊ˷ӡ)
-            QByteArray debugHex(reinterpret_cast<const char*>(packet.data()), packet.size());
-
-            // 2. ӡ־ (Type, Size, Hex)     
-            qDebug() << "original binData :" << debugHex.toHex(' ');
-            qDebug("video data send!");
-
-            // ͡
+    if (encodedData.isEmpty()) return;
+
+    if (m_transport == VideoTransport::MediaTrack) {
+        // The track's H264RtpPacketizer splits the Annex-B frame, fragments it (FU-A),
+        // sets the marker on the last packet and feeds the RTCP SR / NACK handlers
+        if (m_videoTrack && m_videoTrack->isOpen()) {
             try {
-                m_videoChannel->send(packet);
+                m_videoTrack->sendFrame(reinterpret_cast<const std::byte*>(encodedData.constData()),
+                    static_cast<size_t>(encodedData.size()), rtc::FrameInfo(timestamp));
             }
-            catch (...) {
-                qDebug() << "Send frame failed. Channel might be busy or closed.";
+            catch (const std::exception& e) {
+                DEBUG() << "Send frame over track failed:" << e.what();
             }
-
-            return;
         }
+        else {
+            DEBUG() << "Video track not open. Dropping encoded frame.";
+        }
+        return;
+    }
 
-        // ===  B: NALU̫Ƭ (FU-A) ===
-        const uint8_t* payloadData = nalData + 1;
-        size_t payloadSize = totalSize - 1;
-        size_t offset = 0;
-
-        while (offset < payloadSize) {
-            size_t chunkSize = std::min(MAX_RTP_PAYLOAD_SIZE - 2, payloadSize - offset);
-            bool isFirst = (offset == 0);
-            bool isLast = (offset + chunkSize == payloadSize);
-
-            // ֱӷ std::vector<std::byte>
-            std::vector<std::byte> packet(12 + 2 + chunkSize);
-
-            // ȡд uint8_t ָ
-            uint8_t* header = reinterpret_cast<uint8_t*>(packet.data());
-
-            // RTP Header
-            header[0] = 0x80;
-            // ֻһƬ Marker=1Ϊ0
-            header[1] = (isLast ? 0x80 : 0x00) | (payloadType_ & 0x7F);
-            header[2] = (m_sequenceNumber >> 8) & 0xFF;
-            header[3] = m_sequenceNumber & 0xFF;
-            m_sequenceNumber++;
-            header[4] = (currentTimestamp_ >> 24) & 0xFF;
-            header[5] = (currentTimestamp_ >> 16) & 0xFF;
-            header[6] = (currentTimestamp_ >> 8) & 0xFF;
-            header[7] = currentTimestamp_ & 0xFF;
-
-            header[8] = (m_ssrc >> 24) & 0xFF;
-            header[9] = (m_ssrc >> 16) & 0xFF;
-            header[10] = (m_ssrc >> 8) & 0xFF;
-            header[11] = m_ssrc & 0xFF;
-
-            // FU Indicator 
-            header[12] = (nalHeader & 0xE0) | 28;
-
-            // FU Header
-            header[13] = nalType;
-            if (isFirst) header[13] |= 0x80; // S bit
-            if (isLast)  header[13] |= 0x40; // E bit
-
-            // Copy Payload Chunk
-            std::memcpy(header + 14, payloadData + offset, chunkSize);
-
-            // 1. ת QByteArray (Ϊ˷ӡ)
-            QByteArray debugHex(reinterpret_cast<const char*>(packet.data()), packet.size());
-
-            // 2. ӡ־ (Type, Size, Hex)     
-            qDebug() << "original binData :" << debugHex.toHex(' ');
-            qDebug("video data send!");
-
-            // ͡
+    if (!m_videoChannel || !m_videoChannel->isOpen()) {
+        //  DataChannel û򿪻ѹرգ
+        DEBUG() << "DataChannel not open. Dropping encoded frame.";
+        return;
+    }
+
+    // RTP timestamp of this frame (90kHz, derived from capture time by the encoder).
+    // All NALs and FU-A fragments of one frame share it
+    m_packetizer.beginFrame(timestamp);
+
+    // Walk the NALs in place; only the last one carries the marker bit
+    const uint8_t* frameData = reinterpret_cast<const uint8_t*>(encodedData.constData());
+    const uint8_t* frameEnd = frameData + encodedData.size();
+    bool keyframe = false;
+    NalScanner::split(frameData, static_cast<size_t>(encodedData.size()), [&](const NalUnit& nal) {
+        const bool lastNal = NalScanner::findStartCode(nal.data + nal.size, frameEnd) == frameEnd;
+        keyframe = keyframe || nal.type() == 5; // IDR
+        sendNalOverDataChannel(nal, lastNal);
+    });
+
+    // The whole frame is queued (or dropped) at once, then sent at the pacing rate
+    m_pacer.endFrame(keyframe, m_pacerClock.nsecsElapsed() / 1000);
+    pumpPacer();
+}
+
+void PeerConnectionManager::sendNalOverDataChannel(const NalUnit& nal, bool lastNalOfFrame)
+{
+    // ֱдػȽ pacer ܳ֡ pumpPacer() ෢
+    m_packetizer.packetize(nal, lastNalOfFrame, m_packetPool, [this](RtpPacketPool::Packet&& packet) {
+        m_pacer.addPacket(std::move(packet));
+    });
+}
+
+void PeerConnectionManager::pumpPacer()
+{
+    if (!m_videoChannel || !m_videoChannel->isOpen()) {
+        m_pacer.clear();
+        return;
+    }
+
+    const RtpPacer::PumpResult result = m_pacer.pump(m_pacerClock.nsecsElapsed() / 1000,
+        m_videoChannel->bufferedAmount(), [this](const RtpPacketPool::Packet& packet) {
+            // ӡ LOG_LEVEL=TRACE PACKET_TRACE_SAMPLE Ʋʣ
+            TRACE_PACKET("send", packet.data(), packet.size());
+
+            // ͡send() ڲ´غ󻺳 packet ӻص
             try {
-                m_videoChannel->send(packet);
+                m_videoChannel->send(packet.data(), packet.size());
+                return true;
             }
-            catch (...) {
-                qDebug() << "Send frame failed. Channel might be busy or closed.";
+            catch (const std::exception& e) {
+                DEBUG() << "Send packet failed, dropping until the next keyframe:" << e.what();
+                return false;
             }
+        });
 
-            offset += chunkSize;
-        }
-    }else {
-        //  DataChannel û򿪻ѹرգ
-		qDebug() << "DataChannel not open. Dropping encoded frame.";
+    // Blocked on bufferedAmount: onBufferedAmountLow calls back in
+    if (result.nextUs >= 0 && !result.waitingForBuffer) {
+        const qint64 waitUs = result.nextUs - m_pacerClock.nsecsElapsed() / 1000;
+        m_pacerTimer->start(static_cast<int>(qMax<qint64>(0, (waitUs + 999) / 1000)));
     }
-        
 }
 
 void PeerConnectionManager::stop()
@@ -407,7 +554,30 @@ void PeerConnectionManager::stop()
         // ָ
         m_videoChannel.reset();
     }
+    // ûȥİص
+    m_abrTimer->stop();
+    m_pacerTimer->stop();
+    m_pacer.clear();
+    // Candidates of the closed connection must not reach the next one, including those
+    // still queued to the main thread
+    m_iceTimer->stop();
+    m_pendingCandidates = QJsonArray();
+    ++m_iceGeneration;
     
+    // رƵ
+    if (m_videoTrack) {
+        try {
+            if (m_videoTrack->isOpen()) m_videoTrack->close();
+        } catch (const std::exception& e) {
+            qWarning() << "Error closing video track:" << e.what();
+        }
+        m_videoTrack.reset();
+        m_rtpConfig.reset();
+    }
+
+    // սն˵Ķͽ״̬
+    QMetaObject::invokeMethod(m_receiver, &VideoReceiver::reset, Qt::QueuedConnection);
+
     // 2. ر PeerConnection
     if (m_pc) {
         // Ͽײ WebRTC ӡ
@@ -564,3 +734,71 @@ QString PeerConnectionManager::target() const
 {
     return m_targetPeerId;
 }
+
+VideoReceiver::Stats PeerConnectionManager::receiveStats() const
+{
+    return m_receiver->stats();
+}
+
+void PeerConnectionManager::setVideoBitrate(int bitrate)
+{
+    m_pacer.setBitrate(bitrate);
+}
+
+RtpPacer::Stats PeerConnectionManager::pacerStats() const
+{
+    return m_pacer.stats();
+}
+
+void PeerConnectionManager::startAbr()
+{
+    // The first target goes out before videoPathOpened so the encoder is created with it
+    m_abr.reset();
+    m_abrTarget = m_abr.target();
+    m_abrPrevUs = m_pacerClock.nsecsElapsed() / 1000;
+    m_abrPrevBytesSent = m_pacer.stats().bytesSent;
+    m_lastRtcpUs = -1;
+    m_minRttMs = -1.0;
+
+    m_pacer.setBitrate(m_abrTarget.bitrate);
+    emit videoTargetChanged(m_abrTarget.width, m_abrTarget.height, m_abrTarget.fps, m_abrTarget.bitrate);
+    m_abrTimer->start();
+}
+
+void PeerConnectionManager::onAbrTick()
+{
+    const qint64 nowUs = m_pacerClock.nsecsElapsed() / 1000;
+    AbrController::Feedback feedback;
+
+    if (m_transport == VideoTransport::DataChannel && m_videoChannel) {
+        // Everything not yet on the wire, in milliseconds of video at the current target
+        const RtpPacer::Stats pacer = m_pacer.stats();
+        const size_t queued = pacer.queuedBytes + m_videoChannel->bufferedAmount();
+        feedback.queueDelayMs = queued * 8000.0 / qMax(1, m_abrTarget.bitrate);
+        feedback.framesDropped = pacer.framesDropped;
+        if (nowUs > m_abrPrevUs) {
+            feedback.sentBitrate = (pacer.bytesSent - m_abrPrevBytesSent) * 8.0 * 1000000.0 / (nowUs - m_abrPrevUs);
+        }
+        m_abrPrevBytesSent = pacer.bytesSent;
+    }
+
+    // Media track: loss from the latest receiver report, queueing from RTT above its minimum.
+    // Reports come about once a second, so ticks in between reuse the last one; once it is
+    // stale the feedback stays unknown and the controller holds the rate.
+    if (m_lastRtcpUs >= 0 && nowUs - m_lastRtcpUs <= RTCP_MAX_AGE_US) {
+        feedback.lossFraction = m_lastRtcp.lossFraction;
+        feedback.rttMs = m_lastRtcp.rttMs;
+        if (m_lastRtcp.rttMs >= 0.0) {
+            if (m_minRttMs < 0.0 || m_lastRtcp.rttMs < m_minRttMs) m_minRttMs = m_lastRtcp.rttMs;
+            feedback.queueDelayMs = qMax(feedback.queueDelayMs, m_lastRtcp.rttMs - m_minRttMs);
+        }
+    }
+    m_abrPrevUs = nowUs;
+
+    const AbrController::Target target = m_abr.update(feedback, nowUs);
+    if (target != m_abrTarget) {
+        m_abrTarget = target;
+        m_pacer.setBitrate(target.bitrate);
+        emit videoTargetChanged(target.width, target.height, target.fps, target.bitrate);
+    }
+}
@@ -1,24 +1,53 @@
 #pragma once
 #include <QObject>
+#include <QElapsedTimer>
+#include <QVideoFrame>
+#include <atomic>
 #include <memory>
 #include <rtc/rtc.hpp>
 
 #include "signaling-server/src/Common.hpp"
+#include "signaling-server/src/WireFormat.hpp"
+#include "VideoReceiver.h"
+#include "RtpPacketizer.h"
+#include "RtpPacer.h"
+#include "AbrController.h"
+#include "RtcpFeedbackHandler.h"
 
 class WsSignalingClient;
+class QThread;
+class QTimer;
+struct NalUnit;
 
 class PeerConnectionManager : public QObject {
     Q_OBJECT
 public:
+    // How encoded video reaches the peer
+    enum class VideoTransport {
+        MediaTrack,   // SRTP media track, libdatachannel H264 packetizer + RTCP SR/NACK
+        DataChannel   // RTP packetized by hand and tunnelled over an SCTP DataChannel
+    };
+
     PeerConnectionManager(QObject* parent = nullptr);
     ~PeerConnectionManager();
 
+    // Must be called before start(); the callee follows whatever the offer contains
+    void setVideoTransport(VideoTransport transport);
+    VideoTransport videoTransport() const;
+
     void registerClient();
     void start(const QString& targetId);
     void sendEncodedVideoFrame(const QByteArray& encodedData, uint32_t timestamp);
     QString id() const;
     QString target() const;
 
+    // Receive side: jitter buffer, decode time and the delay the buffer adds (thread-safe)
+    VideoReceiver::Stats receiveStats() const;
+
+    // DataChannel path: the pacer sends at 1.5-2.5x this rate, set it to the encoder's target
+    void setVideoBitrate(int bitrate);
+    RtpPacer::Stats pacerStats() const;
+
 signals:
     void signalingConnected();
     void signalingError(const QString& msg);
@@ -33,6 +62,10 @@ signals:
     void errorOccurred(const QString& msg);
     void messageReceived(const QString& msg); 
     void dataChannelOpened();
+    void videoPathOpened();  // caller side: track or DataChannel is ready for frames
+    void remoteFrameReady(const QVideoFrame& frame);  // callee side: decoded picture, emitted on the decode thread
+    void videoTargetChanged(int width, int height, int fps, int bitrate);  // caller side: ABR retuned the encoder
+    void keyframeRequested();  // caller side: the receiver sent a PLI, the next frame should be an IDR
 
 public:
     void onConnectServer(const QString& url);
@@ -46,8 +79,15 @@ private:
     void sendSignalingMessage(const QString& type, const QString& to, const QJsonObject& data);
     void sendtest();
     void createPeerConnection();
+    void flushCandidates();
     void setupDataChannel();
     void bindDataChannel(std::shared_ptr<rtc::DataChannel> dc);
+    void setupVideoTrack();
+    void bindVideoTrack(std::shared_ptr<rtc::Track> track);
+    void sendNalOverDataChannel(const NalUnit& nal, bool lastNalOfFrame);
+    void pumpPacer();
+    void startAbr();
+    void onAbrTick();
     void sendRtpPacket(const std::vector<uint8_t>& payload, bool marker);
     
     
@@ -56,18 +96,53 @@ private:
     std::shared_ptr<rtc::WebSocket> m_ws;
     std::shared_ptr<rtc::PeerConnection> m_pc;
     std::shared_ptr<rtc::DataChannel> m_videoChannel;
+    std::shared_ptr<rtc::Track> m_videoTrack;
+    std::shared_ptr<rtc::RtpPacketizationConfig> m_rtpConfig;
+    VideoTransport m_transport = VideoTransport::MediaTrack;
+
+    // Incoming video is reassembled and decoded off the UI thread
+    QThread* m_decodeThread = nullptr;
+    VideoReceiver* m_receiver = nullptr;
 
     QString m_serverUrl;
     QString m_myId;
     QString m_targetPeerId;
+    // Set by REGISTER_SUCCESS; read by the libdatachannel threads that send ICE and SDP
+    std::atomic<bool> m_binaryWire{ false };
+
+    // ICE trickle: candidates gathered within one window go out as a single ICE message.
+    // Only touched on the main thread; flushed early when gathering completes.
+    static constexpr int ICE_BATCH_WINDOW_MS = 5;
+    QTimer* m_iceTimer = nullptr;
+    QJsonArray m_pendingCandidates;
+    quint64 m_iceGeneration = 0;   // Current connection; queued candidates of older ones are dropped
     bool m_isCaller; 
     uint16_t sequenceNumber_ = 0;
     uint32_t ssrc_ = 0;
     // RTP Ҫ״̬
-    uint16_t m_sequenceNumber = 0;
     uint32_t m_ssrc = 323010; //  ID
-    uint32_t currentTimestamp_ = 0;
 
     const size_t MAX_RTP_PAYLOAD_SIZE = 1100; // ռ IP/UDP/RTP ͷΪ 1100
     const int payloadType_ = 96;
+
+    // DataChannel ·ķأһ 1080p ؼ֡Լ 140 
+    static constexpr size_t PACKET_POOL_PREALLOCATE = 256;
+    RtpPacketizer m_packetizer;
+    RtpPacketPool m_packetPool;
+
+    // ͽƣͰ + bufferedAmount ѹؼ֡һԹ SCTP
+    RtpPacer m_pacer;
+    QTimer* m_pacerTimer = nullptr;
+    QElapsedTimer m_pacerClock;
+
+    // Ӧʣʱܴ䷴pacer  / RTCP RRĿ
+    AbrController m_abr;
+    AbrController::Target m_abrTarget;
+    QTimer* m_abrTimer = nullptr;
+    qint64 m_abrPrevUs = 0;
+    quint64 m_abrPrevBytesSent = 0;
+    RtcpFeedback m_lastRtcp;
+    static constexpr qint64 RTCP_MAX_AGE_US = 3000000;   // older receiver reports count as no feedback
+    qint64 m_lastRtcpUs = -1;                             // m_pacerClock time of m_lastRtcp, -1 if none
+    double m_minRttMs = -1.0;
 };
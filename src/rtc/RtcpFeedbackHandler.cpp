@@ -0,0 +1,87 @@
+#include "RtcpFeedbackHandler.h"
+#include <chrono>
+
+namespace
+{
+    const uint8_t RTCP_SR = 200;
+    const uint8_t RTCP_RR = 201;
+    const double RTP_VIDEO_CLOCK = 90000.0;
+
+    uint32_t readBe32(const void* p)
+    {
+        const uint8_t* b = static_cast<const uint8_t*>(p);
+        return (static_cast<uint32_t>(b[0]) << 24) | (static_cast<uint32_t>(b[1]) << 16) |
+            (static_cast<uint32_t>(b[2]) << 8) | b[3];
+    }
+
+    // Middle 32 bits of the current NTP time, the unit of LSR/DLSR (1/65536 s)
+    uint32_t ntpMiddle32()
+    {
+        using namespace std::chrono;
+        const uint64_t NTP_EPOCH_OFFSET = 2208988800ull; // 1900 -> 1970
+        const auto now = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+        const uint64_t seconds = static_cast<uint64_t>(now / 1000000) + NTP_EPOCH_OFFSET;
+        const uint64_t fraction = (static_cast<uint64_t>(now % 1000000) << 32) / 1000000;
+        return static_cast<uint32_t>(((seconds << 32) | fraction) >> 16);
+    }
+}
+
+RtcpFeedbackHandler::RtcpFeedbackHandler(rtc::SSRC ssrc, Callback callback)
+    : m_ssrc(ssrc), m_callback(std::move(callback))
+{}
+
+void RtcpFeedbackHandler::incoming(rtc::message_vector& messages, const rtc::message_callback& send)
+{
+    (void)send;
+    for (const auto& message : messages) {
+        if (message && message->type == rtc::Message::Control) {
+            parseCompound(message->data(), message->size());
+        }
+    }
+}
+
+void RtcpFeedbackHandler::parseCompound(const std::byte* data, size_t size)
+{
+    size_t offset = 0;
+    while (offset + sizeof(rtc::RtcpHeader) <= size) {
+        auto header = reinterpret_cast<const rtc::RtcpHeader*>(data + offset);
+        const size_t length = header->lengthInBytes();
+        if (length < sizeof(rtc::RtcpHeader) || offset + length > size) return;
+
+        const rtc::RtcpReportBlock* first = nullptr;
+        size_t blocksOffset = 0;
+        if (header->payloadType() == RTCP_RR) {
+            blocksOffset = 8; // header + reporter SSRC
+        }
+        else if (header->payloadType() == RTCP_SR) {
+            blocksOffset = 28; // header + sender SSRC + sender info
+        }
+
+        if (blocksOffset) {
+            for (uint8_t i = 0; i < header->reportCount(); i++) {
+                const size_t blockOffset = blocksOffset + i * sizeof(rtc::RtcpReportBlock);
+                if (blockOffset + sizeof(rtc::RtcpReportBlock) > length) break;
+                auto block = reinterpret_cast<const rtc::RtcpReportBlock*>(data + offset + blockOffset);
+                if (block->getSSRC() == m_ssrc) {
+                    first = block;
+                    break;
+                }
+            }
+        }
+
+        if (first && m_callback) {
+            RtcpFeedback feedback;
+            feedback.lossFraction = first->getFractionLost() / 256.0;
+            feedback.jitterMs = first->jitter() * 1000.0 / RTP_VIDEO_CLOCK;
+            // LSR/DLSR straight from the wire, both in 1/65536 s (middle 32 bits of NTP)
+            const uint32_t lsr = readBe32(&first->_lastReport);
+            const uint32_t dlsr = readBe32(&first->_delaySinceLastReport);
+            if (lsr != 0) {
+                const uint32_t rtt = ntpMiddle32() - lsr - dlsr;
+                feedback.rttMs = rtt * 1000.0 / 65536.0;
+            }
+            m_callback(feedback);
+        }
+        offset += length;
+    }
+}
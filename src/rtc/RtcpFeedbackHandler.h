@@ -0,0 +1,30 @@
+#pragma once
+#include <functional>
+#include <rtc/rtc.hpp>
+
+// Loss/delay feedback for the sending side, taken from the RTCP receiver report blocks
+// (in RR or SR packets) that describe our SSRC.
+struct RtcpFeedback
+{
+    double lossFraction = 0.0;  // fraction lost since the previous report (RFC 3550 6.4.1)
+    double jitterMs = 0.0;      // interarrival jitter at the receiver
+    double rttMs = -1.0;        // from LSR/DLSR, < 0 if the receiver has not seen an SR yet
+};
+
+// Media handler placed in the sender's chain next to RtcpSrReporter. It only observes incoming
+// RTCP and passes everything through; the callback runs on a libdatachannel thread.
+class RtcpFeedbackHandler final : public rtc::MediaHandler
+{
+public:
+    using Callback = std::function<void(const RtcpFeedback&)>;
+
+    RtcpFeedbackHandler(rtc::SSRC ssrc, Callback callback);
+
+    void incoming(rtc::message_vector& messages, const rtc::message_callback& send) override;
+
+private:
+    void parseCompound(const std::byte* data, size_t size);
+
+    rtc::SSRC m_ssrc;
+    Callback m_callback;
+};
@@ -0,0 +1,106 @@
+#include "RtpDepacketizer.h"
+
+namespace
+{
+    const uint8_t NAL_TYPE_IDR = 5;
+    const uint8_t NAL_TYPE_STAP_A = 24;
+    const uint8_t NAL_TYPE_FU_A = 28;
+
+    const uint8_t START_CODE[4] = { 0x00, 0x00, 0x00, 0x01 };
+
+    void appendNal(std::vector<uint8_t>& out, const uint8_t* nal, size_t size)
+    {
+        out.insert(out.end(), START_CODE, START_CODE + sizeof(START_CODE));
+        out.insert(out.end(), nal, nal + size);
+    }
+}
+
+bool RtpDepacketizer::parse(const uint8_t* data, size_t size, RtpPacket& packet)
+{
+    if (size < 12) return false;
+    if ((data[0] >> 6) != 2) return false; // version
+
+    // RTCP shares the port/channel: PT 200..204 shows up as 72..76 with the marker bit set
+    const uint8_t pt = data[1] & 0x7F;
+    if (pt >= 72 && pt <= 76) return false;
+
+    size_t offset = 12 + 4 * static_cast<size_t>(data[0] & 0x0F); // CSRC list
+    if (data[0] & 0x10) { // header extension
+        if (offset + 4 > size) return false;
+        const size_t extWords = (static_cast<size_t>(data[offset + 2]) << 8) | data[offset + 3];
+        offset += 4 + extWords * 4;
+    }
+
+    size_t end = size;
+    if (data[0] & 0x20) { // padding, the last byte holds the count
+        const uint8_t padding = data[size - 1];
+        if (padding == 0 || padding > size) return false;
+        end -= padding;
+    }
+    if (offset >= end) return false;
+
+    packet.marker = (data[1] & 0x80) != 0;
+    packet.payloadType = pt;
+    packet.sequenceNumber = static_cast<uint16_t>((data[2] << 8) | data[3]);
+    packet.timestamp = (static_cast<uint32_t>(data[4]) << 24) | (static_cast<uint32_t>(data[5]) << 16) |
+        (static_cast<uint32_t>(data[6]) << 8) | data[7];
+    packet.ssrc = (static_cast<uint32_t>(data[8]) << 24) | (static_cast<uint32_t>(data[9]) << 16) |
+        (static_cast<uint32_t>(data[10]) << 8) | data[11];
+    packet.payload = data + offset;
+    packet.payloadSize = end - offset;
+    return true;
+}
+
+bool RtpDepacketizer::startsNal(const RtpPacket& packet)
+{
+    if (packet.payloadSize == 0) return false;
+    const uint8_t type = packet.payload[0] & 0x1F;
+    if (type == NAL_TYPE_FU_A) {
+        return packet.payloadSize >= 2 && (packet.payload[1] & 0x80);
+    }
+    return true;
+}
+
+bool RtpDepacketizer::appendToAccessUnit(const RtpPacket& packet, std::vector<uint8_t>& accessUnit, bool& keyframe)
+{
+    const uint8_t* p = packet.payload;
+    const size_t size = packet.payloadSize;
+    if (size == 0) return false;
+
+    const uint8_t type = p[0] & 0x1F;
+
+    if (type >= 1 && type <= 23) { // single NAL unit packet
+        if (type == NAL_TYPE_IDR) keyframe = true;
+        appendNal(accessUnit, p, size);
+        return true;
+    }
+
+    if (type == NAL_TYPE_STAP_A) { // [STAP-A hdr][size16][NAL]...
+        size_t offset = 1;
+        while (offset + 2 <= size) {
+            const size_t nalSize = (static_cast<size_t>(p[offset]) << 8) | p[offset + 1];
+            offset += 2;
+            if (nalSize == 0 || offset + nalSize > size) return false;
+            if ((p[offset] & 0x1F) == NAL_TYPE_IDR) keyframe = true;
+            appendNal(accessUnit, p + offset, nalSize);
+            offset += nalSize;
+        }
+        return true;
+    }
+
+    if (type == NAL_TYPE_FU_A) { // [FU indicator][FU header][fragment]
+        if (size < 2) return false;
+        const uint8_t fuHeader = p[1];
+        const uint8_t nalType = fuHeader & 0x1F;
+        if (nalType == NAL_TYPE_IDR) keyframe = true;
+
+        if (fuHeader & 0x80) { // S bit: rebuild the original NAL header
+            accessUnit.insert(accessUnit.end(), START_CODE, START_CODE + sizeof(START_CODE));
+            accessUnit.push_back(static_cast<uint8_t>((p[0] & 0xE0) | nalType));
+        }
+        accessUnit.insert(accessUnit.end(), p + 2, p + size);
+        return true;
+    }
+
+    return false; // STAP-B, MTAP, FU-B: packetization mode 2 is never negotiated
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A parsed RTP packet (RFC 3550). payload points into the buffer that was parsed.
+struct RtpPacket
+{
+    uint16_t sequenceNumber = 0;
+    uint32_t timestamp = 0;
+    uint32_t ssrc = 0;
+    uint8_t payloadType = 0;
+    bool marker = false;
+
+    const uint8_t* payload = nullptr;
+    size_t payloadSize = 0;
+};
+
+// H.264 RTP depacketization (RFC 6184): single NAL unit, STAP-A and FU-A packets.
+namespace RtpDepacketizer
+{
+    // Parses the fixed header, CSRC list, header extension and padding.
+    // Returns false for anything that is not a well-formed RTP packet (including RTCP).
+    bool parse(const uint8_t* data, size_t size, RtpPacket& packet);
+
+    // True if the payload begins a NAL unit (single NAL, STAP-A or the first FU-A fragment),
+    // i.e. a frame may start with this packet.
+    bool startsNal(const RtpPacket& packet);
+
+    // Appends the payload of one packet to an Annex-B access unit. Packets of one frame must be
+    // fed in sequence order. Sets keyframe when an IDR slice is seen.
+    // Returns false if the payload is malformed or uses an unsupported packetization mode.
+    bool appendToAccessUnit(const RtpPacket& packet, std::vector<uint8_t>& accessUnit, bool& keyframe);
+}
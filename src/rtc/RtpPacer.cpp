@@ -0,0 +1,133 @@
+#include "RtpPacer.h"
+#include <algorithm>
+
+RtpPacer::RtpPacer() : RtpPacer(Config()) {}
+
+RtpPacer::RtpPacer(const Config& config) : m_config(config)
+{
+    m_config.pacingFactor = std::min(std::max(m_config.pacingFactor, 1.5), 2.5);
+    m_building.reserve(256);
+    m_tokens = static_cast<double>(m_config.burstBytes);
+}
+
+void RtpPacer::setBitrate(int bitrate)
+{
+    if (bitrate > 0) m_config.bitrate = bitrate;
+}
+
+double RtpPacer::bytesPerSecond() const
+{
+    return m_config.pacingFactor * m_config.bitrate / 8.0;
+}
+
+void RtpPacer::refill(int64_t nowUs)
+{
+    if (m_lastRefillUs >= 0 && nowUs > m_lastRefillUs) {
+        m_tokens += bytesPerSecond() * (nowUs - m_lastRefillUs) / 1000000.0;
+        m_tokens = std::min(m_tokens, static_cast<double>(m_config.burstBytes));
+    }
+    m_lastRefillUs = nowUs;
+}
+
+void RtpPacer::addPacket(RtpPacketPool::Packet&& packet)
+{
+    m_building.push_back(std::move(packet));
+}
+
+void RtpPacer::endFrame(bool keyframe, int64_t nowUs)
+{
+    refill(nowUs);
+
+    if (m_building.empty()) return;
+    m_stats.framesQueued++;
+
+    size_t bytes = 0;
+    for (const auto& packet : m_building) bytes += packet.size();
+
+    // Would this frame sit in the queue for longer than allowed? Then the queue is the problem:
+    // throw away what has not started yet, whole frames only
+    const double delayMs = (m_queuedBytes + bytes) * 1000.0 / bytesPerSecond();
+    if (delayMs > m_config.maxQueueDelayMs && !m_frames.empty()) {
+        dropUnstartedFrames();
+        m_dropUntilKeyframe = true;
+    }
+
+    // Everything after a dropped frame references it; only an IDR makes the stream decodable again
+    if (keyframe) m_dropUntilKeyframe = false;
+    if (m_dropUntilKeyframe) {
+        m_building.clear(); // buffers go back to the pool
+        m_stats.framesDropped++;
+        return;
+    }
+
+    QueuedFrame frame;
+    frame.id = m_nextFrameId++;
+    frame.packets = m_building.size();
+    frame.bytes = bytes;
+    m_frames.push_back(frame);
+
+    for (auto& packet : m_building) {
+        m_queue.push_back({ std::move(packet), frame.id });
+    }
+    m_building.clear();
+    m_queuedBytes += bytes;
+}
+
+void RtpPacer::onSent(size_t size, bool ok)
+{
+    QueuedFrame& frame = m_frames.front();
+    frame.started = true;
+    m_queue.pop_front();   // releases the buffer to the pool
+
+    m_tokens -= static_cast<double>(size);
+    m_queuedBytes -= size;
+    m_stats.packetsSent++;
+    m_stats.bytesSent += size;
+    const bool frameDone = --frame.packets == 0;
+    if (frameDone) {
+        m_stats.framesSent++;
+        m_frames.pop_front();
+    }
+
+    if (!ok) {
+        // The receiver can't decode anything until the next keyframe; don't spend bandwidth on it
+        m_stats.sendErrors++;
+        dropUnstartedFrames();
+        m_dropUntilKeyframe = true;
+    }
+}
+
+void RtpPacer::dropUnstartedFrames()
+{
+    // The first frame may be half sent; it has to finish or the receiver sees a broken NAL
+    auto keep = m_frames.begin();
+    if (keep != m_frames.end() && keep->started) ++keep;
+
+    for (auto it = keep; it != m_frames.end(); ++it) {
+        m_queuedBytes -= it->bytes;
+        m_stats.framesDropped++;
+    }
+    const size_t keepFrames = static_cast<size_t>(keep - m_frames.begin());
+    const size_t keepPackets = keepFrames ? m_frames.front().packets : 0;
+    m_frames.erase(keep, m_frames.end());
+    m_queue.erase(m_queue.begin() + static_cast<std::ptrdiff_t>(keepPackets), m_queue.end());
+}
+
+RtpPacer::Stats RtpPacer::stats() const
+{
+    Stats s = m_stats;
+    s.queuedBytes = m_queuedBytes;
+    s.queueDelayMs = m_queuedBytes * 1000.0 / bytesPerSecond();
+    return s;
+}
+
+void RtpPacer::clear()
+{
+    m_building.clear();
+    m_queue.clear();
+    m_frames.clear();
+    m_queuedBytes = 0;
+    m_dropUntilKeyframe = false;
+    m_tokens = static_cast<double>(m_config.burstBytes);
+    m_lastRefillUs = -1;
+}
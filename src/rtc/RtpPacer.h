@@ -0,0 +1,122 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "RtpPacketPool.h"
+
+// Send-side pacer between the RTP packetizer and the DataChannel.
+//
+// Packets leave through a token bucket refilled at pacingFactor * target bitrate, and only while
+// the channel's bufferedAmount stays below a high-water mark (resume on onBufferedAmountLow).
+// When the queue would hold more than maxQueueDelayMs of data, whole frames that have not started
+// sending are dropped, and so is every following frame up to the next keyframe; a frame is never
+// cut in the middle of a NAL unit.
+//
+// Not thread-safe; times are microseconds on one monotonic clock supplied by the caller.
+class RtpPacer
+{
+public:
+    struct Config
+    {
+        int bitrate = 1000000;                 // encoder target, bit/s
+        double pacingFactor = 2.0;             // clamped to [1.5, 2.5]
+        size_t burstBytes = 16 * 1024;         // bucket depth, lets a small frame go out at once
+        size_t highWaterBytes = 256 * 1024;    // stop feeding the channel above this bufferedAmount
+        size_t lowWaterBytes = 64 * 1024;      // threshold for onBufferedAmountLow
+        int maxQueueDelayMs = 300;
+    };
+
+    struct Stats
+    {
+        uint64_t framesQueued = 0;
+        uint64_t framesSent = 0;
+        uint64_t framesDropped = 0;
+        uint64_t packetsSent = 0;
+        uint64_t bytesSent = 0;
+        uint64_t sendErrors = 0;
+        size_t queuedBytes = 0;
+        double queueDelayMs = 0.0;             // time the queued bytes need at the pacing rate
+    };
+
+    // What the owner has to do after pump()
+    struct PumpResult
+    {
+        int64_t nextUs = -1;                   // call pump() again at this time, -1 = nothing to wait for
+        bool waitingForBuffer = false;         // blocked on bufferedAmount, wait for onBufferedAmountLow
+    };
+
+    RtpPacer();
+    explicit RtpPacer(const Config& config);
+
+    void setBitrate(int bitrate);
+    const Config& config() const { return m_config; }
+
+    // Collects the packets of one frame, then queues (or drops) the frame as a whole
+    void addPacket(RtpPacketPool::Packet&& packet);
+    void endFrame(bool keyframe, int64_t nowUs);
+
+    // Sends as much as the bucket and the channel allow.
+    // send(const RtpPacketPool::Packet&) returns false if the channel rejected the packet.
+    template<class Send>
+    PumpResult pump(int64_t nowUs, size_t bufferedAmount, Send&& send)
+    {
+        refill(nowUs);
+
+        PumpResult result;
+        while (!m_queue.empty()) {
+            if (bufferedAmount >= m_config.highWaterBytes) {
+                result.waitingForBuffer = true;
+                return result;
+            }
+            if (m_tokens < 0.0) {
+                result.nextUs = nowUs + static_cast<int64_t>(-m_tokens * 1000000.0 / bytesPerSecond()) + 1;
+                return result;
+            }
+
+            QueuedPacket& front = m_queue.front();
+            const size_t size = front.packet.size();
+            const bool ok = send(front.packet);
+            onSent(size, ok);
+            bufferedAmount += size;
+        }
+        return result;
+    }
+
+    Stats stats() const;
+    void clear();
+
+private:
+    struct QueuedPacket
+    {
+        RtpPacketPool::Packet packet;
+        uint64_t frameId = 0;
+    };
+
+    struct QueuedFrame
+    {
+        uint64_t id = 0;
+        size_t packets = 0;
+        size_t bytes = 0;
+        bool started = false;
+    };
+
+    double bytesPerSecond() const;
+    void refill(int64_t nowUs);
+    void onSent(size_t size, bool ok);
+    void dropUnstartedFrames();
+
+    Config m_config;
+    std::vector<RtpPacketPool::Packet> m_building;  // reused, keeps its capacity
+    std::deque<QueuedPacket> m_queue;
+    std::deque<QueuedFrame> m_frames;
+    uint64_t m_nextFrameId = 0;
+    size_t m_queuedBytes = 0;
+    bool m_dropUntilKeyframe = false;
+
+    double m_tokens = 0.0;
+    int64_t m_lastRefillUs = -1;
+
+    Stats m_stats;
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Fixed-size RTP packet buffers recycled through a free list.
+//
+// Every buffer holds one packet of up to `capacity` bytes (RTP header + FU-A header + payload),
+// so the DataChannel send path never touches the allocator once the pool is warm. A Packet
+// returns its buffer when it is destroyed, typically right after DataChannel::send() has copied
+// it. acquire()/release may run on different threads; the pool must outlive its packets.
+class RtpPacketPool
+{
+    struct Block
+    {
+        explicit Block(size_t capacity) : bytes(new std::byte[capacity]) {}
+        std::unique_ptr<std::byte[]> bytes;
+    };
+
+public:
+    // Move-only handle to one pooled buffer
+    class Packet
+    {
+    public:
+        Packet() = default;
+        Packet(Packet&& other) noexcept { *this = std::move(other); }
+        Packet& operator=(Packet&& other) noexcept
+        {
+            if (this != &other) {
+                reset();
+                m_pool = other.m_pool;
+                m_block = other.m_block;
+                m_size = other.m_size;
+                other.m_pool = nullptr;
+                other.m_block = nullptr;
+                other.m_size = 0;
+            }
+            return *this;
+        }
+        Packet(const Packet&) = delete;
+        Packet& operator=(const Packet&) = delete;
+        ~Packet() { reset(); }
+
+        std::byte* data() { return m_block->bytes.get(); }
+        const std::byte* data() const { return m_block->bytes.get(); }
+        uint8_t* bytes() { return reinterpret_cast<uint8_t*>(data()); }
+        size_t size() const { return m_size; }
+        void setSize(size_t size) { m_size = size; }
+        explicit operator bool() const { return m_block != nullptr; }
+
+        // Gives the buffer back to the pool early
+        void reset()
+        {
+            if (m_pool) m_pool->release(m_block);
+            m_pool = nullptr;
+            m_block = nullptr;
+            m_size = 0;
+        }
+
+    private:
+        friend class RtpPacketPool;
+        Packet(RtpPacketPool* pool, Block* block) : m_pool(pool), m_block(block) {}
+
+        RtpPacketPool* m_pool = nullptr;
+        Block* m_block = nullptr;
+        size_t m_size = 0;
+    };
+
+    explicit RtpPacketPool(size_t capacity, size_t preallocate = 0) : m_capacity(capacity)
+    {
+        m_all.reserve(preallocate);
+        m_free.reserve(preallocate);
+        for (size_t i = 0; i < preallocate; i++) {
+            m_all.push_back(std::make_unique<Block>(m_capacity));
+            m_free.push_back(m_all.back().get());
+        }
+    }
+
+    RtpPacketPool(const RtpPacketPool&) = delete;
+    RtpPacketPool& operator=(const RtpPacketPool&) = delete;
+
+    // Takes a free buffer, growing the pool only if every buffer is in flight
+    Packet acquire()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_free.empty()) {
+            m_all.push_back(std::make_unique<Block>(m_capacity));
+            m_free.reserve(m_all.capacity());
+            return Packet(this, m_all.back().get());
+        }
+        Block* block = m_free.back();
+        m_free.pop_back();
+        return Packet(this, block);
+    }
+
+    size_t capacity() const { return m_capacity; }
+
+    // Buffers ever allocated; stays flat in steady state
+    size_t allocated() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_all.size();
+    }
+
+private:
+    void release(Block* block)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_free.push_back(block); // never reallocates: reserved to m_all's capacity
+    }
+
+    const size_t m_capacity;
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Block>> m_all;
+    std::vector<Block*> m_free;
+};
@@ -0,0 +1,26 @@
+#include "RtpPacketizer.h"
+
+RtpPacketizer::RtpPacketizer(uint32_t ssrc, uint8_t payloadType, size_t maxPayloadSize)
+    : m_maxPayloadSize(maxPayloadSize)
+{
+    m_header[0] = 0x80;                 // V=2, P=0, X=0, CC=0
+    m_header[1] = payloadType & 0x7F;   // M=0
+    m_header[2] = 0;                    // sequence number, patched per packet
+    m_header[3] = 0;
+    m_header[4] = 0;                    // timestamp, patched per frame
+    m_header[5] = 0;
+    m_header[6] = 0;
+    m_header[7] = 0;
+    m_header[8] = static_cast<uint8_t>(ssrc >> 24);
+    m_header[9] = static_cast<uint8_t>(ssrc >> 16);
+    m_header[10] = static_cast<uint8_t>(ssrc >> 8);
+    m_header[11] = static_cast<uint8_t>(ssrc);
+}
+
+void RtpPacketizer::beginFrame(uint32_t timestamp)
+{
+    m_header[4] = static_cast<uint8_t>(timestamp >> 24);
+    m_header[5] = static_cast<uint8_t>(timestamp >> 16);
+    m_header[6] = static_cast<uint8_t>(timestamp >> 8);
+    m_header[7] = static_cast<uint8_t>(timestamp);
+}
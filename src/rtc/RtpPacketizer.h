@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "RtpPacketPool.h"
+#include "../encoder/NalScanner.h"
+
+// Hand-rolled H.264 RTP packetizer (RFC 6184, single NAL unit and FU-A) for the DataChannel
+// transport. Packets are written straight into pooled buffers: the 12-byte header is copied
+// from a template that only gets its marker, sequence number and timestamp patched, and each
+// payload byte is copied exactly once.
+class RtpPacketizer
+{
+public:
+    static constexpr size_t RTP_HEADER_SIZE = 12;
+    static constexpr size_t FU_A_HEADER_SIZE = 2;
+
+    RtpPacketizer(uint32_t ssrc, uint8_t payloadType, size_t maxPayloadSize);
+
+    // Buffer size the pool has to provide
+    size_t packetCapacity() const { return RTP_HEADER_SIZE + FU_A_HEADER_SIZE + m_maxPayloadSize; }
+
+    // Starts a new frame; all its NALs and fragments share the RTP timestamp
+    void beginFrame(uint32_t timestamp);
+
+    // Packetizes one NAL and calls emit(RtpPacketPool::Packet&&) for every packet in order.
+    // The marker bit is set on the last packet when lastNalOfFrame is true.
+    template<class Fn>
+    void packetize(const NalUnit& nal, bool lastNalOfFrame, RtpPacketPool& pool, Fn&& emit)
+    {
+        if (nal.size == 0) return;
+
+        // Single NAL unit packet
+        if (nal.size <= m_maxPayloadSize) {
+            RtpPacketPool::Packet packet = pool.acquire();
+            uint8_t* p = packet.bytes();
+            writeHeader(p, lastNalOfFrame);
+            std::memcpy(p + RTP_HEADER_SIZE, nal.data, nal.size);
+            packet.setSize(RTP_HEADER_SIZE + nal.size);
+            emit(std::move(packet));
+            return;
+        }
+
+        // FU-A: the NAL header is folded into the FU indicator/header of every fragment
+        const uint8_t fuIndicator = static_cast<uint8_t>((nal.header() & 0xE0) | 28);
+        const uint8_t nalType = nal.type();
+        const uint8_t* payload = nal.data + 1;
+        const size_t payloadSize = nal.size - 1;
+        const size_t maxChunk = m_maxPayloadSize - FU_A_HEADER_SIZE;
+
+        for (size_t offset = 0; offset < payloadSize;) {
+            const size_t chunk = std::min(maxChunk, payloadSize - offset);
+            const bool first = offset == 0;
+            const bool last = offset + chunk == payloadSize;
+
+            RtpPacketPool::Packet packet = pool.acquire();
+            uint8_t* p = packet.bytes();
+            writeHeader(p, last && lastNalOfFrame);
+            p[RTP_HEADER_SIZE] = fuIndicator;
+            p[RTP_HEADER_SIZE + 1] = static_cast<uint8_t>(nalType | (first ? 0x80 : 0x00) | (last ? 0x40 : 0x00));
+            std::memcpy(p + RTP_HEADER_SIZE + FU_A_HEADER_SIZE, payload + offset, chunk);
+            packet.setSize(RTP_HEADER_SIZE + FU_A_HEADER_SIZE + chunk);
+            emit(std::move(packet));
+
+            offset += chunk;
+        }
+    }
+
+    uint16_t sequenceNumber() const { return m_sequenceNumber; }
+
+private:
+    void writeHeader(uint8_t* p, bool marker)
+    {
+        std::memcpy(p, m_header, RTP_HEADER_SIZE);
+        if (marker) p[1] |= 0x80;
+        p[2] = static_cast<uint8_t>(m_sequenceNumber >> 8);
+        p[3] = static_cast<uint8_t>(m_sequenceNumber);
+        m_sequenceNumber++;
+    }
+
+    const size_t m_maxPayloadSize;
+    uint8_t m_header[RTP_HEADER_SIZE];  // V=2, PT and SSRC fixed, timestamp patched per frame
+    uint16_t m_sequenceNumber = 0;
+};
@@ -0,0 +1,113 @@
+#include "VideoReceiver.h"
+#include <QTimer>
+#include <QDebug>
+#include <memory>
+
+namespace
+{
+    const double STATS_SMOOTHING = 1.0 / 16.0;
+}
+
+VideoReceiver::VideoReceiver(QObject* parent) : QObject(parent)
+{
+    m_clock.start();
+
+    // Child of this object so it follows moveToThread() to the decode thread
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &VideoReceiver::drain);
+}
+
+VideoReceiver::~VideoReceiver() = default;
+
+qint64 VideoReceiver::nowUs() const
+{
+    return m_clock.nsecsElapsed() / 1000;
+}
+
+void VideoReceiver::pushPacket(JitterBuffer::Packet packet)
+{
+    const qint64 arrivalUs = nowUs();
+    auto shared = std::make_shared<JitterBuffer::Packet>(std::move(packet));
+    QMetaObject::invokeMethod(this, [this, shared, arrivalUs]() {
+        onPacket(std::move(*shared), arrivalUs);
+        }, Qt::QueuedConnection);
+}
+
+void VideoReceiver::onPacket(JitterBuffer::Packet packet, qint64 arrivalUs)
+{
+    m_jitter.insert(std::move(packet), arrivalUs);
+    drain();
+}
+
+void VideoReceiver::drain()
+{
+    if (!m_decoderReady) {
+        m_decoderReady = m_decoder.init();
+    }
+
+    EncodedFrame encoded;
+    while (m_jitter.pop(nowUs(), encoded)) {
+        if (!m_decoderReady) continue;
+
+        const qint64 decodeStartUs = nowUs();
+        QVideoFrame frame;
+        const bool ok = m_decoder.decode(encoded.data.data(), encoded.data.size(), frame);
+        const qint64 decodedUs = nowUs();
+
+        {
+            QMutexLocker guard(&m_statsMutex);
+            m_stats.decodeMs += ((decodedUs - decodeStartUs) / 1000.0 - m_stats.decodeMs) * STATS_SMOOTHING;
+            if (ok) {
+                m_stats.framesDecoded++;
+                m_stats.receiveDelayMs += ((decodedUs - encoded.completeUs) / 1000.0 - m_stats.receiveDelayMs) * STATS_SMOOTHING;
+            }
+        }
+
+        if (ok) {
+            // Presentation time in microseconds on the sender's 90 kHz media clock
+            frame.setStartTime(static_cast<qint64>(encoded.rtpTimestamp) * 1000000 / 90000);
+            emit frameDecoded(frame);
+        }
+    }
+
+    if (m_jitter.takeKeyframeRequest(nowUs())) {
+        emit keyframeRequested();
+    }
+
+    {
+        QMutexLocker guard(&m_statsMutex);
+        m_stats.jitter = m_jitter.stats();
+    }
+
+    schedule();
+}
+
+void VideoReceiver::schedule()
+{
+    const qint64 next = m_jitter.nextEventUs();
+    if (next < 0) {
+        m_timer->stop();
+        return;
+    }
+    // Round up so the timer never fires just before the frame is due
+    const qint64 waitMs = qMax<qint64>(0, (next - nowUs() + 999) / 1000);
+    m_timer->start(static_cast<int>(waitMs));
+}
+
+VideoReceiver::Stats VideoReceiver::stats() const
+{
+    QMutexLocker guard(&m_statsMutex);
+    return m_stats;
+}
+
+void VideoReceiver::reset()
+{
+    m_timer->stop();
+    m_jitter.reset();
+    m_decoder.flush();
+
+    QMutexLocker guard(&m_statsMutex);
+    m_stats = Stats();
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <QObject>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QVideoFrame>
+
+#include "JitterBuffer.h"
+#include "../decoder/VideoDecoder.h"
+
+class QTimer;
+
+// Receive side of the video path: RTP packets -> JitterBuffer -> VideoDecoder -> QVideoFrame.
+// Meant to be moved to its own thread; pushPacket() and stats() may be called from any thread.
+class VideoReceiver : public QObject
+{
+    Q_OBJECT
+public:
+    struct Stats
+    {
+        JitterBuffer::Stats jitter;
+        quint64 framesDecoded = 0;
+        double decodeMs = 0.0;        // smoothed avcodec + copy time per frame
+        double receiveDelayMs = 0.0;  // smoothed time from frame complete to decoded picture
+    };
+
+    explicit VideoReceiver(QObject* parent = nullptr);
+    ~VideoReceiver();
+
+    // Thread-safe; the packet is stamped with its arrival time here and queued to the decode thread
+    void pushPacket(JitterBuffer::Packet packet);
+
+    Stats stats() const;
+
+public slots:
+    void reset();
+
+signals:
+    void frameDecoded(const QVideoFrame& frame);
+    void keyframeRequested();  // a frame was lost, ask the sender for an IDR (PLI)
+
+private:
+    void onPacket(JitterBuffer::Packet packet, qint64 arrivalUs);
+    void drain();
+    void schedule();
+    qint64 nowUs() const;
+
+    QElapsedTimer m_clock;   // one monotonic clock for arrival and playout times
+    JitterBuffer m_jitter;
+    VideoDecoder m_decoder;
+    bool m_decoderReady = false;
+    QTimer* m_timer = nullptr;
+
+    mutable QMutex m_statsMutex;
+    Stats m_stats;
+};
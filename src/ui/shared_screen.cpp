@@ -297,11 +297,17 @@ shared_screen::shared_screen(QWidget *parent)
     connect(btnRecord, &QPushButton::clicked, this, &shared_screen::on_btnRecordClicked);
     connect(btnRaiseHand, &QPushButton::clicked, this, &shared_screen::on_btnRaiseHandClicked);
     connect(btnLeave, &QPushButton::clicked, this, &shared_screen::on_btnLeaveClicked);
-    connect(pcMgr, &PeerConnectionManager::dataChannelOpened,
-            // 绑定到 ScreenCaptureService 的 startCapture 槽函数
+    connect(pcMgr, &PeerConnectionManager::videoPathOpened,
+            // 视频通道（媒体轨道或 DataChannel）就绪后，绑定到 ScreenCaptureService 的 startCapture 槽函数
             CaptureService, &ScreenCaptureService::startCapture);
     connect(CaptureService, &ScreenCaptureService::encodedFrameReady,
             pcMgr, &PeerConnectionManager::sendEncodedFrame);
+    // 自适应码率：传输反馈 -> 编码器的码率/帧率/分辨率
+    connect(pcMgr, &PeerConnectionManager::videoTargetChanged,
+            CaptureService, &ScreenCaptureService::setVideoTarget);
+    // 接收端丢帧发来 PLI：下一帧编成 IDR
+    connect(pcMgr, &PeerConnectionManager::keyframeRequested,
+            CaptureService, &ScreenCaptureService::requestKeyframe);
             
     if (ui->btnSend)
         connect(ui->btnSend, &QPushButton::clicked, this, &shared_screen::on_btnSendClicked);
@@ -323,6 +329,25 @@ shared_screen::shared_screen(QWidget *parent)
     buildShortcuts();
 
     ui->screenPreview->setText(u8"屏幕预览区域\n点击共享屏幕开始");
+
+    // ====== 远端画面 ======
+    // 解码线程发出的 QVideoFrame 排队送到 GUI 线程的 QVideoSink，收到第一帧后替换预览占位
+    remoteVideo = new QVideoWidget(ui->pageMeeting);
+    remoteVideo->setMinimumSize(ui->screenPreview->minimumSize());
+    remoteVideo->hide();
+    ui->verticalLayout_4->insertWidget(ui->verticalLayout_4->indexOf(ui->screenPreview) + 1, remoteVideo);
+    connect(pcMgr, &PeerConnectionManager::remoteFrameReady, remoteVideo->videoSink(), [this](const QVideoFrame& frame) {
+        if (remoteVideo->isHidden()) {
+            ui->screenPreview->hide();
+            remoteVideo->show();
+        }
+        remoteVideo->videoSink()->setVideoFrame(frame);
+    });
+    connect(pcMgr, &PeerConnectionManager::p2pDisconnected, this, [this]() {
+        remoteVideo->hide();
+        ui->screenPreview->show();
+    });
+
     ui->dockChat->setFloating(true);
     ui->dockChat->setAllowedAreas(Qt::NoDockWidgetArea);
     ui->dockChat->hide();
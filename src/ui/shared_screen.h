@@ -19,6 +19,7 @@
 #include <QtMultimedia/QMediaRecorder>
 #include <QtMultimedia/QAudioInput>
 #include <QtMultimediaWidgets/QVideoWidget>
+#include <QtMultimedia/QVideoSink>
 #include <QJsonDocument>
 #include <QtWidgets>
 #include <QWebSocket>
@@ -173,6 +174,7 @@ private:
     QCamera *camera = nullptr;
     QMediaCaptureSession *captureSession = nullptr;
     QVideoWidget *videoWidget = nullptr;
+    QVideoWidget *remoteVideo = nullptr;   // 对端共享的屏幕（接收解码后的画面）
     QMediaRecorder *mediaRecorder = nullptr;
     QAudioInput *audioInput = nullptr;
 